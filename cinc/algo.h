@@ -4,6 +4,9 @@
  Copyright   : Licensed under GPL version 2 (GPLv2)
 ==============================================================================*/
 #pragma once
+#include "allocator.h"
+#include "algo_typed.h"
+#include "rng.h"
 
 #ifdef __cplusplus
 	extern "C" {
@@ -12,6 +15,10 @@
 genptr gensearch(genptr base, const genptr key, size_t first, size_t last,  
 		const size_t size, int (*cmp)(const genptr, const genptr));
 
+void gensearch_batch(const genptr base, const size_t count, const genptr keys,
+		     const size_t nkeys, const size_t size,
+		     int (*cmp)(const genptr, const genptr), genptr *results);
+
 /* non-modifying algorithms for unsorted ranges */
 void visit(genptr base, const size_t count, const size_t size,
 	   void (*readonly)(const genptr));
@@ -39,6 +46,36 @@ void gensort(genptr base, const size_t count, const size_t size,
 	     bool (*cmp)(const genptr, const genptr),
 	     void (*swp)(genptr, genptr));
 
+bool gensort_stable(genptr base, const size_t count, const size_t size,
+		    bool (*cmp)(const genptr, const genptr));
+
+bool gensort_stable_with(genptr base, const size_t count, const size_t size,
+			 bool (*cmp)(const genptr, const genptr),
+			 const allocator *al);
+
+void nth_element(genptr base, const size_t nth, const size_t count,
+		 const size_t size, bool (*cmp)(const genptr, const genptr),
+		 void (*swp)(genptr, genptr));
+
+void partial_sort(genptr base, const size_t middle, const size_t count,
+		  const size_t size, bool (*cmp)(const genptr, const genptr),
+		  void (*swp)(genptr, genptr));
+
+size_t partial_sort_copy(genptr dest, const size_t dcount, const genptr src,
+			 const size_t scount, const size_t size,
+			 bool (*cmp)(const genptr, const genptr),
+			 void (*swp)(genptr, genptr));
+
+/* threaded with ALGO_PARALLEL, nthreads 0 is one per core, else gensort */
+void gensort_parallel(genptr base, const size_t count, const size_t size,
+		      bool (*cmp)(const genptr, const genptr),
+		      void (*swp)(genptr, genptr), const size_t nthreads);
+
+void gensort_parallel_with(genptr base, const size_t count, const size_t size,
+			   bool (*cmp)(const genptr, const genptr),
+			   void (*swp)(genptr, genptr), const size_t nthreads,
+			   const allocator *al);
+
 /* ok if buffers overlap or even the same buffer writing to itself */
 void transform(genptr dest, const genptr src, const size_t count,
 	       const size_t size, void (*func)(const genptr, genptr));
@@ -55,6 +92,10 @@ void copy_backward(genptr dest, const genptr src, const size_t count,
 void merge(genptr dest, const genptr src1, const genptr src2, const size_t count,
 	   const size_t size, bool (*pred)(const genptr, const genptr));
 
+void merge_ranges(genptr dest, const genptr src1, const size_t count1,
+		  const genptr src2, const size_t count2, const size_t size,
+		  bool (*pred)(const genptr, const genptr));
+
 void swap_ranges(genptr first1, genptr first2, const size_t count,
 		 const size_t size, void(*swap)(genptr, genptr));
 
@@ -72,11 +113,15 @@ void reverse(genptr base, const size_t count, const size_t size,
 void reverse_copy(genptr dest, const genptr src, const size_t count,
 	const size_t size);
 
-void rotate(genptr base, const size_t count, const size_t size);
+void rotate(genptr base, const size_t middle, const size_t count,
+	    const size_t size);
 
 void random_shuffle(genptr base, const size_t count, const size_t size,
 		    void (*swap)(genptr, genptr));
 
+void random_shuffle_with(genptr base, const size_t count, const size_t size,
+			 void (*swap)(genptr, genptr), rng *r);
+
 /* numeric algorithms */
 int accumulate(const genptr base, const size_t count, const size_t size,
 	       int(*acc)(const genptr));
@@ -89,17 +134,62 @@ int inner_product(const genptr first1, const genptr first2, const size_t count,
 
 /* specializations */
 void sort_int(genptr base, const size_t count);
+void sort_u32(genptr base, const size_t count);
+void sort_float(genptr base, const size_t count);
 void sort_str(genptr base, const size_t count);
 genptr search_int(const genptr base, const genptr val, size_t first, size_t last);
 genptr search_str(const genptr base, const genptr val, size_t first, size_t last);
 
+/* callback free int and float kernels, SSE2 or AVX2 on x86 hosts, see
+   algo_simd.c */
+typedef enum simd_level { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 } simd_level;
+simd_level simd_select(const simd_level max);
+simd_level simd_current(void);
+
+size_t count_if_int_eq(const int *base, const size_t count, const int val);
+int accumulate_int(const int *base, const size_t count);
+float accumulate_float(const float *base, const size_t count);
+bool equal_int(const int *first1, const int *first2, const size_t count);
+bool equal_float(const float *first1, const float *first2, const size_t count);
+void replace_int(int *base, const size_t count, const int oldval,
+		 const int newval);
+void replace_float(float *base, const size_t count, const float oldval,
+		   const float newval);
+int min_int(const int *base, const size_t count);
+int max_int(const int *base, const size_t count);
+float min_float(const float *base, const size_t count);
+float max_float(const float *base, const size_t count);
+void reverse_int(int *base, const size_t count);
+void reverse_float(float *base, const size_t count);
+
+/* typed sums and dot products, int64_t for ints, pairwise or compensated
+   for floats, see algo_reduce.c */
+int64_t sum_int(const int *base, const size_t count);
+float sum_float(const float *base, const size_t count);
+double sum_double(const double *base, const size_t count);
+float sum_float_kahan(const float *base, const size_t count);
+double sum_double_kahan(const double *base, const size_t count);
+int64_t dot_int(const int *first1, const int *first2, const size_t count);
+float dot_float(const float *first1, const float *first2, const size_t count);
+double dot_double(const double *first1, const double *first2,
+		  const size_t count);
+
 #ifdef __cplusplus
 	}
 #endif
 
+/* the int, uint32_t and float sorts are the radix sorts, the other types
+   go to the MLIBS_DEFINE_ALGOS instances in algo_typed.h */
 #define deduce_sort(base, count)                                               \
-	_Generic((base), int * : sort_int, char * : sort_str)(base, count)
+	_Generic((base), int * : sort_int, uint32_t * : sort_u32,              \
+		 float * : sort_float, char * : sort_str,                      \
+		 short * : sort_short_lt, long * : sort_long_lt,               \
+		 long long * : sort_llong_lt, double * : sort_double_lt)       \
+(base, count)
 
 #define deduce_search(base, val, first, last)                                  \
-	_Generic((base), int * : search_int, char * : search_str)              \
+	_Generic((base), int * : search_int, char * : search_str,              \
+		 short * : search_short_lt, long * : search_long_lt,           \
+		 long long * : search_llong_lt, uint32_t * : search_u32_lt,    \
+		 float * : search_float_lt, double * : search_double_lt)       \
 (base, val, first, last)
@@ -0,0 +1,268 @@
+/*==============================================================================
+ Name        : algo_typed.h
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**=============================================================================
+ Macro:      MLIBS_DEFINE_ALGOS
+
+ Purpose:    Stamps out static inline algorithms for one element type and
+             one comparator, the C answer to the cppinc templates.  There is
+	     no genptr arithmetic, no runtime size and LESS is expanded in
+	     place, so the compiler can inline and vectorize the loops.
+	     MLIBS_DEFINE_ORDERED works for any type with a LESS,
+	     MLIBS_DEFINE_NUMERIC adds accumulate for arithmetic types and
+	     MLIBS_DEFINE_ALGOS is both.  The names are suffixed with LESS:
+
+	     void sort_LESS(T *base, size_t count)            not stable
+	     bool is_sorted_LESS(const T *base, size_t count)
+	     T *search_LESS(const T *base, const T *key, size_t first,
+			    size_t last)                       NULL if absent
+	     void search_batch_LESS(const T *base, size_t count,
+				    const T *keys, size_t nkeys,
+				    T **results)
+	     void merge_LESS(T *dest, const T *src1, size_t count1,
+			     const T *src2, size_t count2)     stable
+	     void transform_LESS(T *dest, const T *src, size_t count,
+				 T (*func)(T))
+	     size_t count_if_LESS(const T *base, size_t count,
+				  bool (*pred)(T))
+	     void reverse_LESS(T *base, size_t count)
+	     T accumulate_LESS(const T *base, size_t count)
+
+	     sort is an introsort (median of three quicksort, heapsort past
+	     2*log2(n) levels, insertion sort below the cutoff).  search is
+	     a branchless lower bound over [first, last] like gensearch and
+	     search_batch steps groups of keys through the table together
+	     like gensearch_batch.
+	     A func or pred that is itself static inline is inlined too once
+	     the call is.
+
+ Parameters: T: element type.
+	     LESS: strict weak order taking two T by value, a function or a
+	     function like macro, also the name suffix.
+
+Example:     static inline bool gpa_lt(student a, student b)
+	     {
+		     return a.gpa < b.gpa;
+	     }
+	     MLIBS_DEFINE_ORDERED(student, gpa_lt)
+	     ...
+	     sort_gpa_lt(recs, _countof(recs));
+==============================================================================*/
+#ifndef MLIBS_TYPED_INSERTION_CUTOFF
+#define MLIBS_TYPED_INSERTION_CUTOFF 16
+#endif
+#ifndef MLIBS_TYPED_SEARCH_BATCH
+#define MLIBS_TYPED_SEARCH_BATCH 8
+#endif
+
+#define MLIBS_DEFINE_ORDERED(T, LESS)                                          \
+	static inline void sort_##LESS##_insertion(T *lo, T *hi)               \
+	{                                                                      \
+		for (T *key = lo + 1; key < hi; key++) {                       \
+			T tmp = *key;                                          \
+			T *p = key;                                            \
+			for (; p > lo && LESS(tmp, p[-1]); p--)                \
+				*p = p[-1];                                    \
+			*p = tmp;                                              \
+		}                                                              \
+	}                                                                      \
+	static inline void sort_##LESS##_sift(T *base, size_t root,            \
+					      const size_t count)              \
+	{                                                                      \
+		T tmp = base[root];                                            \
+		for (size_t child; (child = 2 * root + 1) < count;             \
+		     root = child) {                                           \
+			if (child + 1 < count &&                               \
+			    LESS(base[child], base[child + 1]))                \
+				child++;                                       \
+			if (!LESS(tmp, base[child]))                           \
+				break;                                         \
+			base[root] = base[child];                              \
+		}                                                              \
+		base[root] = tmp;                                              \
+	}                                                                      \
+	static inline void sort_##LESS##_heap(T *base, const size_t count)     \
+	{                                                                      \
+		for (size_t i = count / 2; i-- > 0;)                           \
+			sort_##LESS##_sift(base, i, count);                    \
+		for (size_t end = count - 1; end > 0; end--) {                 \
+			T tmp = base[0];                                       \
+			base[0] = base[end];                                   \
+			base[end] = tmp;                                       \
+			sort_##LESS##_sift(base, 0, end);                      \
+		}                                                              \
+	}                                                                      \
+	static inline void sort_##LESS##_loop(T *lo, T *hi, size_t bad)        \
+	{                                                                      \
+		while (hi - lo > MLIBS_TYPED_INSERTION_CUTOFF) {               \
+			if (bad-- == 0) {                                      \
+				sort_##LESS##_heap(lo, hi - lo);               \
+				return;                                        \
+			}                                                      \
+			T *mid = lo + (hi - lo) / 2, tmp;                      \
+			if (LESS(*mid, *lo))                                   \
+				tmp = *lo, *lo = *mid, *mid = tmp;             \
+			if (LESS(hi[-1], *mid)) {                              \
+				tmp = *mid, *mid = hi[-1], hi[-1] = tmp;       \
+				if (LESS(*mid, *lo))                           \
+					tmp = *lo, *lo = *mid, *mid = tmp;     \
+			}                                                      \
+			T pivot = *mid;                                        \
+			T *i = lo, *j = hi - 1;                                \
+			for (;;) {                                             \
+				while (LESS(*i, pivot))                        \
+					i++;                                   \
+				while (LESS(pivot, *j))                        \
+					j--;                                   \
+				if (i >= j)                                    \
+					break;                                 \
+				tmp = *i, *i++ = *j, *j-- = tmp;               \
+			}                                                      \
+			if (j + 1 - lo < hi - j - 1) {                         \
+				sort_##LESS##_loop(lo, j + 1, bad);            \
+				lo = j + 1;                                    \
+			} else {                                               \
+				sort_##LESS##_loop(j + 1, hi, bad);            \
+				hi = j + 1;                                    \
+			}                                                      \
+		}                                                              \
+		sort_##LESS##_insertion(lo, hi);                               \
+	}                                                                      \
+	static inline void sort_##LESS(T *base, const size_t count)            \
+	{                                                                      \
+		size_t bad = 0;                                                \
+		for (size_t n = count; n > 1; n >>= 1)                         \
+			bad += 2;                                              \
+		sort_##LESS##_loop(base, base + count, bad);                   \
+	}                                                                      \
+	static inline bool is_sorted_##LESS(const T *base, const size_t count) \
+	{                                                                      \
+		for (size_t i = 1; i < count; i++)                             \
+			if (LESS(base[i], base[i - 1]))                        \
+				return false;                                  \
+		return true;                                                   \
+	}                                                                      \
+	static inline T *search_##LESS(const T *base, const T *key,            \
+				       size_t first, size_t last)              \
+	{                                                                      \
+		size_t len = last - first + 1;                                 \
+		if (last < first || len == 0)                                  \
+			return NULL;                                           \
+		const T *p = base + first;                                     \
+		while (len > 1) {                                              \
+			size_t half = len / 2;                                 \
+			p = LESS(p[half - 1], *key) ? p + half : p;            \
+			len -= half;                                           \
+		}                                                              \
+		p += LESS(*p, *key);                                           \
+		return (p <= base + last && !LESS(*key, *p)) ? (T *)p : NULL;  \
+	}                                                                      \
+	static inline void search_batch_##LESS(const T *base, size_t count,    \
+					       const T *keys, size_t nkeys,    \
+					       T **results)                    \
+	{                                                                      \
+		const T *p[MLIBS_TYPED_SEARCH_BATCH];                          \
+		for (; nkeys; keys += MLIBS_TYPED_SEARCH_BATCH,                \
+			      results += MLIBS_TYPED_SEARCH_BATCH) {           \
+			size_t group = nkeys < MLIBS_TYPED_SEARCH_BATCH ?      \
+					       nkeys :                         \
+					       MLIBS_TYPED_SEARCH_BATCH;       \
+			nkeys -= group;                                        \
+			for (size_t k = 0; k < group; k++)                     \
+				p[k] = base;                                   \
+			for (size_t len = count; len > 1;) {                   \
+				size_t half = len / 2;                         \
+				size_t next = (len - half) / 2;                \
+				for (size_t k = 0; k < group; k++) {           \
+					p[k] += LESS(p[k][half - 1], keys[k]) * \
+						half;                          \
+					if (next)                              \
+						__builtin_prefetch(p[k] + next - 1); \
+				}                                              \
+				len -= half;                                   \
+			}                                                      \
+			for (size_t k = 0; k < group; k++) {                   \
+				p[k] += count && LESS(*p[k], keys[k]);         \
+				results[k] = (p[k] < base + count &&           \
+					      !LESS(keys[k], *p[k])) ?         \
+						     (T *)p[k] :               \
+						     NULL;                     \
+			}                                                      \
+		}                                                              \
+	}                                                                      \
+	static inline void merge_##LESS(T *dest, const T *src1,                \
+					const size_t count1, const T *src2,    \
+					const size_t count2)                   \
+	{                                                                      \
+		const T *end1 = src1 + count1, *end2 = src2 + count2;          \
+		while (src1 < end1 && src2 < end2)                             \
+			*dest++ = LESS(*src2, *src1) ? *src2++ : *src1++;      \
+		while (src1 < end1)                                            \
+			*dest++ = *src1++;                                     \
+		while (src2 < end2)                                            \
+			*dest++ = *src2++;                                     \
+	}                                                                      \
+	static inline void transform_##LESS(T *dest, const T *src,             \
+					    const size_t count, T (*func)(T))  \
+	{                                                                      \
+		for (size_t i = 0; i < count; i++)                             \
+			dest[i] = func(src[i]);                                \
+	}                                                                      \
+	static inline size_t count_if_##LESS(const T *base,                    \
+					     const size_t count,               \
+					     bool (*pred)(T))                  \
+	{                                                                      \
+		size_t accum = 0;                                              \
+		for (size_t i = 0; i < count; i++)                             \
+			accum += pred(base[i]);                                \
+		return accum;                                                  \
+	}                                                                      \
+	static inline void reverse_##LESS(T *base, const size_t count)         \
+	{                                                                      \
+		if (count < 2)                                                 \
+			return;                                                \
+		for (T *l = base, *r = base + count - 1; l < r; l++, r--) {    \
+			T tmp = *l;                                            \
+			*l = *r;                                               \
+			*r = tmp;                                              \
+		}                                                              \
+	}
+
+#define MLIBS_DEFINE_NUMERIC(T, LESS)                                          \
+	static inline T accumulate_##LESS(const T *base, const size_t count)   \
+	{                                                                      \
+		T accum = 0;                                                   \
+		for (size_t i = 0; i < count; i++)                             \
+			accum += base[i];                                      \
+		return accum;                                                  \
+	}
+
+#define MLIBS_DEFINE_ALGOS(T, LESS)                                            \
+	MLIBS_DEFINE_ORDERED(T, LESS)                                          \
+	MLIBS_DEFINE_NUMERIC(T, LESS)
+
+/* comparators and instances for the built in types, deduce_sort and
+   deduce_search in algo.h dispatch to these.  float_lt and double_lt order
+   NaN like <, sort the NaN out first. */
+static inline bool int_lt(int a, int b) { return a < b; }
+static inline bool short_lt(short a, short b) { return a < b; }
+static inline bool long_lt(long a, long b) { return a < b; }
+static inline bool llong_lt(long long a, long long b) { return a < b; }
+static inline bool u32_lt(uint32_t a, uint32_t b) { return a < b; }
+static inline bool float_lt(float a, float b) { return a < b; }
+static inline bool double_lt(double a, double b) { return a < b; }
+
+MLIBS_DEFINE_ALGOS(int, int_lt)
+MLIBS_DEFINE_ALGOS(short, short_lt)
+MLIBS_DEFINE_ALGOS(long, long_lt)
+MLIBS_DEFINE_ALGOS(long long, llong_lt)
+MLIBS_DEFINE_ALGOS(uint32_t, u32_lt)
+MLIBS_DEFINE_ALGOS(float, float_lt)
+MLIBS_DEFINE_ALGOS(double, double_lt)
@@ -0,0 +1,119 @@
+/*==============================================================================
+ Name        : allocator.h
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#pragma once
+#include "heap.h"
+
+/* An allocator is a small vtable plus a context pointer.  Every container
+   constructor with a _with suffix takes one, NULL means heap_allocator.
+   The struct is copied into the container, so a stack allocator value is
+   fine, but whatever ctx points at must outlive the container.
+   The batch entries are optional, NULL falls back to one call per
+   pointer. */
+typedef struct allocator {
+	genptr (*alloc)(genptr ctx, const size_t bytes);
+	void (*free)(genptr ctx, genptr p);
+	genptr (*realloc)(genptr ctx, genptr p, const size_t bytes);
+	genptr ctx;
+	size_t (*alloc_batch)(genptr ctx, const size_t count,
+			      const size_t bytes, genptr *out);
+	void (*free_batch)(genptr ctx, genptr *ptrs, const size_t count);
+} allocator;
+
+/* pointers a container gathers before handing them to free_batch */
+#ifndef ALLOCATOR_BATCH
+#define ALLOCATOR_BATCH 32
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the custom static heap manager (Heap_Malloc), the default */
+extern const allocator heap_allocator;
+/* the C library malloc, for comparing against the host allocator */
+extern const allocator system_allocator;
+
+allocator heap_instance_allocator(heap_t *heap);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* NULL selects the default, containers call this once in the constructor */
+static inline allocator allocator_or_default(const allocator *al)
+{
+	return al ? *al : heap_allocator;
+}
+static inline genptr allocator_alloc(const allocator *al, const size_t bytes)
+{
+	return al->alloc(al->ctx, bytes);
+}
+static inline void allocator_free(const allocator *al, genptr p)
+{
+	if (p)
+		al->free(al->ctx, p);
+}
+static inline genptr allocator_realloc(const allocator *al, genptr p,
+				       const size_t bytes)
+{
+	assert(al->realloc);
+	return al->realloc(al->ctx, p, bytes);
+}
+/* fills out with count blocks of bytes each, returns how many it got */
+static inline size_t allocator_alloc_batch(const allocator *al,
+					   const size_t count,
+					   const size_t bytes, genptr *out)
+{
+	if (al->alloc_batch)
+		return al->alloc_batch(al->ctx, count, bytes, out);
+	size_t n = 0;
+	while (n < count && (out[n] = al->alloc(al->ctx, bytes)) != NULL)
+		n++;
+	for (size_t i = n; i < count; i++)
+		out[i] = NULL;
+	return n;
+}
+static inline void allocator_free_batch(const allocator *al, genptr *ptrs,
+					const size_t count)
+{
+	if (al->free_batch) {
+		al->free_batch(al->ctx, ptrs, count);
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+		allocator_free(al, ptrs[i]);
+}
+
+/* Gathers the nodes of a container being freed and releases them
+   ALLOCATOR_BATCH at a time.  Copy the allocator out of the container
+   first, the descriptor may be in the last batch.
+	allocator_gather g;
+	allocator_gather_init(&g, &a);
+	while (n) { next = n->next; allocator_gather_add(&g, n); n = next; }
+	allocator_gather_flush(&g); */
+typedef struct allocator_gather {
+	const allocator *al;
+	size_t count;
+	genptr ptrs[ALLOCATOR_BATCH];
+} allocator_gather;
+
+static inline void allocator_gather_init(allocator_gather *g,
+					 const allocator *al)
+{
+	g->al = al;
+	g->count = 0;
+}
+static inline void allocator_gather_flush(allocator_gather *g)
+{
+	allocator_free_batch(g->al, g->ptrs, g->count);
+	g->count = 0;
+}
+static inline void allocator_gather_add(allocator_gather *g, genptr p)
+{
+	g->ptrs[g->count++] = p;
+	if (g->count == ALLOCATOR_BATCH)
+		allocator_gather_flush(g);
+}
@@ -0,0 +1,32 @@
+/*==============================================================================
+ Name        : arena.h
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#pragma once
+#include "allocator.h"
+
+typedef struct arena arena;
+typedef arena* arenaptr;
+typedef size_t arena_marker;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+arenaptr arena_alloc(const size_t bytes);
+arenaptr arena_attach(const genptr base, const size_t bytes);
+
+void arena_free(arenaptr pa);
+void arena_detach(arenaptr pa);
+
+genptr arena_get(arenaptr pa, const size_t bytes);
+arena_marker arena_mark(const arenaptr pa);
+void arena_release(arenaptr pa, const arena_marker mark);
+void arena_reset(arenaptr pa);
+size_t arena_used(const arenaptr pa);
+allocator arena_allocator(arenaptr pa);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,6 +4,7 @@
  Copyright   : Licensed under GPL version 2 (GPLv2)
 ==============================================================================*/
 #pragma once
+#include "allocator.h"
 
 typedef void* iterator;
 typedef struct dynarray dynarray;
@@ -13,11 +14,16 @@ typedef dynarray* arrayptr;
 extern "C" {
 #endif
 arrayptr array_alloc(const size_t capacity, const size_t datasize);
+arrayptr array_alloc_with(const size_t capacity, const size_t datasize,
+			  const allocator *al);
+arrayptr array_alloc_aligned(const size_t capacity, const size_t datasize,
+			     const size_t align);
 arrayptr array_attach(const genptr base, const size_t capacity,
 			const size_t datasize);
 
 void array_free(arrayptr pa);
 void array_detach(arrayptr pa);
+size_t array_alignment(const arrayptr pa);
 
 void array_add(arrayptr pa, const genptr data, const size_t count);
 void array_insert(arrayptr pa, iterator first, iterator last);
@@ -28,6 +34,9 @@ void array_print(const arrayptr pa, void (*prnt)(const genptr));
 void array_sort(arrayptr pa, bool (*cmp)(const genptr, const genptr),
 				   void (*swap)(genptr, genptr));
 
+void array_sort_parallel(arrayptr pa, bool (*cmp)(const genptr, const genptr),
+			 void (*swap)(genptr, genptr), const size_t nthreads);
+
 genptr array_search(arrayptr pa, const genptr val,
 		    int(*com)(const genptr, const genptr));
 
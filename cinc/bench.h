@@ -0,0 +1,48 @@
+/*==============================================================================
+ Name        : bench.h
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+
+/* BENCHMARK HELPERS
+   On the board the DWT cycle counter is used, on a host build the monotonic
+   clock in nanoseconds.  Include once per test, next to harness.h. */
+#if defined(__arm__)
+#include "stm32f4xx.h"
+#define BENCH_UNITS "cycles"
+
+static inline void bench_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+static inline uint64_t bench_now(void)
+{
+	return DWT->CYCCNT;
+}
+#else
+#include <time.h>
+#define BENCH_UNITS "ns"
+
+static inline void bench_init(void)
+{
+}
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+// Report total and per operation cost of a timed section
+#define BENCH_REPORT(label, ticks, ops) \
+    do { \
+        printf("BENCH %-40s %10llu " BENCH_UNITS " %8llu " BENCH_UNITS "/op\n", \
+               label, (unsigned long long)(ticks), \
+               (unsigned long long)((ops) ? (ticks) / (ops) : 0)); \
+    } while (0)
@@ -4,6 +4,7 @@
  Copyright   : Licensed under GPL version 2 (GPLv2)
 ==============================================================================*/
 #pragma once
+#include "pool.h"
 
 typedef struct circ_list circ_list;
 typedef circ_list* listptr;
@@ -13,6 +14,9 @@ extern "C" {
 #endif
 
 listptr list_alloc(const size_t datasize);
+listptr list_alloc_pool(const size_t datasize, poolptr pool);
+listptr list_alloc_with(const size_t datasize, const allocator *al);
+size_t list_node_size(const size_t datasize);
 void list_add(listptr pl, const genptr data);
 void list_free(listptr pl);
 void list_delete_element(listptr pl, const genptr data);
@@ -18,6 +18,7 @@ extern "C" {
 bool record_gpaless(const student *v1, const student *v2);
 bool str_less(const char **s1, const char **s2);
 bool int_less(const int *v1, const int *v2);
+bool int_greater(const int *v1, const int *v2);
 bool is_even(const int *v1);
 
 /* for search */
@@ -30,16 +30,138 @@
 #ifndef HEAP_H
 #define HEAP_H
 
+#include <stddef.h>
+
 
 // feel free to change HEAP_SIZE_BYTES to however
 // big you want the heap to be
 // [stevemac] I will define in in the makefile
 //#define HEAP_SIZE_BYTES (256)
+#ifdef HEAP_SIZE_BYTES
 #define HEAP_SIZE_WORDS (HEAP_SIZE_BYTES / sizeof(long))
+#endif
+
+// [stevemac] board builds define HEAP_LINKER_REGION instead (stm32.mak),
+// then the default heap is whatever SRAM the linker script leaves between
+// the end of .bss and the top of the stack.  HEAP_SBRK_RESERVE bytes above
+// .bss are left to newlib's malloc (printf buffers, semihosting) and
+// HEAP_STACK_RESERVE bytes below _estack to the main stack.  Link with
+// -Wl,--wrap=_sbrk (stm32.mak does), newlib's malloc then fails instead of
+// growing past the reserve into the heap.  More disjoint regions can be
+// added with Heap_AddRegion.
+#ifndef HEAP_STACK_RESERVE
+#define HEAP_STACK_RESERVE 8192
+#endif
+#ifndef HEAP_SBRK_RESERVE
+#define HEAP_SBRK_RESERVE 4096
+#endif
 
 #define HEAP_OK 0
 #define HEAP_ERROR_CORRUPTED_HEAP 1
 #define HEAP_ERROR_POINTER_OUT_OF_RANGE 2
+#define HEAP_ERROR_BAD_ARGUMENT 3
+
+// placement policies, see Heap_SetPolicy
+// [stevemac] two level segregated fit is the default, the others are kept
+// so they can be benchmarked against each other, see tests/heap-replay
+#define HEAP_POLICY_TLSF 0
+#define HEAP_POLICY_FIRST_FIT 1
+#define HEAP_POLICY_NEXT_FIT 2
+#define HEAP_POLICY_BEST_FIT 3
+#define HEAP_POLICY_COUNT 4
+
+// [stevemac] segregated free list geometry, see heap.c
+// second level classes per power of two, 1 << HEAP_SL_LOG2
+#define HEAP_SL_LOG2 2
+#define HEAP_SL_COUNT (1 << HEAP_SL_LOG2)
+// first level classes, rooms up to 2^(HEAP_FL_COUNT + HEAP_SL_LOG2 - 1) - 1
+#ifndef HEAP_FL_COUNT
+#define HEAP_FL_COUNT 24
+#endif
+
+// [stevemac] concurrent mode for host builds, define HEAP_THREADSAFE
+// (pthreads).  The default heap is guarded by one lock and each thread
+// keeps a cache of small blocks, rooms up to HEAP_CACHE_ROOMS words and
+// HEAP_CACHE_DEPTH blocks per room, so the common path never locks.
+// Never defined for the board.  The caches are left out with HEAP_TRACE,
+// every call has to reach the heap to be recorded.
+#ifndef HEAP_CACHE_ROOMS
+#define HEAP_CACHE_ROOMS 8
+#endif
+#ifndef HEAP_CACHE_DEPTH
+#define HEAP_CACHE_DEPTH 64
+#endif
+
+// [stevemac] blocks checked per Heap_TestStep call from an idle hook
+#ifndef HEAP_CHECK_BUDGET
+#define HEAP_CHECK_BUDGET 16
+#endif
+
+// [stevemac] allocation size histogram, bin n counts requests of
+// 2^n..2^(n+1)-1 bytes, the last bin everything bigger
+#ifndef HEAP_HISTOGRAM_BINS
+#define HEAP_HISTOGRAM_BINS 16
+#endif
+
+// [stevemac] allocation trace, define HEAP_TRACE to record every call on
+// the default heap into a RAM buffer of HEAP_TRACE_BYTES, see
+// Heap_TraceData.  A record is an opcode byte followed by unsigned LEB128
+// fields (7 bits per byte, low first):
+//   HEAP_TRACE_MALLOC  size, block
+//   HEAP_TRACE_FREE    block
+//   HEAP_TRACE_REALLOC block, size, new block
+// where a block is the word offset of the pointer from the heap start,
+// never 0 because of the header, and 0 stands for NULL.
+// Calloc is recorded as malloc.  Recording stops when the buffer is full,
+// what was recorded is still a valid trace.
+#ifndef HEAP_TRACE_BYTES
+#define HEAP_TRACE_BYTES 4096
+#endif
+#define HEAP_TRACE_MALLOC 1
+#define HEAP_TRACE_FREE 2
+#define HEAP_TRACE_REALLOC 3
+
+// [stevemac] relocatable blocks, see Heap_HandleAlloc.  Each heap has a
+// table of HEAP_HANDLE_COUNT master pointers, a handle is its index + 1
+// so 0 is never a valid handle.
+#ifndef HEAP_HANDLE_COUNT
+#define HEAP_HANDLE_COUNT 32
+#endif
+
+typedef long heap_handle_t;
+
+// master pointer of a relocatable block, block is its header or NULL
+typedef struct heap_handle_slot {
+  long* block;
+  long locks;
+} heap_handle_slot_t;
+
+// struct for one heap instance, treat as opaque
+// [stevemac] public so instances can be static or on the stack
+typedef struct heap {
+  long* start;
+  long* end;
+  long* freeLists[HEAP_FL_COUNT][HEAP_SL_COUNT];
+  unsigned long flBitmap;
+  unsigned char slBitmap[HEAP_FL_COUNT];
+  long policy;
+  long* rover; // where the next fit search starts
+  long* checkCursor; // where Heap_TestStep resumes
+  long checkPasses;
+  // telemetry, kept up to date by every call, see Heap_Telemetry
+  long usedWords;
+  long peakUsedWords;
+  long usedBlocks;
+  long freeBlocks;
+  long* highWater;
+  long failedMallocs;
+  unsigned long histogram[HEAP_HISTOGRAM_BINS];
+  heap_handle_slot_t handles[HEAP_HANDLE_COUNT];
+  // regions added by Heap_AddRegionIn, the gaps between them are bridged
+  // by used blocks that are not counted as used
+  long gaps;
+  long gapWords; // words in the gaps not owned by the heap
+} heap_t;
 
 // struct for holding statistics on the state of the heap
 typedef struct heap_stats {
@@ -49,13 +171,32 @@ typedef struct heap_stats {
   long blocksUsed;
   long blocksUnused;
 } heap_stats_t;
+
+// [stevemac] struct for the incrementally maintained counters, cheap
+// enough to read on a hot path unlike heap_stats_t
+typedef struct heap_telemetry {
+  long bytesInUse;       // room of the used blocks
+  long peakBytesInUse;   // most bytesInUse has ever been
+  long highWaterBytes;   // from the heap start to the end of the highest
+                         // block ever used, the heap size actually needed
+  long blocksInUse;
+  long bytesFree;        // room of the unused blocks
+  long blocksFree;
+  long largestFreeBytes; // room of the largest unused block
+  long fragmentation;    // per mille, 1000 - 1000 * largest / free
+  long failedMallocs;
+  long checkPasses;      // full passes of Heap_TestStep over the heap
+  unsigned long histogram[HEAP_HISTOGRAM_BINS]; // requests by log2 bytes
+} heap_telemetry_t;
 #ifdef __cplusplus
 extern "C" {
  #endif
 //******** Heap_Init *************** 
 // Initialize the Heap
 // input: none
-// output: always HEAP_OK
+// output: HEAP_OK, or with HEAP_LINKER_REGION HEAP_ERROR_BAD_ARGUMENT when
+//  the linker script leaves no room between .bss plus HEAP_SBRK_RESERVE
+//  and the stack reserve, the heap is then empty
 // notes: Initializes/resets the heap to a clean state where no memory
 //  is allocated.
 long Heap_Init(void);
@@ -88,11 +229,49 @@ void* Heap_Calloc(long desiredBytes);
 //    where the contents of the old block will be copied to
 // output: void* pointing to the new block or will return NULL
 //   if there is any reason the reallocation can't be completed
-// notes: the given block will be unallocated after its contents
+// notes: the block is resized in place when it shrinks or the next
+//   block is free and big enough, and the same pointer is returned.
+//   Otherwise the given block will be unallocated after its contents
 //   are copied to the new block
 void* Heap_Realloc(void* oldBlock, long desiredBytes);
 
 
+//******** Heap_MallocBatch *************** 
+// Allocate count blocks of the same size, data not initialized
+// input: 
+//   count: how many blocks
+//   desiredBytes: desired number of bytes for each block
+//   out: array of count pointers that receives the blocks
+// output: how many blocks were allocated, the rest of out is NULL
+// notes: [stevemac] the blocks are carved one after another from as few
+//   free blocks as possible, one search instead of count.  Each block is
+//   an ordinary block, free it with Heap_Free or Heap_FreeBatch.
+long Heap_MallocBatch(long count, long desiredBytes, void** out);
+
+
+//******** Heap_MallocAligned *************** 
+// Allocate memory aligned to a power of two, data not initialized
+// input: 
+//   desiredBytes: desired number of bytes to allocate
+//   align: alignment in bytes, a power of two, e.g. 16/32/64 for SIMD
+//     or DMA buffers
+// output: void* aligned to align or NULL if there isn't sufficient space
+//   or align is not a power of two
+// notes: [stevemac] the result is an ordinary block, the words skipped to
+//   reach the alignment become a free block of their own instead of padding.
+//   Free with Heap_FreeAligned or Heap_Free.  Heap_Realloc may move the
+//   block and lose the alignment.
+void* Heap_MallocAligned(long desiredBytes, size_t align);
+
+
+//******** Heap_FreeAligned *************** 
+// return a block from Heap_MallocAligned to the heap
+// input: pointer to memory to unallocate
+// output: same as Heap_Free
+// notes: the same as Heap_Free, kept so aligned allocations read in pairs
+long Heap_FreeAligned(void* pointer);
+
+
 //******** Heap_Free *************** 
 // return a block to the heap
 // input: pointer to memory to unallocate
@@ -103,6 +282,19 @@ void* Heap_Realloc(void* oldBlock, long desiredBytes);
 long Heap_Free(void* pointer);
 
 
+//******** Heap_FreeBatch *************** 
+// return count blocks to the heap
+// input: 
+//   pointers: blocks to unallocate, in any order, NULL entries are skipped
+//   count: how many pointers
+// output: HEAP_OK or the first error Heap_Free would have returned, the
+//   valid pointers are freed regardless
+// notes: [stevemac] every block is marked unused first and each run of
+//   adjacent unused blocks is merged once, so freeing a container's
+//   nodes does not coalesce and relink one node at a time
+long Heap_FreeBatch(void** pointers, long count);
+
+
 //******** Heap_Test *************** 
 // Test the heap
 // input: none
@@ -110,11 +302,176 @@ long Heap_Free(void* pointer);
 long Heap_Test(void);
 
 
+//******** Heap_TestStep *************** 
+// Test part of the heap, resuming where the last call stopped
+// input: budget, the most blocks to check, e.g. HEAP_CHECK_BUDGET
+// output: HEAP_OK or HEAP_ERROR_CORRUPTED_HEAP
+// notes: [stevemac] bounded cost per call for control loops and idle
+//  hooks, Heap_Telemetry counts the completed passes over the heap
+//  void vApplicationIdleHook(void){
+//    if(Heap_TestStep(HEAP_CHECK_BUDGET)) fault();
+//  }
+long Heap_TestStep(long budget);
+
+
 //******** Heap_Stats *************** 
 // return the current status of the heap
 // input: none
 // output: a heap_stats_t that describes the current usage of the heap
 heap_stats_t Heap_Stats(void);
+
+
+//******** Heap_SetPolicy *************** 
+// Select how Heap_Malloc finds a free block
+// input: HEAP_POLICY_TLSF, HEAP_POLICY_FIRST_FIT, HEAP_POLICY_NEXT_FIT
+//  or HEAP_POLICY_BEST_FIT
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT for an unknown policy
+// notes: may be changed at any time, the free lists are maintained
+//  regardless of the policy in effect.  First and next fit walk the heap
+//  by address, next fit from where the last search stopped.  Best fit
+//  takes the smallest block that fits, found through the free lists.
+long Heap_SetPolicy(long policy);
+
+
+//******** Heap_Telemetry *************** 
+// return the incrementally maintained counters of the heap
+// input: none
+// output: a heap_telemetry_t, see the struct
+// notes: does not walk the heap, only the free list of the largest size
+//  class which normally holds a single block.  Counters restart at
+//  Heap_Init.  Blocks in the per-thread caches count as used and cache
+//  hits are not in the histogram.
+heap_telemetry_t Heap_Telemetry(void);
+
+
+//******** Heap_TraceData *************** 
+// The allocation trace recorded since Heap_Init
+// input: bytes: set to the length of the trace
+// output: the trace, see HEAP_TRACE_MALLOC, or NULL without HEAP_TRACE
+// notes: on the board dump it with gdb or Heap_TraceSave (semihosting)
+const unsigned char* Heap_TraceData(size_t* bytes);
+
+
+//******** Heap_TraceSave *************** 
+// Write the allocation trace to a file
+// input: path of the file
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT if the file can't be written
+//  or the library was built without HEAP_TRACE
+long Heap_TraceSave(const char* path);
+
+
+//******** Heap_ThreadFlush *************** 
+// Return the calling thread's cached blocks to the default heap
+// input: none
+// output: none
+// notes: only does something when built with HEAP_THREADSAFE.  Runs
+//  automatically when a thread exits, call it before Heap_Test or
+//  Heap_Stats to see cached blocks as unused.
+void Heap_ThreadFlush(void);
+
+
+//******** Heap_HandleAlloc *************** 
+// Allocate a relocatable block, data not initialized
+// input: 
+//   desiredBytes: desired number of bytes to allocate
+// output: a handle or 0 if there isn't sufficient space or no free
+//   handle.  Compacts the heap and tries again before giving up.
+// notes: [stevemac] the block may move whenever it is not locked, get a
+//   pointer with Heap_HandleLock and drop it at Heap_HandleUnlock.
+//   A handle block costs one word more than a Heap_Malloc block, free it
+//   with Heap_HandleFree, never Heap_Free.
+//  heap_handle_t h = Heap_HandleAlloc(64);
+//  char* p = Heap_HandleLock(h);
+//  ... use p ...
+//  Heap_HandleUnlock(h);       // p may be stale from here on
+heap_handle_t Heap_HandleAlloc(long desiredBytes);
+
+
+//******** Heap_HandleLock *************** 
+// Pin a relocatable block and return its address
+// input: handle from Heap_HandleAlloc
+// output: pointer to the data or NULL for an invalid handle
+// notes: locks nest, the block stays put until every lock is released
+void* Heap_HandleLock(heap_handle_t handle);
+
+
+//******** Heap_HandleUnlock *************** 
+// Release one lock on a relocatable block
+// input: handle from Heap_HandleAlloc
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT for an invalid or unlocked
+//   handle
+long Heap_HandleUnlock(heap_handle_t handle);
+
+
+//******** Heap_HandleFree *************** 
+// return a relocatable block to the heap
+// input: handle from Heap_HandleAlloc, locked or not
+// output: HEAP_OK, HEAP_ERROR_BAD_ARGUMENT for an invalid handle or the
+//   errors of Heap_Free
+long Heap_HandleFree(heap_handle_t handle);
+
+
+//******** Heap_Compact *************** 
+// Slide unlocked relocatable blocks down over the free blocks below them
+// input: none
+// output: number of blocks moved
+// notes: [stevemac] one pass from the heap start.  Heap_Malloc blocks and
+//  locked handles never move, so free space only merges between them;
+//  keep long lived plain blocks at the start of the run to get the most
+//  out of it.  Handle calls are not recorded by HEAP_TRACE.
+long Heap_Compact(void);
+
+
+//******** Heap_InitRegion *************** 
+// Initialize a heap over a region of memory
+// input:
+//   heap: heap to initialize
+//   region: memory the heap manages, need not be aligned
+//   bytes: size of the region in bytes
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT if the region is too small
+//   to hold a single block
+// notes: Initializes/resets the heap to a clean state where no memory
+//  is allocated.  The placement policy is reset to HEAP_POLICY_TLSF.
+//  Regions larger than the free lists can index are truncated.
+long Heap_InitRegion(heap_t* heap, void* region, size_t bytes);
+
+
+//******** Heap_AddRegion *************** 
+// Give the default heap another region of memory
+// input:
+//   region: memory to add, above the end of the heap, need not be aligned
+//     or next to it
+//   bytes: size of the region in bytes
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT if the region is too small,
+//   below the end of the heap, or the highest block of the heap is in use
+// notes: [stevemac] the top free block gives two words to a used block
+//  that spans the gap up to the region, so the heap stays one chain of
+//  blocks and the walks, merges and compaction never read the gap.  Call
+//  right after Heap_Init, a block can never straddle two regions.
+//  Heap_Init drops the added regions.
+long Heap_AddRegion(void* region, size_t bytes);
+
+
+// Same as the functions above, on the given heap instead of the default
+// heap.  A pointer must be freed/reallocated on the heap it came from.
+void* Heap_MallocIn(heap_t* heap, long desiredBytes);
+void* Heap_CallocIn(heap_t* heap, long desiredBytes);
+long Heap_MallocBatchIn(heap_t* heap, long count, long desiredBytes, void** out);
+void* Heap_MallocAlignedIn(heap_t* heap, long desiredBytes, size_t align);
+void* Heap_ReallocIn(heap_t* heap, void* oldBlock, long desiredBytes);
+long Heap_FreeIn(heap_t* heap, void* pointer);
+long Heap_FreeBatchIn(heap_t* heap, void** pointers, long count);
+long Heap_TestIn(heap_t* heap);
+long Heap_TestStepIn(heap_t* heap, long budget);
+heap_stats_t Heap_StatsIn(heap_t* heap);
+heap_telemetry_t Heap_TelemetryIn(heap_t* heap);
+long Heap_SetPolicyIn(heap_t* heap, long policy);
+heap_handle_t Heap_HandleAllocIn(heap_t* heap, long desiredBytes);
+void* Heap_HandleLockIn(heap_t* heap, heap_handle_t handle);
+long Heap_HandleUnlockIn(heap_t* heap, heap_handle_t handle);
+long Heap_HandleFreeIn(heap_t* heap, heap_handle_t handle);
+long Heap_CompactIn(heap_t* heap);
+long Heap_AddRegionIn(heap_t* heap, void* region, size_t bytes);
 #ifdef __cplusplus
 }
 #endif // if cpp
@@ -4,6 +4,7 @@
  Copyright   : Licensed under GPL version 2 (GPLv2)
 ==============================================================================*/
 #pragma once
+#include "pool.h"
 
 typedef struct slist slist;
 typedef slist* slistptr;
@@ -13,6 +14,9 @@ extern "C" {
 #endif
 
 slistptr slist_alloc(const size_t datasize);
+slistptr slist_alloc_pool(const size_t datasize, poolptr pool);
+slistptr slist_alloc_with(const size_t datasize, const allocator *al);
+size_t slist_node_size(const size_t datasize);
 void slist_push(slistptr pl, const genptr data);
 void slist_free(slistptr pl);
 genptr slist_top(slistptr pl);
@@ -4,6 +4,7 @@
  Copyright   : Licensed under GPL version 2 (GPLv2)
 ==============================================================================*/
 #pragma once
+#include "allocator.h"
 
 typedef void* iterator;
 typedef struct polyarray polyarray;
@@ -17,6 +18,12 @@ polyptr poly_alloc(const size_t capacity, const size_t datasize,
 		   bool(*lessthan)(const genptr, const genptr),
 		   void(*swap)(genptr, genptr),
 		   void(*print)(const genptr));
+polyptr poly_alloc_with(const size_t capacity, const size_t datasize,
+			int (*cmp)(const genptr, const genptr),
+			bool(*lessthan)(const genptr, const genptr),
+			void(*swap)(genptr, genptr),
+			void(*print)(const genptr),
+			const allocator *al);
 void poly_free(polyptr pa);
 void poly_add(polyptr pa, const genptr data, const size_t count);
 iterator poly_at(polyptr pa, const size_t pos);
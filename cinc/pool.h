@@ -0,0 +1,32 @@
+/*==============================================================================
+ Name        : pool.h
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#pragma once
+#include "allocator.h"
+
+typedef struct pool pool;
+typedef pool* poolptr;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+poolptr pool_alloc(const size_t objsize, const size_t capacity);
+poolptr pool_attach(const genptr base, const size_t bytes, const size_t objsize);
+
+void pool_free(poolptr pp);
+void pool_detach(poolptr pp);
+
+genptr pool_get(poolptr pp);
+void pool_put(poolptr pp, genptr obj);
+
+bool pool_owns(const poolptr pp, const genptr obj);
+size_t pool_objsize(const poolptr pp);
+size_t pool_available(const poolptr pp);
+allocator pool_allocator(poolptr pp);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,112 @@
+/*==============================================================================
+ Name        : rng.h
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/* Pseudo random numbers without the C library rand().  rng is
+   xoshiro128** (16 bytes of state, 32 bit output, period 2^128 - 1),
+   rng_pcg32 is PCG32 (a 64 bit LCG with a permuted output and 2^63
+   selectable streams), rng_splitmix64 expands a seed for both.  A
+   generator is a plain struct, keep one per thread: rng_jump or a pcg32
+   stream number gives each thread its own sequence that never overlaps
+   the others.  Nothing here is cryptographic.  See rng.c */
+typedef struct rng {
+	uint32_t s[4];
+} rng;
+
+typedef struct rng_pcg32 {
+	uint64_t state;
+	uint64_t inc;
+} rng_pcg32;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void rng_seed(rng *r, uint64_t seed);
+void rng_jump(rng *r);
+void rng_long_jump(rng *r);
+
+void rng_pcg32_seed(rng_pcg32 *r, uint64_t seed, uint64_t stream);
+void rng_pcg32_advance(rng_pcg32 *r, uint64_t delta);
+
+/* bulk fills keep the state in registers for the whole buffer */
+void rng_fill_u32(rng *r, uint32_t *dest, const size_t count);
+void rng_fill_range(rng *r, uint32_t *dest, const size_t count,
+		    const uint32_t n);
+void rng_fill_float(rng *r, float *dest, const size_t count);
+
+/* the library's own generator, random_shuffle and rand_int use it */
+rng *rng_default(void);
+uint32_t rng_rand(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline uint64_t rng_splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+static inline uint32_t rng_rotl(const uint32_t x, const int k)
+{
+	return (x << k) | (x >> (32 - k));
+}
+static inline uint32_t rng_u32(rng *r)
+{
+	uint32_t *s = r->s;
+	uint32_t result = rng_rotl(s[1] * 5, 7) * 9;
+	uint32_t t = s[1] << 9;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rng_rotl(s[3], 11);
+	return result;
+}
+static inline uint32_t rng_pcg32_u32(rng_pcg32 *r)
+{
+	uint64_t old = r->state;
+	r->state = old * 6364136223846793005ull + r->inc;
+	uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	uint32_t rot = (uint32_t)(old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+/* Lemire's multiply and shift: the top half of a 32x32 bit product is in
+   [0, n), the low half says whether this draw is one of the 2^32 % n that
+   would make some values more likely, then it is drawn again.  One UMULL
+   and almost never a division, where rand() % n is a division and biased.
+   n of 0 gives 0. */
+static inline uint32_t rng_range(rng *r, const uint32_t n)
+{
+	uint64_t m = (uint64_t)rng_u32(r) * n;
+	if ((uint32_t)m < n) {
+		uint32_t t = -n % n;
+		while ((uint32_t)m < t)
+			m = (uint64_t)rng_u32(r) * n;
+	}
+	return (uint32_t)(m >> 32);
+}
+static inline uint32_t rng_pcg32_range(rng_pcg32 *r, const uint32_t n)
+{
+	uint64_t m = (uint64_t)rng_pcg32_u32(r) * n;
+	if ((uint32_t)m < n) {
+		uint32_t t = -n % n;
+		while ((uint32_t)m < t)
+			m = (uint64_t)rng_pcg32_u32(r) * n;
+	}
+	return (uint32_t)(m >> 32);
+}
+/* the top 24 bits, every float in [0, 1) a multiple of 2^-24 */
+static inline float rng_float(rng *r)
+{
+	return (float)(rng_u32(r) >> 8) * 0x1.0p-24f;
+}
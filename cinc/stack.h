@@ -4,6 +4,7 @@
  Copyright   : Licensed under GPL version 2 (GPLv2)
 ==============================================================================*/
 #pragma once
+#include "pool.h"
 
 typedef struct stack stack;
 typedef stack* stackptr;
@@ -13,6 +14,9 @@ extern "C" {
 #endif
 
 stackptr stack_alloc(const size_t datasize);
+stackptr stack_alloc_pool(const size_t datasize, poolptr pool);
+stackptr stack_alloc_with(const size_t datasize, const allocator *al);
+size_t stack_node_size(const size_t datasize);
 void stack_free(stackptr ps);
 void stack_push(stackptr ps, const genptr data);
 genptr stack_top(const stackptr ps);
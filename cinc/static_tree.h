@@ -4,6 +4,7 @@
  Copyright   : Licensed under GPL version 2 (GPLv2)
 ==============================================================================*/
 #pragma once
+#include "pool.h"
 
 typedef struct node node;
 typedef struct binarytree binarytree; 
@@ -16,6 +17,11 @@ extern "C" {
 #endif
 
 treeptr tree_alloc(int(*cmp)(const genptr v1, const genptr v2), bool fdupes);
+treeptr tree_alloc_pool(int(*cmp)(const genptr v1, const genptr v2), bool fdupes,
+			poolptr pool);
+treeptr tree_alloc_with(int(*cmp)(const genptr v1, const genptr v2), bool fdupes,
+			const allocator *al);
+size_t tree_node_size(void);
 void tree_free(treeptr pt);
 void tree_add(treeptr pt, const genptr val);
 genptr tree_find(treeptr pt, const genptr val);
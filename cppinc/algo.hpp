@@ -0,0 +1,372 @@
+/*==============================================================================
+ Name        : algo.hpp
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#pragma once
+#include <stddef.h>
+#include <concepts>
+#include <functional>
+#include <utility>
+
+/* Header only C++20 counterparts of algo.h.  The element type and the
+   functors are template parameters, so every compare, swap and visit is
+   inlined instead of called through a pointer.  Ranges are a pointer and
+   an element count like the C versions, sort is the same engine as
+   gensort. */
+namespace mlibs {
+
+template <typename F, typename T>
+concept less_than = std::strict_weak_order<F &, const T &, const T &>;
+
+template <typename F, typename T>
+concept unary_predicate = std::predicate<F &, const T &>;
+
+namespace detail {
+
+inline constexpr size_t sort_insertion_cutoff = 16;
+inline constexpr size_t sort_ninther_cutoff = 128;
+inline constexpr size_t sort_partial_limit = 8;
+
+template <typename T, typename Less>
+void sort_insertion(T *lo, T *hi, Less &less)
+{
+	for (T *key = lo + 1; key < hi; key++) {
+		if (!less(*key, key[-1]))
+			continue;
+		T tmp = std::move(*key);
+		T *p = key;
+		do {
+			*p = std::move(p[-1]);
+			p--;
+		} while (p > lo && less(tmp, p[-1]));
+		*p = std::move(tmp);
+	}
+}
+/* gives up after sort_partial_limit moves, true if the range got sorted */
+template <typename T, typename Less>
+bool sort_partial_insertion(T *lo, T *hi, Less &less)
+{
+	size_t moves = 0;
+	for (T *key = lo + 1; key < hi; key++) {
+		if (!less(*key, key[-1]))
+			continue;
+		T tmp = std::move(*key);
+		T *p = key;
+		do {
+			*p = std::move(p[-1]);
+			p--;
+		} while (p > lo && less(tmp, p[-1]));
+		*p = std::move(tmp);
+		moves += key - p;
+		if (moves > sort_partial_limit)
+			return false;
+	}
+	return true;
+}
+template <typename T, typename Less>
+void sort3(T *a, T *b, T *c, Less &less)
+{
+	using std::swap;
+	if (less(*b, *a))
+		swap(*a, *b);
+	if (less(*c, *b)) {
+		swap(*b, *c);
+		if (less(*b, *a))
+			swap(*a, *b);
+	}
+}
+template <typename T, typename Less>
+void sort_sift_down(T *base, size_t root, const size_t count, Less &less)
+{
+	using std::swap;
+	for (size_t child; (child = 2 * root + 1) < count; root = child) {
+		if (child + 1 < count && less(base[child], base[child + 1]))
+			child++;
+		if (!less(base[root], base[child]))
+			return;
+		swap(base[root], base[child]);
+	}
+}
+template <typename T, typename Less>
+void sort_heap(T *base, const size_t count, Less &less)
+{
+	using std::swap;
+	for (size_t i = count / 2; i-- > 0;)
+		sort_sift_down(base, i, count, less);
+	for (size_t end = count - 1; end > 0; end--) {
+		swap(base[0], base[end]);
+		sort_sift_down(base, 0, end, less);
+	}
+}
+/* pivot at lo, smaller elements end up left of it, the rest right of it */
+template <typename T, typename Less>
+T *sort_partition_right(T *lo, T *hi, Less &less, bool &sorted)
+{
+	using std::swap;
+	T *first = lo + 1;
+	T *last = hi - 1;
+	while (first <= last && less(*first, *lo))
+		first++;
+	while (last >= first && !less(*last, *lo))
+		last--;
+	sorted = first > last;
+	while (first < last) {
+		swap(*first, *last);
+		while (less(*++first, *lo))
+			;
+		while (!less(*--last, *lo))
+			;
+	}
+	T *pivot = first - 1;
+	if (pivot != lo)
+		swap(*lo, *pivot);
+	return pivot;
+}
+/* same with equal elements left of the pivot, nothing is less than it */
+template <typename T, typename Less>
+T *sort_partition_left(T *lo, T *hi, Less &less)
+{
+	using std::swap;
+	T *first = lo + 1;
+	T *last = hi - 1;
+	while (last >= first && less(*lo, *last))
+		last--;
+	while (first <= last && !less(*lo, *first))
+		first++;
+	while (first < last) {
+		swap(*first, *last);
+		while (less(*lo, *--last))
+			;
+		while (!less(*lo, *++first))
+			;
+	}
+	if (last != lo)
+		swap(*lo, *last);
+	return last;
+}
+template <typename T>
+void sort_break_pattern(T *lo, T *hi)
+{
+	using std::swap;
+	size_t quarter = (hi - lo) / 4;
+	swap(lo[0], lo[quarter]);
+	swap(hi[-1], hi[-1 - (ptrdiff_t)quarter]);
+	if (quarter > sort_ninther_cutoff / 4) {
+		swap(lo[1], lo[quarter + 1]);
+		swap(lo[2], lo[quarter + 2]);
+		swap(hi[-2], hi[-2 - (ptrdiff_t)quarter]);
+		swap(hi[-3], hi[-3 - (ptrdiff_t)quarter]);
+	}
+}
+template <typename T, typename Less>
+void sort_loop(T *lo, T *hi, Less &less, size_t bad, bool leftmost)
+{
+	using std::swap;
+	for (;;) {
+		size_t count = hi - lo;
+		if (count < sort_insertion_cutoff) {
+			sort_insertion(lo, hi, less);
+			return;
+		}
+
+		T *mid = lo + count / 2;
+		if (count > sort_ninther_cutoff) {
+			sort3(lo, mid, hi - 1, less);
+			sort3(lo + 1, mid - 1, hi - 2, less);
+			sort3(lo + 2, mid + 1, hi - 3, less);
+			sort3(mid - 1, mid, mid + 1, less);
+			swap(*lo, *mid);
+		} else {
+			sort3(mid, lo, hi - 1, less);
+		}
+
+		if (!leftmost && !less(lo[-1], *lo)) {
+			lo = sort_partition_left(lo, hi, less) + 1;
+			continue;
+		}
+
+		bool sorted;
+		T *pivot = sort_partition_right(lo, hi, less, sorted);
+		size_t left = pivot - lo;
+		size_t right = count - left - 1;
+		if (left < count / 8 || right < count / 8) {
+			if (--bad == 0) {
+				sort_heap(lo, count, less);
+				return;
+			}
+			if (left >= sort_insertion_cutoff)
+				sort_break_pattern(lo, pivot);
+			if (right >= sort_insertion_cutoff)
+				sort_break_pattern(pivot + 1, hi);
+		} else if (sorted) {
+			bool l = sort_partial_insertion(lo, pivot, less);
+			bool r = sort_partial_insertion(pivot + 1, hi, less);
+			if (l && r)
+				return;
+			if (l) {
+				lo = pivot + 1;
+				leftmost = false;
+				continue;
+			}
+			if (r) {
+				hi = pivot;
+				continue;
+			}
+		}
+
+		if (left < right) {
+			sort_loop(lo, pivot, less, bad, leftmost);
+			lo = pivot + 1;
+			leftmost = false;
+		} else {
+			sort_loop(pivot + 1, hi, less, bad, false);
+			hi = pivot;
+		}
+	}
+}
+} // namespace detail
+
+/**=============================================================================
+ Function:   sort
+
+ Purpose:    the gensort engine (introsort with the pattern defeating
+             quicksort refinements) on a typed range.  Not stable.
+
+ Parameters: base: array to sort.
+	     count: number of elements.
+	     less: strict weak order, std::less by default.
+
+Returns:     void
+
+Example:     int a[] = {9,8,7,6,5,4,3,2,1,0};
+	     mlibs::sort(a, _countof(a));
+	     mlibs::sort(recs, _countof(recs), [](auto &x, auto &y) {
+		     return x.gpa < y.gpa; });
+==============================================================================*/
+template <typename T, typename Less = std::less<T>>
+	requires less_than<Less, T>
+void sort(T *base, const size_t count, Less less = {})
+{
+	size_t bad = 1;
+	for (size_t n = count; n > 1; n >>= 1)
+		bad++;
+	detail::sort_loop(base, base + count, less, bad, true);
+}
+/**=============================================================================
+ Function:   search
+
+ Purpose:    binary search of a range sorted by less.
+
+Returns:     pointer to an element equal to key or nullptr.
+==============================================================================*/
+template <typename T, typename Less = std::less<T>>
+	requires less_than<Less, T>
+T *search(T *base, const T &key, const size_t count, Less less = {})
+{
+	if (count == 0)
+		return nullptr;
+	/* lower bound, the step is a conditional move rather than a branch */
+	T *first = base;
+	for (size_t len = count; len > 1;) {
+		size_t half = len / 2;
+		first = less(first[half - 1], key) ? first + half : first;
+		len -= half;
+	}
+	first += less(*first, key);
+	return (first < base + count && !less(key, *first)) ? first : nullptr;
+}
+/**=============================================================================
+ Functions:  visit, transform
+
+ Purpose:    visit calls func on each element, read only.  transform writes
+             func(src[i]) to dest[i], the ranges may be the same.
+==============================================================================*/
+template <typename T, typename F>
+	requires std::invocable<F &, const T &>
+void visit(const T *base, const size_t count, F func)
+{
+	for (const T *p = base; p < base + count; p++)
+		func(*p);
+}
+template <typename T, typename U, typename F>
+	requires std::invocable<F &, const U &> &&
+		 std::assignable_from<T &, std::invoke_result_t<F &, const U &>>
+void transform(T *dest, const U *src, const size_t count, F func)
+{
+	for (size_t i = 0; i < count; i++)
+		dest[i] = func(src[i]);
+}
+/**=============================================================================
+ Functions:  accumulate, count_if
+
+ Purpose:    accumulate folds the range into init with op, a sum by
+             default.  count_if counts the elements that meet pred.
+==============================================================================*/
+template <typename T, typename Acc = T, typename Op = std::plus<>>
+	requires std::invocable<Op &, Acc, const T &>
+Acc accumulate(const T *base, const size_t count, Acc init = Acc{},
+	       Op op = {})
+{
+	for (const T *p = base; p < base + count; p++)
+		init = op(std::move(init), *p);
+	return init;
+}
+template <typename T, typename Pred>
+	requires unary_predicate<Pred, T>
+size_t count_if(const T *base, const size_t count, Pred pred)
+{
+	size_t accum = 0;
+	for (const T *p = base; p < base + count; p++)
+		accum += pred(*p) ? 1 : 0;
+	return accum;
+}
+/**=============================================================================
+ Function:   merge
+
+ Purpose:    stable merge of two sorted ranges into dest, which must not
+             overlap them, the counterpart of merge_ranges.
+==============================================================================*/
+template <typename T, typename Less = std::less<T>>
+	requires less_than<Less, T>
+void merge(T *dest, const T *src1, const size_t count1, const T *src2,
+	   const size_t count2, Less less = {})
+{
+	const T *end1 = src1 + count1, *end2 = src2 + count2;
+	while (src1 < end1 && src2 < end2)
+		*dest++ = less(*src2, *src1) ? *src2++ : *src1++;
+	while (src1 < end1)
+		*dest++ = *src1++;
+	while (src2 < end2)
+		*dest++ = *src2++;
+}
+/**=============================================================================
+ Functions:  reverse, replace, replace_if
+==============================================================================*/
+template <typename T>
+	requires std::swappable<T>
+void reverse(T *base, const size_t count)
+{
+	using std::swap;
+	if (count < 2)
+		return;
+	for (T *l = base, *r = base + count - 1; l < r; l++, r--)
+		swap(*l, *r);
+}
+template <typename T>
+	requires std::equality_comparable<T>
+void replace(T *base, const size_t count, const T &oldval, const T &newval)
+{
+	for (T *p = base; p < base + count; p++)
+		if (*p == oldval)
+			*p = newval;
+}
+template <typename T, typename Pred>
+	requires unary_predicate<Pred, T>
+void replace_if(T *base, const size_t count, Pred pred, const T &newval)
+{
+	for (T *p = base; p < base + count; p++)
+		if (pred(*p))
+			*p = newval;
+}
+} // namespace mlibs
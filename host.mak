@@ -0,0 +1,27 @@
+# Native Linux toolchain for the analysis hosts, the host counterpart of
+# stm32.mak.  Used by the tests that only make sense off the board
+# (threads, trace replay, SIMD), include it after the configuration file.
+MLIBS_ROOT ?=$(HOME)/MLibs
+LIBINC ?=$(MLIBS_ROOT)/cinc
+CPPINC ?=$(MLIBS_ROOT)/cppinc
+LIBSRC ?=$(MLIBS_ROOT)/lib
+ASMSRC ?=$(LIBSRC)/asm
+
+#Host toolchain
+CC := gcc
+CXX := g++
+LD := $(CXX)
+AR := ar
+
+#The board heap is 8088 bytes, host tests may ask for more
+HEAP_SIZE_BYTES ?= 8088
+
+#Additional flags
+PREPROCESSOR_MACROS += HEAP_SIZE_BYTES=$(HEAP_SIZE_BYTES)
+INCLUDE_DIRS += $(LIBINC) $(CPPINC)
+LIBRARY_NAMES += m
+
+#Benchmarks are meaningless at -O0, this overrides the configuration file
+CFLAGS += -ggdb -std=gnu17 -O2 -pthread
+CXXFLAGS += -ggdb -std=c++20 -O2 -pthread
+LDFLAGS += -pthread
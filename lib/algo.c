@@ -6,6 +6,8 @@
 #include "precompile.h"
 #include "algo.h"
 #include "functor.h"
+#include "allocator.h"
+#include "rng.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
@@ -95,10 +97,230 @@ void modify(genptr base, const size_t count, const size_t size,
 	for (genptr p = base; p < base + (count * size); p += size)
 		mod(p);
 }
+/* sort engine tuning, see gensort */
+#define SORT_INSERTION_CUTOFF 16
+#define SORT_NINTHER_CUTOFF 128
+#define SORT_PARTIAL_LIMIT 8
+
+static void sort_insertion(genptr lo, genptr hi, const size_t size,
+			   bool (*cmp)(const genptr, const genptr),
+			   void (*swp)(genptr, genptr))
+{
+	for (genptr key = lo + size; key < hi; key += size)
+		for (genptr p = key; p > lo && cmp(p, p - size); p -= size)
+			swp(p, p - size);
+}
+/* gives up after SORT_PARTIAL_LIMIT swaps, true if the range got sorted */
+static bool sort_partial_insertion(genptr lo, genptr hi, const size_t size,
+				   bool (*cmp)(const genptr, const genptr),
+				   void (*swp)(genptr, genptr))
+{
+	size_t moves = 0;
+	for (genptr key = lo + size; key < hi; key += size)
+		for (genptr p = key; p > lo && cmp(p, p - size); p -= size) {
+			swp(p, p - size);
+			if (++moves > SORT_PARTIAL_LIMIT)
+				return false;
+		}
+	return true;
+}
+/* orders three elements in place, *a <= *b <= *c afterwards */
+static void sort3(genptr a, genptr b, genptr c,
+		  bool (*cmp)(const genptr, const genptr),
+		  void (*swp)(genptr, genptr))
+{
+	if (cmp(b, a))
+		swp(a, b);
+	if (cmp(c, b)) {
+		swp(b, c);
+		if (cmp(b, a))
+			swp(a, b);
+	}
+}
+static void sort_sift_down(genptr base, size_t root, const size_t count,
+			   const size_t size,
+			   bool (*cmp)(const genptr, const genptr),
+			   void (*swp)(genptr, genptr))
+{
+	for (size_t child; (child = 2 * root + 1) < count; root = child) {
+		if (child + 1 < count &&
+		    cmp(base + (child * size), base + ((child + 1) * size)))
+			child++;
+		if (!cmp(base + (root * size), base + (child * size)))
+			return;
+		swp(base + (root * size), base + (child * size));
+	}
+}
+static void sort_heap(genptr base, const size_t count, const size_t size,
+		      bool (*cmp)(const genptr, const genptr),
+		      void (*swp)(genptr, genptr))
+{
+	for (size_t i = count / 2; i-- > 0;)
+		sort_sift_down(base, i, count, size, cmp, swp);
+	for (size_t end = count - 1; end > 0; end--) {
+		swp(base, base + (end * size));
+		sort_sift_down(base, 0, end, size, cmp, swp);
+	}
+}
+/* pivot at lo, smaller elements end up left of it, the rest right of it.
+   Returns the pivot's final place, sorted is set if nothing was swapped */
+static genptr sort_partition_right(genptr lo, genptr hi, const size_t size,
+				   bool (*cmp)(const genptr, const genptr),
+				   void (*swp)(genptr, genptr), bool *sorted)
+{
+	genptr first = lo + size;
+	genptr last = hi - size;
+	while (first <= last && cmp(first, lo))
+		first += size;
+	while (last >= first && !cmp(last, lo))
+		last -= size;
+	*sorted = first > last;
+	while (first < last) {
+		swp(first, last);
+		do
+			first += size;
+		while (cmp(first, lo));
+		do
+			last -= size;
+		while (!cmp(last, lo));
+	}
+	genptr pivot = first - size;
+	if (pivot != lo)
+		swp(lo, pivot);
+	return pivot;
+}
+/* same with equal elements left of the pivot, used when nothing in the
+   range is less than the pivot so the left side is all equal to it */
+static genptr sort_partition_left(genptr lo, genptr hi, const size_t size,
+				  bool (*cmp)(const genptr, const genptr),
+				  void (*swp)(genptr, genptr))
+{
+	genptr first = lo + size;
+	genptr last = hi - size;
+	while (last >= first && cmp(lo, last))
+		last -= size;
+	while (first <= last && !cmp(lo, first))
+		first += size;
+	while (first < last) {
+		swp(first, last);
+		do
+			last -= size;
+		while (cmp(lo, last));
+		do
+			first += size;
+		while (!cmp(lo, first));
+	}
+	if (last != lo)
+		swp(lo, last);
+	return last;
+}
+/* swaps a few elements of a range that came out of an unbalanced partition
+   so the next pivot does not land on the same pattern */
+static void sort_break_pattern(genptr lo, genptr hi, const size_t size,
+			       void (*swp)(genptr, genptr))
+{
+	size_t quarter = ((hi - lo) / size) / 4;
+	swp(lo, lo + (quarter * size));
+	swp(hi - size, hi - ((quarter + 1) * size));
+	if (quarter > SORT_NINTHER_CUTOFF / 4) {
+		swp(lo + size, lo + ((quarter + 1) * size));
+		swp(lo + (2 * size), lo + ((quarter + 2) * size));
+		swp(hi - (2 * size), hi - ((quarter + 2) * size));
+		swp(hi - (3 * size), hi - ((quarter + 3) * size));
+	}
+}
+/* median of three, or of three medians on big ranges, to lo */
+static void sort_pivot(genptr lo, genptr hi, const size_t count,
+		       const size_t size,
+		       bool (*cmp)(const genptr, const genptr),
+		       void (*swp)(genptr, genptr))
+{
+	genptr mid = lo + ((count / 2) * size);
+	if (count > SORT_NINTHER_CUTOFF) {
+		sort3(lo, mid, hi - size, cmp, swp);
+		sort3(lo + size, mid - size, hi - (2 * size), cmp, swp);
+		sort3(lo + (2 * size), mid + size, hi - (3 * size), cmp, swp);
+		sort3(mid - size, mid, mid + size, cmp, swp);
+		swp(lo, mid);
+	} else {
+		sort3(mid, lo, hi - size, cmp, swp);
+	}
+}
+static void sort_loop(genptr lo, genptr hi, const size_t size,
+		      bool (*cmp)(const genptr, const genptr),
+		      void (*swp)(genptr, genptr), size_t bad, bool leftmost)
+{
+	for (;;) {
+		size_t count = (hi - lo) / size;
+		if (count < SORT_INSERTION_CUTOFF) {
+			sort_insertion(lo, hi, size, cmp, swp);
+			return;
+		}
+		sort_pivot(lo, hi, count, size, cmp, swp);
+
+		/* the element before the range is no bigger than any in it, if
+		   it equals the pivot skip everything equal in one pass */
+		if (!leftmost && !cmp(lo - size, lo)) {
+			lo = sort_partition_left(lo, hi, size, cmp, swp) + size;
+			continue;
+		}
+
+		bool sorted;
+		genptr pivot = sort_partition_right(lo, hi, size, cmp, swp,
+						    &sorted);
+		size_t left = (pivot - lo) / size;
+		size_t right = count - left - 1;
+		if (left < count / 8 || right < count / 8) {
+			/* too many bad pivots, heapsort bounds the worst case */
+			if (--bad == 0) {
+				sort_heap(lo, count, size, cmp, swp);
+				return;
+			}
+			if (left >= SORT_INSERTION_CUTOFF)
+				sort_break_pattern(lo, pivot, size, swp);
+			if (right >= SORT_INSERTION_CUTOFF)
+				sort_break_pattern(pivot + size, hi, size, swp);
+		} else if (sorted) {
+			bool left = sort_partial_insertion(lo, pivot, size, cmp,
+							   swp);
+			bool right = sort_partial_insertion(pivot + size, hi,
+							    size, cmp, swp);
+			if (left && right)
+				return;
+			if (left) {
+				lo = pivot + size;
+				leftmost = false;
+				continue;
+			}
+			if (right) {
+				hi = pivot;
+				continue;
+			}
+		}
+
+		/* recurse into the smaller side so the stack stays O(log n) */
+		if (left < right) {
+			sort_loop(lo, pivot, size, cmp, swp, bad, leftmost);
+			lo = pivot + size;
+			leftmost = false;
+		} else {
+			sort_loop(pivot + size, hi, size, cmp, swp, bad, false);
+			hi = pivot;
+		}
+	}
+}
 /**=============================================================================
  Function:   gensort
 
- Purpose:    sorts a contiguous block of bytes
+ Purpose:    sorts a contiguous block of bytes.  Introsort with the pattern
+             defeating quicksort refinements: median of three pivots (of
+	     three medians above SORT_NINTHER_CUTOFF elements), insertion sort
+	     below SORT_INSERTION_CUTOFF, runs equal to an earlier pivot
+	     skipped in one pass, already partitioned ranges finished with a
+	     bounded insertion sort, a few elements swapped after an
+	     unbalanced partition, and heapsort after log2(count) of those,
+	     so the worst case is O(n log n).  Sorted, reversed and few
+	     unique inputs are close to linear.  Not stable.
 
  Parameters: base: contiguous block of bytes to sort, typically an array.
 	     count: length of the block in bytes, typically array len.
@@ -118,50 +340,851 @@ void gensort(genptr base, const size_t count, const size_t size,
 	     void (*swp)(genptr, genptr))
 {
 	assert(base && cmp && swp);
-	for (genptr key = (base + size); key < (base + (count * size));
-	     key += size)
-		while (key > base && cmp(key, (key - size))) {
-			swp(key, (key - size));
-			key -= size;
+	size_t bad = 1;
+	for (size_t n = count; n > 1; n >>= 1)
+		bad++;
+	sort_loop(base, base + (count * size), size, cmp, swp, bad, true);
+}
+/* the k smallest of count elements to a max heap in the first k */
+static void select_heap(genptr base, const size_t k, const size_t count,
+			const size_t size,
+			bool (*cmp)(const genptr, const genptr),
+			void (*swp)(genptr, genptr))
+{
+	for (size_t i = k / 2; i-- > 0;)
+		sort_sift_down(base, i, k, size, cmp, swp);
+	for (genptr p = base + (k * size); p < base + (count * size);
+	     p += size)
+		if (cmp(p, base)) {
+			swp(p, base);
+			sort_sift_down(base, 0, k, size, cmp, swp);
+		}
+}
+static void select_loop(genptr lo, genptr nth, genptr hi, const size_t size,
+			bool (*cmp)(const genptr, const genptr),
+			void (*swp)(genptr, genptr), size_t bad, bool leftmost)
+{
+	for (;;) {
+		size_t count = (hi - lo) / size;
+		if (count < SORT_INSERTION_CUTOFF) {
+			sort_insertion(lo, hi, size, cmp, swp);
+			return;
 		}
+		sort_pivot(lo, hi, count, size, cmp, swp);
+
+		/* a run equal to an earlier pivot is in place as a whole */
+		if (!leftmost && !cmp(lo - size, lo)) {
+			genptr last = sort_partition_left(lo, hi, size, cmp,
+							  swp);
+			if (nth <= last)
+				return;
+			lo = last + size;
+			continue;
+		}
+
+		bool sorted;
+		genptr pivot = sort_partition_right(lo, hi, size, cmp, swp,
+						    &sorted);
+		if (pivot == nth)
+			return;
+		size_t left = (pivot - lo) / size;
+		size_t right = count - left - 1;
+		if (left < count / 8 || right < count / 8) {
+			/* too many bad pivots, a heap bounds it to O(n log k) */
+			if (--bad == 0) {
+				size_t k = (nth - lo) / size + 1;
+				select_heap(lo, k, count, size, cmp, swp);
+				swp(lo, nth);
+				return;
+			}
+			if (left >= SORT_INSERTION_CUTOFF)
+				sort_break_pattern(lo, pivot, size, swp);
+			if (right >= SORT_INSERTION_CUTOFF)
+				sort_break_pattern(pivot + size, hi, size, swp);
+		}
+		if (nth < pivot) {
+			hi = pivot;
+		} else {
+			lo = pivot + size;
+			leftmost = false;
+		}
+	}
+}
+/**=============================================================================
+ Function:   nth_element
+
+ Purpose:    Puts the element that would be at position nth after a sort
+             there, nothing before it is greater and nothing after it is
+	     less.  Introselect: the gensort partitioning, but only into the
+	     side that holds nth, so it is O(n) on average; after log2(count)
+	     unbalanced partitions the rest is done with a heap, O(n log n)
+	     at worst.  A median or a percentile of a sensor buffer without
+	     sorting it.  Not stable.
+
+ Parameters: base: contiguous block of bytes, typically an array.
+	     nth: position to fill, less than count.
+	     count, size, cmp, swp: same as gensort.
+
+Returns:     void
+
+Example:     nth_element(samples, count / 2, count, sizeof(int), int_less,
+			 int_swap);
+	     int median = samples[count / 2];
+==============================================================================*/
+void nth_element(genptr base, const size_t nth, const size_t count,
+		 const size_t size, bool (*cmp)(const genptr, const genptr),
+		 void (*swp)(genptr, genptr))
+{
+	assert(base && cmp && swp);
+	if (count == 0)
+		return;
+	assert(nth < count);
+	size_t bad = 1;
+	for (size_t n = count; n > 1; n >>= 1)
+		bad++;
+	select_loop(base, base + (nth * size), base + (count * size), size,
+		    cmp, swp, bad, true);
+}
+/**=============================================================================
+ Function:   partial_sort
+
+ Purpose:    Sorts the smallest middle elements of count into the front, the
+             rest are left in no particular order.  A max heap of the first
+	     middle elements takes every smaller element from the rest, then
+	     is sorted down, O(count log middle).  With a greater than cmp it
+	     is the top k.  Not stable.
+
+ Parameters: base: contiguous block of bytes, typically an array.
+	     middle: how many to sort, up to count.
+	     count, size, cmp, swp: same as gensort.
+
+Returns:     void
+
+Example:     partial_sort(samples, 10, count, sizeof(int), int_greater,
+			  int_swap);
+==============================================================================*/
+void partial_sort(genptr base, const size_t middle, const size_t count,
+		  const size_t size, bool (*cmp)(const genptr, const genptr),
+		  void (*swp)(genptr, genptr))
+{
+	assert(base && cmp && swp && middle <= count);
+	if (middle == 0)
+		return;
+	select_heap(base, middle, count, size, cmp, swp);
+	for (size_t end = middle - 1; end > 0; end--) {
+		swp(base, base + (end * size));
+		sort_sift_down(base, 0, end, size, cmp, swp);
+	}
+}
+/**=============================================================================
+ Function:   partial_sort_copy
+
+ Purpose:    Same as partial_sort, but the smallest elements of src are
+             sorted into dest and src is not touched.  dest is the heap, so
+	     only dcount elements of extra memory, e.g. the top 10 readings
+	     of a buffer that is still being sampled.
+
+ Parameters: dest: at least dcount elements, must not overlap src.
+	     dcount: how many to keep.
+	     src: scount elements to choose from.
+	     size, cmp, swp: same as gensort.
+
+Returns:     how many elements were written to dest, the smaller of dcount
+             and scount.
+
+Example:     int top[10];
+	     size_t n = partial_sort_copy(top, _countof(top), samples, count,
+					  sizeof(int), int_greater, int_swap);
+==============================================================================*/
+size_t partial_sort_copy(genptr dest, const size_t dcount, const genptr src,
+			 const size_t scount, const size_t size,
+			 bool (*cmp)(const genptr, const genptr),
+			 void (*swp)(genptr, genptr))
+{
+	assert(dest && src && cmp && swp);
+	size_t k = dcount < scount ? dcount : scount;
+	if (k == 0)
+		return 0;
+	memcpy(dest, src, k * size);
+	for (size_t i = k / 2; i-- > 0;)
+		sort_sift_down(dest, i, k, size, cmp, swp);
+	for (genptr p = src + (k * size); p < src + (scount * size); p += size)
+		if (cmp(p, dest)) {
+			memcpy(dest, p, size);
+			sort_sift_down(dest, 0, k, size, cmp, swp);
+		}
+	for (size_t end = k - 1; end > 0; end--) {
+		swp(dest, dest + (end * size));
+		sort_sift_down(dest, 0, end, size, cmp, swp);
+	}
+	return k;
+}
+/* stable sort engine tuning, see gensort_stable */
+#define STABLE_MIN_MERGE 32
+#define STABLE_MIN_GALLOP 7
+#define STABLE_MAX_RUNS 85
+
+typedef struct stable_run {
+	genptr base;
+	size_t len;
+} stable_run;
+
+typedef struct stable_state {
+	size_t size;
+	bool (*cmp)(const genptr, const genptr);
+	genptr tmp;       /* merge buffer, count / 2 elements */
+	genptr pivot;     /* one element after tmp */
+	size_t min_gallop;
+	size_t runs;
+	stable_run run[STABLE_MAX_RUNS];
+} stable_state;
+
+static void elem_swap(genptr a, genptr b, size_t size)
+{
+	unsigned char *pa = a, *pb = b;
+	while (size--) {
+		unsigned char t = *pa;
+		*pa++ = *pb;
+		*pb++ = t;
+	}
+}
+/* elements of a sorted range that are not greater than key */
+static size_t gallop_right(stable_state *st, const genptr key, genptr base,
+			   const size_t count)
+{
+	size_t lo = 0, ofs = 1;
+	while (ofs <= count && !st->cmp(key, base + ((ofs - 1) * st->size))) {
+		lo = ofs;
+		ofs = (ofs << 1) + 1;
+	}
+	size_t hi = (ofs <= count) ? ofs - 1 : count;
+	while (lo < hi) {
+		size_t mid = lo + ((hi - lo) / 2);
+		if (st->cmp(key, base + (mid * st->size)))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+/* elements of a sorted range that are less than key */
+static size_t gallop_left(stable_state *st, const genptr key, genptr base,
+			  const size_t count)
+{
+	size_t lo = 0, ofs = 1;
+	while (ofs <= count && st->cmp(base + ((ofs - 1) * st->size), key)) {
+		lo = ofs;
+		ofs = (ofs << 1) + 1;
+	}
+	size_t hi = (ofs <= count) ? ofs - 1 : count;
+	while (lo < hi) {
+		size_t mid = lo + ((hi - lo) / 2);
+		if (st->cmp(base + (mid * st->size), key))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+/* sorts [lo, hi) given [lo, start) is sorted, equal elements keep order */
+static void binary_insertion(stable_state *st, genptr lo, genptr start,
+			     genptr hi)
+{
+	size_t size = st->size;
+	for (genptr cur = start; cur < hi; cur += size) {
+		size_t pos = gallop_right(st, cur, lo, (cur - lo) / size);
+		genptr at = lo + (pos * size);
+		if (at == cur)
+			continue;
+		memcpy(st->pivot, cur, size);
+		memmove(at + size, at, cur - at);
+		memcpy(at, st->pivot, size);
+	}
+}
+/* length of the run at lo, a strictly descending run is reversed */
+static size_t count_run(stable_state *st, genptr lo, genptr hi)
+{
+	size_t size = st->size;
+	genptr p = lo + size;
+	if (p == hi)
+		return 1;
+	if (st->cmp(p, lo)) {
+		while (p + size < hi && st->cmp(p + size, p))
+			p += size;
+		for (genptr l = lo, r = p; l < r; l += size, r -= size)
+			elem_swap(l, r, size);
+	} else {
+		while (p + size < hi && !st->cmp(p + size, p))
+			p += size;
+	}
+	return (p - lo) / size + 1;
+}
+static size_t min_run(size_t count)
+{
+	size_t odd = 0;
+	while (count >= STABLE_MIN_MERGE) {
+		odd |= count & 1;
+		count >>= 1;
+	}
+	return count + odd;
+}
+/* adapts min_gallop: lower while galloping pays off, higher when not */
+static void gallop_done(stable_state *st, const bool paid)
+{
+	if (paid && st->min_gallop > 1)
+		st->min_gallop--;
+	else if (!paid)
+		st->min_gallop += 2;
+}
+/* merges a into b where a is the shorter run, a is copied to tmp first */
+static void merge_lo(stable_state *st, genptr a, size_t na, genptr b,
+		     size_t nb)
+{
+	size_t size = st->size;
+	genptr p1 = st->tmp, p2 = b, dest = a;
+	memcpy(st->tmp, a, na * size);
+	while (na && nb) {
+		size_t wins1 = 0, wins2 = 0;
+		do {
+			if (st->cmp(p2, p1)) {
+				memcpy(dest, p2, size);
+				p2 += size;
+				nb--;
+				wins2++;
+				wins1 = 0;
+			} else {
+				memcpy(dest, p1, size);
+				p1 += size;
+				na--;
+				wins1++;
+				wins2 = 0;
+			}
+			dest += size;
+		} while (na && nb && wins1 < st->min_gallop &&
+			 wins2 < st->min_gallop);
+
+		/* one side keeps winning, move whole stretches at a time */
+		while (na && nb) {
+			size_t k1 = gallop_right(st, p2, p1, na);
+			memcpy(dest, p1, k1 * size);
+			dest += k1 * size;
+			p1 += k1 * size;
+			na -= k1;
+			if (!na)
+				break;
+			size_t k2 = gallop_left(st, p1, p2, nb);
+			memmove(dest, p2, k2 * size);
+			dest += k2 * size;
+			p2 += k2 * size;
+			nb -= k2;
+			bool paid = k1 >= STABLE_MIN_GALLOP ||
+				    k2 >= STABLE_MIN_GALLOP;
+			gallop_done(st, paid);
+			if (!paid)
+				break;
+		}
+	}
+	/* what is left of b is already in place */
+	memcpy(dest, p1, na * size);
+}
+/* merges b into a where b is the shorter run, from the top down */
+static void merge_hi(stable_state *st, genptr a, size_t na, genptr b,
+		     size_t nb)
+{
+	size_t size = st->size;
+	genptr dest = b + (nb * size);
+	memcpy(st->tmp, b, nb * size);
+	while (na && nb) {
+		size_t wins1 = 0, wins2 = 0;
+		do {
+			genptr p1 = a + ((na - 1) * size);
+			genptr p2 = st->tmp + ((nb - 1) * size);
+			dest -= size;
+			if (st->cmp(p2, p1)) {
+				memcpy(dest, p1, size);
+				na--;
+				wins1++;
+				wins2 = 0;
+			} else {
+				memcpy(dest, p2, size);
+				nb--;
+				wins2++;
+				wins1 = 0;
+			}
+		} while (na && nb && wins1 < st->min_gallop &&
+			 wins2 < st->min_gallop);
+
+		while (na && nb) {
+			genptr key = st->tmp + ((nb - 1) * size);
+			size_t k1 = na - gallop_right(st, key, a, na);
+			dest -= k1 * size;
+			na -= k1;
+			memmove(dest, a + (na * size), k1 * size);
+			if (!na)
+				break;
+			key = a + ((na - 1) * size);
+			size_t k2 = nb - gallop_left(st, key, st->tmp, nb);
+			dest -= k2 * size;
+			nb -= k2;
+			memcpy(dest, st->tmp + (nb * size), k2 * size);
+			bool paid = k1 >= STABLE_MIN_GALLOP ||
+				    k2 >= STABLE_MIN_GALLOP;
+			gallop_done(st, paid);
+			if (!paid)
+				break;
+		}
+	}
+	/* what is left of a is already in place */
+	memcpy(a, st->tmp, nb * size);
+}
+/* merges run i with run i + 1 */
+static void merge_at(stable_state *st, const size_t i)
+{
+	size_t size = st->size;
+	genptr a = st->run[i].base;
+	genptr b = st->run[i + 1].base;
+	size_t na = st->run[i].len;
+	size_t nb = st->run[i + 1].len;
+	st->run[i].len = na + nb;
+	if (i + 2 < st->runs)
+		st->run[i + 1] = st->run[i + 2];
+	st->runs--;
+
+	/* the start of a and the end of b may already be in place */
+	size_t k = gallop_right(st, b, a, na);
+	a += k * size;
+	na -= k;
+	if (na == 0)
+		return;
+	nb = gallop_left(st, a + ((na - 1) * size), b, nb);
+	if (nb == 0)
+		return;
+	if (na <= nb)
+		merge_lo(st, a, na, b, nb);
+	else
+		merge_hi(st, a, na, b, nb);
+}
+/* keeps run lengths shrinking faster than the Fibonacci numbers, so the
+   stack stays short and merges stay balanced */
+static void merge_collapse(stable_state *st)
+{
+	while (st->runs > 1) {
+		size_t i = st->runs - 2;
+		stable_run *r = st->run;
+		if ((i > 0 && r[i - 1].len <= r[i].len + r[i + 1].len) ||
+		    (i > 1 && r[i - 2].len <= r[i - 1].len + r[i].len)) {
+			if (r[i - 1].len < r[i + 1].len)
+				i--;
+		} else if (r[i].len > r[i + 1].len) {
+			break;
+		}
+		merge_at(st, i);
+	}
+}
+static void merge_force_collapse(stable_state *st)
+{
+	while (st->runs > 1) {
+		size_t i = st->runs - 2;
+		if (i > 0 && st->run[i - 1].len < st->run[i + 1].len)
+			i--;
+		merge_at(st, i);
+	}
+}
+/**=============================================================================
+ Function:   gensort_stable, gensort_stable_with
+
+ Purpose:    stable sort of a contiguous block of bytes, equal elements keep
+             their order.  Timsort: the block is split into natural runs
+	     (descending runs are reversed), short runs are extended to a
+	     minimum length with a binary insertion sort, and runs are merged
+	     on a stack that keeps their lengths balanced.  Merges skip the
+	     parts of both runs already in place and switch to galloping
+	     (exponential search) while one run keeps winning.  O(n log n)
+	     compares, close to O(n) on nearly sorted input.  Elements are
+	     moved with memcpy, no swap functor is needed.
+
+ Parameters: base: contiguous block of bytes to sort, typically an array.
+	     count: length of the block in elements.
+	     size: byte length of an element.
+	     cmp: less than functor that defines the sorting criteria.
+	     al: allocator for the scratch buffer of count / 2 + 1 elements,
+	     e.g. an arena_allocator, NULL means the custom static heap.
+
+Returns:     false if the scratch buffer could not be allocated, the block
+             is then left as it was.
+
+Example:     gensort_stable(recs, _countof(recs), sizeof(student), gpa_less);
+==============================================================================*/
+bool gensort_stable_with(genptr base, const size_t count, const size_t size,
+			 bool (*cmp)(const genptr, const genptr),
+			 const allocator *al)
+{
+	assert(base && cmp && size);
+	if (count < 2)
+		return true;
+
+	allocator a = allocator_or_default(al);
+	stable_state *st = allocator_alloc(&a, sizeof(stable_state) +
+						   ((count / 2 + 1) * size));
+	if (st == NULL)
+		return false;
+	st->size = size;
+	st->cmp = cmp;
+	st->tmp = (genptr)(st + 1);
+	st->pivot = st->tmp + ((count / 2) * size);
+	st->min_gallop = STABLE_MIN_GALLOP;
+	st->runs = 0;
+
+	genptr lo = base;
+	genptr hi = base + (count * size);
+	size_t minrun = min_run(count);
+	while (lo < hi) {
+		size_t left = (hi - lo) / size;
+		size_t len = count_run(st, lo, hi);
+		if (len < minrun) {
+			size_t forced = (minrun < left) ? minrun : left;
+			binary_insertion(st, lo, lo + (len * size),
+					 lo + (forced * size));
+			len = forced;
+		}
+		st->run[st->runs].base = lo;
+		st->run[st->runs].len = len;
+		st->runs++;
+		merge_collapse(st);
+		lo += len * size;
+	}
+	merge_force_collapse(st);
+	allocator_free(&a, st);
+	return true;
+}
+bool gensort_stable(genptr base, const size_t count, const size_t size,
+		    bool (*cmp)(const genptr, const genptr))
+{
+	return gensort_stable_with(base, count, size, cmp, NULL);
+}
+/**=============================================================================
+ Function:   gensort_parallel, gensort_parallel_with
+
+ Purpose:    gensort on nthreads threads for big arrays on a host.  The
+             array is cut into one chunk per thread and each chunk is
+	     sorted with gensort, then the sorted runs are merged pairwise
+	     into a scratch buffer and back.  Every merge is split into
+	     pieces at binary searched cut points so all the threads keep
+	     working through the last merge, not just one.  Not stable.
+
+	     Only built with ALGO_PARALLEL defined (pthreads, host builds).
+	     Without it, below PARALLEL_CUTOFF elements, on one thread or
+	     when the scratch buffer (count elements) cannot be allocated it
+	     is plain gensort.
+
+ Parameters: same as gensort, plus
+	     nthreads: threads to use including the caller, 0 means one per
+	     online core, capped at PARALLEL_MAX_THREADS.
+	     al: allocator for the scratch buffer, e.g. system_allocator for
+	     arrays bigger than the custom static heap, NULL means the heap.
+
+Returns:     void
+
+Example:     gensort_parallel(samples, count, sizeof(int), int_genless,
+			      int_genswap, 0);
+==============================================================================*/
+#define PARALLEL_CUTOFF 65536
+#define PARALLEL_MAX_THREADS 64
+
+#ifdef ALGO_PARALLEL
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct sort_job {
+	genptr base; /* sort: count elements at base */
+	size_t count;
+	genptr dest; /* merge: src1 and src2 into dest */
+	genptr src1;
+	size_t count1;
+	genptr src2;
+	size_t count2;
+	size_t size;
+	bool (*cmp)(const genptr, const genptr);
+	void (*swp)(genptr, genptr);
+} sort_job;
+
+static void *sort_job_run(void *arg)
+{
+	sort_job *job = arg;
+	if (job->dest)
+		merge_ranges(job->dest, job->src1, job->count1, job->src2,
+			     job->count2, job->size, job->cmp);
+	else
+		gensort(job->base, job->count, job->size, job->cmp, job->swp);
+	return NULL;
+}
+/* the caller runs the first job, a thread that cannot start is run inline */
+static void sort_jobs_run(sort_job *jobs, const size_t njobs)
+{
+	pthread_t tids[PARALLEL_MAX_THREADS + 1];
+	bool started[PARALLEL_MAX_THREADS + 1];
+	for (size_t i = 1; i < njobs; i++)
+		started[i] = pthread_create(&tids[i], NULL, sort_job_run,
+					    &jobs[i]) == 0;
+	sort_job_run(&jobs[0]);
+	for (size_t i = 1; i < njobs; i++)
+		if (started[i])
+			pthread_join(tids[i], NULL);
+		else
+			sort_job_run(&jobs[i]);
+}
+/* first element of a sorted range not less than key */
+static size_t lower_bound(const genptr base, const size_t count,
+			  const size_t size, const genptr key,
+			  bool (*cmp)(const genptr, const genptr))
+{
+	size_t lo = 0, hi = count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (cmp(base + mid * size, key))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+/* adds the jobs that merge a and b into dest in pieces, cut at even
+   points of a and the matching lower bound in b */
+static size_t merge_jobs(sort_job *jobs, size_t njobs, const size_t pieces,
+			 genptr dest, const genptr a, const size_t na,
+			 const genptr b, const size_t nb, const size_t size,
+			 bool (*cmp)(const genptr, const genptr))
+{
+	size_t ai = 0, bi = 0;
+	for (size_t k = 1; k <= pieces; k++) {
+		size_t aj = na, bj = nb;
+		if (k < pieces) {
+			aj = na * k / pieces;
+			bj = aj < na ? lower_bound(b, nb, size, a + aj * size,
+						   cmp) :
+				       nb;
+			if (bj < bi)
+				bj = bi;
+		}
+		sort_job *job = &jobs[njobs++];
+		job->dest = dest + (ai + bi) * size;
+		job->src1 = a + ai * size;
+		job->count1 = aj - ai;
+		job->src2 = b + bi * size;
+		job->count2 = bj - bi;
+		job->size = size;
+		job->cmp = cmp;
+		ai = aj;
+		bi = bj;
+	}
+	return njobs;
+}
+static size_t parallel_threads(const size_t nthreads)
+{
+	long n = nthreads ? (long)nthreads : sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+		n = 1;
+	return n > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : (size_t)n;
+}
+void gensort_parallel_with(genptr base, const size_t count, const size_t size,
+			   bool (*cmp)(const genptr, const genptr),
+			   void (*swp)(genptr, genptr), const size_t nthreads,
+			   const allocator *al)
+{
+	assert(base && cmp && swp);
+	size_t threads = parallel_threads(nthreads);
+	allocator a = allocator_or_default(al);
+	genptr scratch = NULL;
+	if (threads > 1 && count >= PARALLEL_CUTOFF)
+		scratch = allocator_alloc(&a, count * size);
+	if (!scratch) {
+		gensort(base, count, size, cmp, swp);
+		return;
+	}
+
+	/* a round can add one job for an odd run out */
+	sort_job jobs[PARALLEL_MAX_THREADS + 1];
+	size_t bounds[PARALLEL_MAX_THREADS + 1];
+	memset(jobs, 0, sizeof(jobs));
+	for (size_t i = 0; i <= threads; i++)
+		bounds[i] = count * i / threads;
+	for (size_t i = 0; i < threads; i++) {
+		jobs[i].base = base + bounds[i] * size;
+		jobs[i].count = bounds[i + 1] - bounds[i];
+		jobs[i].size = size;
+		jobs[i].cmp = cmp;
+		jobs[i].swp = swp;
+	}
+	sort_jobs_run(jobs, threads);
+
+	/* merge pairs of runs from src into dst until one run is left */
+	genptr src = base, dst = scratch;
+	for (size_t runs = threads; runs > 1; runs = (runs + 1) / 2) {
+		size_t pairs = runs / 2, njobs = 0;
+		memset(jobs, 0, sizeof(jobs));
+		for (size_t r = 0; r + 1 < runs; r += 2) {
+			size_t lo = bounds[r], mid = bounds[r + 1];
+			size_t hi = bounds[r + 2];
+			njobs = merge_jobs(jobs, njobs, threads / pairs,
+					   dst + lo * size, src + lo * size,
+					   mid - lo, src + mid * size, hi - mid,
+					   size, cmp);
+		}
+		/* an odd run out is merged with nothing, a copy */
+		if (runs % 2) {
+			size_t lo = bounds[runs - 1], hi = bounds[runs];
+			njobs = merge_jobs(jobs, njobs, 1, dst + lo * size,
+					   src + lo * size, hi - lo,
+					   src + hi * size, 0, size, cmp);
+		}
+		sort_jobs_run(jobs, njobs);
+
+		for (size_t r = 0; r * 2 < runs; r++)
+			bounds[r] = bounds[r * 2];
+		bounds[(runs + 1) / 2] = count;
+		genptr tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+	if (src != base)
+		memcpy(base, src, count * size);
+	allocator_free(&a, scratch);
+}
+#else
+void gensort_parallel_with(genptr base, const size_t count, const size_t size,
+			   bool (*cmp)(const genptr, const genptr),
+			   void (*swp)(genptr, genptr), const size_t nthreads,
+			   const allocator *al)
+{
+	(void)nthreads;
+	(void)al;
+	gensort(base, count, size, cmp, swp);
+}
+#endif
+void gensort_parallel(genptr base, const size_t count, const size_t size,
+		      bool (*cmp)(const genptr, const genptr),
+		      void (*swp)(genptr, genptr), const size_t nthreads)
+{
+	gensort_parallel_with(base, count, size, cmp, swp, nthreads, NULL);
 }
 /**=============================================================================
  Function:   gensearch
 
- Purpose:    searches for a value in  a contiguous block of bytes
+ Purpose:    binary search of the sorted elements first to last (inclusive)
+             of a contiguous block of bytes.  It is a lower bound search:
+	     every step halves the range with the same arithmetic whatever
+	     cmp says, so the compiler can pick between the two halves with
+	     a conditional move instead of a branch the predictor misses half
+	     the time.  One more compare checks the element found.  An empty
+	     range, last < first or first = 0 and last = count - 1 with a
+	     count of 0, returns NULL.
 
  Parameters: base: contiguous block of bytes to search, typically an array.
-	     count: length of the block in bytes, typically array len.
+	     key: pointer to the value to look for.
+	     first, last: indexes of the first and last element to search.
 	     size: byte length of a chuck to be used as an array element.
 	     cmp: user defined functor that defines the sorting criteria.
 	     (see functor.h and c for some common functors to use.)
 
-Returns:     pointer to found element or NULL of not found.
+Returns:     pointer to the first element equal to key or NULL if not found.
 
-Example:     int a[] = {9,8,7,6,5,4,3,2,1,0};
-	     int * p = gensearch(a, _countof(a), sizeof(int), cmp_int);
+Example:     int a[] = {0,1,2,3,4,5,6,7,8,9};
+	     int key = 7;
+	     int * p = gensearch(a, &key, 0, _countof(a) - 1, sizeof(int),
+				 int_gencmp);
 ==============================================================================*/
-genptr gensearch(genptr base, const genptr key, size_t first, size_t last,  
-	         const size_t size, int (*cmp)(const genptr, const genptr))
+genptr gensearch(genptr base, const genptr key, size_t first, size_t last,
+		 const size_t size, int (*cmp)(const genptr, const genptr))
 {
 	assert(base && key && cmp);
-	
-	while(last >= first) {
-		size_t mid = (last + first) / 2;
-		
-		genptr cur = base + (mid * size);
-		
-		int ret = 0;
-		if((ret =cmp(key, cur)) == 0)
-			return cur;
-		
-		if(ret < 0)
-			last = mid - 1;
-		else
-			first = mid + 1;
+	size_t len = last - first + 1;
+	if (last < first || len == 0)
+		return NULL;
 
+	genptr p = base + first * size;
+	while (len > 1) {
+		size_t half = len / 2;
+		p = (cmp(p + (half - 1) * size, key) < 0) ? p + half * size : p;
+		len -= half;
+	}
+	int ret = cmp(p, key);
+	if (ret < 0) {
+		/* lower bound is one past p, unless p is last */
+		p += size;
+		if (p > base + last * size)
+			return NULL;
+		ret = cmp(p, key);
+	}
+	return ret == 0 ? p : NULL;
+}
+/**=============================================================================
+ Function:   gensearch_batch
+
+ Purpose:    gensearch for nkeys keys at once.  The keys are searched in
+             groups of SEARCH_BATCH that step through the table together,
+	     every search in a group takes the same number of steps because
+	     the steps only depend on count.  The probes of a group are
+	     independent, so on a host the cache misses of a big table
+	     overlap instead of one search waiting on each miss, each next
+	     probe is prefetched while the rest of the group steps.  Keys
+	     need not be sorted.
+
+ Parameters: base: sorted array of count elements of size bytes.
+	     keys: array of nkeys keys, same element size.
+	     results: nkeys pointers, each the first element equal to its
+	     key or NULL.
+
+Returns:     void
+
+Example:     int table[1024], keys[64];
+	     int *found[64];
+	     gensearch_batch(table, 1024, keys, 64, sizeof(int), int_gencmp,
+			     (genptr *)found);
+==============================================================================*/
+#define SEARCH_BATCH 8
+void gensearch_batch(const genptr base, const size_t count, const genptr keys,
+		     const size_t nkeys, const size_t size,
+		     int (*cmp)(const genptr, const genptr), genptr *results)
+{
+	assert(base && keys && cmp && results);
+	genptr p[SEARCH_BATCH];
+	for (size_t k0 = 0; k0 < nkeys; k0 += SEARCH_BATCH) {
+		size_t group = nkeys - k0 < SEARCH_BATCH ? nkeys - k0 :
+							   SEARCH_BATCH;
+		genptr gkeys = keys + k0 * size;
+		if (count == 0) {
+			for (size_t k = 0; k < group; k++)
+				results[k0 + k] = NULL;
+			continue;
+		}
+		for (size_t k = 0; k < group; k++)
+			p[k] = base;
+
+		for (size_t len = count; len > 1;) {
+			size_t half = len / 2;
+			size_t next = (len - half) / 2;
+			for (size_t k = 0; k < group; k++) {
+				genptr key = gkeys + k * size;
+				p[k] = (cmp(p[k] + (half - 1) * size, key) < 0) ?
+					       p[k] + half * size :
+					       p[k];
+				if (next)
+					__builtin_prefetch(p[k] +
+							   (next - 1) * size);
+			}
+			len -= half;
+		}
+
+		genptr end = base + count * size;
+		for (size_t k = 0; k < group; k++) {
+			genptr key = gkeys + k * size;
+			if (cmp(p[k], key) < 0)
+				p[k] += size;
+			results[k0 + k] = (p[k] < end && cmp(p[k], key) == 0) ?
+						  p[k] :
+						  NULL;
+		}
 	}
-	return NULL;
 }
 /* non-modifying algorithms for unsorted ranges */
 /**=============================================================================
@@ -282,6 +1305,9 @@ void reverse_copy(genptr dest, const genptr src, const size_t count,
 /**=============================================================================
  Function:   merge
  Purpose:    merge two sorted ranges into one sorted range beginning at dest.
+             count is the total, neither source length is known, so once one
+	     range runs out the other is read past its end unless the ranges
+	     are back to back.  Prefer merge_ranges.
   ==============================================================================*/
 void merge(genptr dest, const genptr src1, const genptr src2, const size_t count,
 	   const size_t size, bool(*pred)(const genptr, const genptr))
@@ -298,6 +1324,33 @@ void merge(genptr dest, const genptr src1, const genptr src2, const size_t count
 		}
 	}
 }
+/**=============================================================================
+ Function:   merge_ranges
+ Purpose:    merge two sorted ranges of count1 and count2 elements into one
+             sorted range beginning at dest, which must not overlap them.
+	     Stable, on equal elements the one from src1 comes first.
+  ==============================================================================*/
+void merge_ranges(genptr dest, const genptr src1, const size_t count1,
+		  const genptr src2, const size_t count2, const size_t size,
+		  bool (*pred)(const genptr, const genptr))
+{
+	assert(dest && pred && (src1 || !count1) && (src2 || !count2));
+	genptr ps1 = src1, ps2 = src2, pd = dest;
+	genptr end1 = src1 + (count1 * size), end2 = src2 + (count2 * size);
+	while (ps1 < end1 && ps2 < end2) {
+		if (pred(ps2, ps1)) {
+			memcpy(pd, ps2, size);
+			ps2 += size;
+		} else {
+			memcpy(pd, ps1, size);
+			ps1 += size;
+		}
+		pd += size;
+	}
+	memcpy(pd, ps1, end1 - ps1);
+	pd += end1 - ps1;
+	memcpy(pd, ps2, end2 - ps2);
+}
 /**=============================================================================
  Function:   swap_ranges
   ==============================================================================*/
@@ -360,22 +1413,98 @@ void copy_backward(genptr dest, const genptr src, const size_t count,
 	assert(dest && src);
 	memmove(dest, src, count * size);
 }
-void rotate(genptr base, const size_t count, const size_t size)
+/* exchanges two blocks of bytes that do not overlap */
+static void swap_blocks(genptr p1, genptr p2, size_t bytes)
 {
+	unsigned char tmp[64];
+	while (bytes) {
+		size_t n = bytes < sizeof(tmp) ? bytes : sizeof(tmp);
+		memcpy(tmp, p1, n);
+		memcpy(p1, p2, n);
+		memcpy(p2, tmp, n);
+		p1 += n;
+		p2 += n;
+		bytes -= n;
+	}
 }
 /**=============================================================================
- Function:   random_shuffle
+ Function:   rotate
+
+ Purpose:    Rotates the elements left so the one at middle comes first and
+             the ones before it go to the end, in order.  Block swap (Gries
+	     and Mills): the shorter side is swapped with the block of the
+	     same length on the longer side next to middle, which puts one
+	     of the two blocks in its final place, and the rest is rotated
+	     again.  An element can be swapped on several passes, count -
+	     gcd(middle, count) element swaps in all, e.g. count - 1 with a
+	     middle of 1.  Blocks are swapped with memcpy through a small
+	     stack buffer, so no swap functor and no heap.
+
+ Parameters: base: contiguous block of bytes, typically an array.
+	     middle: element that becomes the first, up to count.
+	     count: number of elements.
+	     size: byte length of an element.
+
+Returns:     void
+
+Example:     int a[] = {0,1,2,3,4};
+	     rotate(a, 2, _countof(a), sizeof(int));   2,3,4,0,1
+==============================================================================*/
+void rotate(genptr base, const size_t middle, const size_t count,
+	    const size_t size)
+{
+	assert(base && middle <= count);
+	genptr p = base;
+	size_t left = middle, right = count - middle;
+	while (left && right) {
+		if (left <= right) {
+			swap_blocks(p, p + (left * size), left * size);
+			p += left * size;
+			right -= left;
+		} else {
+			swap_blocks(p + ((left - right) * size),
+				    p + (left * size), right * size);
+			left -= right;
+		}
+	}
+}
+/**=============================================================================
+ Function:   random_shuffle, random_shuffle_with
+ Purpose:    Fisher-Yates, every order equally likely: each element from the
+             back swaps with one of those before it or itself, picked with
+	     rng_range (unbiased, see rng.h).  random_shuffle draws from
+	     rng_default, the _with version from the caller's generator, e.g.
+	     one per thread.  Reproducible for a given seed.  Past 2^32
+	     elements (64 bit hosts) the index is a 64 bit draw.
   ==============================================================================*/
+/* [0, n) for any size_t: rng_range up to 32 bits, above that two draws
+   masked to the bits of n - 1, drawn again while not below n */
+static size_t shuffle_index(rng *r, const size_t n)
+{
+	if (n <= UINT32_MAX)
+		return rng_range(r, (uint32_t)n);
+	uint64_t mask = UINT64_MAX >> __builtin_clzll((uint64_t)n - 1);
+	uint64_t x;
+	do {
+		x = (uint64_t)rng_u32(r) << 32;
+		x = (x | rng_u32(r)) & mask;
+	} while (x >= n);
+	return (size_t)x;
+}
+void random_shuffle_with(genptr base, const size_t count, const size_t size,
+			 void (*swap)(genptr, genptr), rng *r)
+{
+	assert(base && swap && r);
+	for (size_t i = count; i > 1; i--) {
+		size_t j = shuffle_index(r, i);
+		if (j != i - 1)
+			swap(base + ((i - 1) * size), base + (j * size));
+	}
+}
 void random_shuffle(genptr base, const size_t count, const size_t size,
 		    void(*swap)(genptr, genptr))
 {
-	assert(base && swap);
-	int modr = count-1;
-	for(genptr p = base + ((count-1) * size); p >= base; p -= size) {
-		int r = (modr > 0) ? (rand() % modr) : 0;
-		swap(p, base + (r * size));
-		modr--;
-	}
+	random_shuffle_with(base, count, size, swap, rng_default());
 }
 
 /* numeric algorithms */
@@ -410,28 +1539,136 @@ int product(const genptr base, const size_t count, const size_t size,
 
 /**=============================================================================
  Function:   inner_product
- Purpose:    calculates the sum of products of two ranges (adds the sums).
+ Purpose:    calculates the sum of the products of the elements of two
+             ranges, first1[0] * first2[0] + first1[1] * first2[1] ...
+	     prod gives the value of an element.  int, for exact 64 bit
+	     or float results see dot_int and dot_float in algo_reduce.c.
  ==============================================================================*/
 int inner_product(const genptr first1, const genptr first2, const size_t count,
 		  const size_t size, int(*prod)(const genptr))
 {
 	assert(first1 && first2 && prod);
-	int sum1=1;
-	int sum2=1;
+	int sum = 0;
 
 	for(genptr p1=first1, p2=first2; p1 < (first1 + (count * size));
-	    p1 += size, p2 += size){
-		sum1 *= prod(p1);
-		sum2 *= prod(p2);
-	}
-	
-	return sum1 + sum2;
+	    p1 += size, p2 += size)
+		sum += prod(p1) * prod(p2);
+
+	return sum;
 }
 
 /* common specializations */
+/* radix sort tuning, see sort_u32 */
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (32 / RADIX_BITS)
+#define RADIX_CUTOFF 64
+#define RADIX_SIGN 0x80000000u
+
+_Static_assert(sizeof(int) == sizeof(uint32_t) &&
+	       sizeof(float) == sizeof(uint32_t), "radix keys are 32 bits");
+
+static bool u32_less(const uint32_t *v1, const uint32_t *v2)
+{
+	return *v1 < *v2;
+}
+static void u32_swap(uint32_t *v1, uint32_t *v2)
+{
+	uint32_t t = *v1;
+	*v1 = *v2;
+	*v2 = t;
+}
+/* LSD radix sort on unsigned keys, one counting pass for every digit and
+   one scatter pass per digit that is not the same in all keys */
+static void radix_sort_u32(uint32_t *keys, const size_t count)
+{
+	if (count < RADIX_CUTOFF) {
+		gensort(keys, count, sizeof(uint32_t), u32_less, u32_swap);
+		return;
+	}
+	size_t (*counts)[RADIX_BUCKETS] = Heap_Malloc(
+		(RADIX_PASSES * RADIX_BUCKETS * sizeof(size_t)) +
+		(count * sizeof(uint32_t)));
+	if (counts == NULL) {
+		gensort(keys, count, sizeof(uint32_t), u32_less, u32_swap);
+		return;
+	}
+	uint32_t *scratch = (uint32_t *)(counts + RADIX_PASSES);
+	memset(counts, 0, RADIX_PASSES * RADIX_BUCKETS * sizeof(size_t));
+	for (size_t i = 0; i < count; i++)
+		for (int pass = 0; pass < RADIX_PASSES; pass++)
+			counts[pass][(keys[i] >> (pass * RADIX_BITS)) &
+				     (RADIX_BUCKETS - 1)]++;
+
+	uint32_t *src = keys, *dest = scratch;
+	for (int pass = 0; pass < RADIX_PASSES; pass++) {
+		size_t *bucket = counts[pass];
+		unsigned shift = pass * RADIX_BITS;
+		if (bucket[(src[0] >> shift) & (RADIX_BUCKETS - 1)] == count)
+			continue;
+		size_t offset = 0;
+		for (int b = 0; b < RADIX_BUCKETS; b++) {
+			size_t n = bucket[b];
+			bucket[b] = offset;
+			offset += n;
+		}
+		for (size_t i = 0; i < count; i++)
+			dest[bucket[(src[i] >> shift) & (RADIX_BUCKETS - 1)]++] =
+				src[i];
+		uint32_t *t = src;
+		src = dest;
+		dest = t;
+	}
+	if (src != keys)
+		memcpy(keys, src, count * sizeof(uint32_t));
+	Heap_Free(counts);
+}
+/**=============================================================================
+ Functions:  sort_int, sort_u32, sort_float
+
+ Purpose:    sort 32 bit keys with an LSD radix sort, 8 bit digits so the
+             four digit counts fit in 4 KB on the board.  The counts for
+	     every digit are taken in one pass, a digit that is the same in
+	     every key is skipped.  int keys are sorted with the sign bit
+	     flipped and float keys with the IEEE sign flip (negatives
+	     inverted, positives sign flipped), so -0.0 sorts before 0.0 and
+	     NaNs with the sign bit first, other NaNs last.  The scratch
+	     buffer, count keys plus the counts, comes from the custom
+	     static heap; below RADIX_CUTOFF keys or when it cannot be had
+	     gensort is used.
+
+ Parameters: base: array of keys.
+	     count: number of keys.
+
+Returns:     void
+
+Example:     float samples[1000];
+	     sort_float(samples, _countof(samples));
+==============================================================================*/
 void sort_int(genptr base, const size_t count)
 {
-	gensort(base, count, sizeof(int), int_less, int_swap);
+	assert(base || !count);
+	uint32_t *keys = base;
+	for (size_t i = 0; i < count; i++)
+		keys[i] ^= RADIX_SIGN;
+	radix_sort_u32(keys, count);
+	for (size_t i = 0; i < count; i++)
+		keys[i] ^= RADIX_SIGN;
+}
+void sort_u32(genptr base, const size_t count)
+{
+	assert(base || !count);
+	radix_sort_u32(base, count);
+}
+void sort_float(genptr base, const size_t count)
+{
+	assert(base || !count);
+	uint32_t *keys = base;
+	for (size_t i = 0; i < count; i++)
+		keys[i] = (keys[i] & RADIX_SIGN) ? ~keys[i] : keys[i] | RADIX_SIGN;
+	radix_sort_u32(keys, count);
+	for (size_t i = 0; i < count; i++)
+		keys[i] = (keys[i] & RADIX_SIGN) ? keys[i] & ~RADIX_SIGN : ~keys[i];
 }
 void sort_str(genptr base, const size_t count)
 {
@@ -439,7 +1676,7 @@ void sort_str(genptr base, const size_t count)
 }
 genptr search_int(const genptr base, const genptr val, size_t first, size_t last)
 {
-	return gensearch(base, val, first, last, sizeof(int), int_cmp);
+	return search_int_lt(base, val, first, last);
 }
 
 genptr search_str(const genptr base, const genptr val, size_t first, size_t last)
@@ -0,0 +1,206 @@
+/*==============================================================================
+ Name        : algo_reduce.c
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#include "precompile.h"
+#include "algo.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+/**=============================================================================
+ Interface:  typed reductions
+
+ Purpose:    Sums and dot products of int, float and double buffers without
+             the per element callback of accumulate and inner_product, and
+	     without their int overflow.  Integers add into int64_t, exact
+	     for any count the board can hold.  Floats add in REDUCE_LANES
+	     independent accumulators, so each add does not wait on the one
+	     before it and the compiler can pipeline or vectorize the loop.
+
+	     sum_float, sum_double and the dot products are pairwise: blocks
+	     of REDUCE_BLOCK elements summed in lanes, the block sums added
+	     in a balanced tree, so the rounding error grows with log2(count)
+	     rather than count, at the speed of a plain loop.  The _kahan
+	     versions carry the lost low bits along in a second accumulator,
+	     the error does not grow with count at all, for about twice the
+	     adds.  Do not build this file with -ffast-math, it would
+	     reassociate the compensation away.
+
+	     The results of the float versions can differ in the last bits
+	     from a sequential loop, which is the least accurate of them.
+==============================================================================*/
+#define REDUCE_LANES 8
+#define REDUCE_BLOCK 128
+#define KAHAN_LANES 4
+
+#define SUM_TERM(a, b, i) ((void)(b), (a)[i])
+#define DOT_TERM(a, b, i) ((a)[i] * (b)[i])
+
+/* NAME##_block sums up to REDUCE_BLOCK terms in lanes, NAME##_pairwise
+   halves bigger ranges down to blocks */
+#define DEFINE_PAIRWISE(T, NAME, TERM)                                         \
+	static T NAME##_block(const T *a, const T *b, const size_t count)      \
+	{                                                                      \
+		T acc[REDUCE_LANES] = {0};                                     \
+		size_t i = 0;                                                  \
+		for (; i + REDUCE_LANES <= count; i += REDUCE_LANES)           \
+			for (size_t k = 0; k < REDUCE_LANES; k++)              \
+				acc[k] += TERM(a, b, i + k);                   \
+		for (size_t k = 0; i < count; i++, k++)                        \
+			acc[k] += TERM(a, b, i);                               \
+		for (size_t w = REDUCE_LANES / 2; w; w /= 2)                   \
+			for (size_t k = 0; k < w; k++)                         \
+				acc[k] += acc[k + w];                          \
+		return acc[0];                                                 \
+	}                                                                      \
+	static T NAME##_pairwise(const T *a, const T *b, const size_t count)   \
+	{                                                                      \
+		if (count <= REDUCE_BLOCK)                                     \
+			return NAME##_block(a, b, count);                      \
+		size_t half = count / 2;                                       \
+		return NAME##_pairwise(a, b, half) +                           \
+		       NAME##_pairwise(a + half, b ? b + half : NULL,          \
+				       count - half);                          \
+	}
+
+DEFINE_PAIRWISE(float, sum_float, SUM_TERM)
+DEFINE_PAIRWISE(double, sum_double, SUM_TERM)
+DEFINE_PAIRWISE(float, dot_float, DOT_TERM)
+DEFINE_PAIRWISE(double, dot_double, DOT_TERM)
+
+/* Kahan in KAHAN_LANES lanes, the lane sums and their compensations then
+   added with Neumaier's variant, which also holds when a term is bigger
+   than the running sum */
+#define DEFINE_KAHAN(T, NAME, FABS)                                            \
+	static T NAME##_lanes(const T *base, const size_t count)               \
+	{                                                                      \
+		T sum[KAHAN_LANES] = {0}, comp[KAHAN_LANES] = {0};             \
+		size_t i = 0;                                                  \
+		for (; i + KAHAN_LANES <= count; i += KAHAN_LANES)             \
+			for (size_t k = 0; k < KAHAN_LANES; k++) {             \
+				T y = base[i + k] - comp[k];                   \
+				T t = sum[k] + y;                              \
+				comp[k] = (t - sum[k]) - y;                    \
+				sum[k] = t;                                    \
+			}                                                      \
+		T total = 0, lost = 0;                                         \
+		for (size_t k = 0; k < KAHAN_LANES + (count - i); k++) {       \
+			T x = k < KAHAN_LANES ? sum[k] - comp[k] :             \
+						base[i + k - KAHAN_LANES];     \
+			T t = total + x;                                       \
+			if (FABS(total) >= FABS(x))                            \
+				lost += (total - t) + x;                       \
+			else                                                   \
+				lost += (x - t) + total;                       \
+			total = t;                                             \
+		}                                                              \
+		return total + lost;                                           \
+	}
+
+DEFINE_KAHAN(float, sum_float_kahan, fabsf)
+DEFINE_KAHAN(double, sum_double_kahan, fabs)
+
+/**=============================================================================
+ Functions:  sum_int, dot_int
+
+ Purpose:    sum and dot product of ints in int64_t, in four lanes.  The
+             sum is exact for any count below 2^32, the dot product while
+	     the total fits, e.g. 2^32 products of 16 bit samples.  On the
+	     board each dot step is one SMLAL.
+
+ Parameters: base, first1, first2: count ints.
+
+Returns:     the sum or the dot product, 0 for an empty range.
+
+Example:     int64_t energy = dot_int(samples, samples, count);
+==============================================================================*/
+int64_t sum_int(const int *base, const size_t count)
+{
+	assert(base || !count);
+	int64_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		a0 += base[i];
+		a1 += base[i + 1];
+		a2 += base[i + 2];
+		a3 += base[i + 3];
+	}
+	for (; i < count; i++)
+		a0 += base[i];
+	return (a0 + a1) + (a2 + a3);
+}
+int64_t dot_int(const int *first1, const int *first2, const size_t count)
+{
+	assert((first1 && first2) || !count);
+	int64_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		a0 += (int64_t)first1[i] * first2[i];
+		a1 += (int64_t)first1[i + 1] * first2[i + 1];
+		a2 += (int64_t)first1[i + 2] * first2[i + 2];
+		a3 += (int64_t)first1[i + 3] * first2[i + 3];
+	}
+	for (; i < count; i++)
+		a0 += (int64_t)first1[i] * first2[i];
+	return (a0 + a1) + (a2 + a3);
+}
+/**=============================================================================
+ Functions:  sum_float, sum_double, dot_float, dot_double
+
+ Purpose:    pairwise sums and dot products, see the interface notes above.
+             float stays float: the board's FPU is single precision and a
+	     double add there is a library call.
+
+ Parameters: base, first1, first2: count elements.
+
+Returns:     the sum or the dot product, 0 for an empty range.
+
+Example:     float mean = sum_float(volts, count) / count;
+==============================================================================*/
+float sum_float(const float *base, const size_t count)
+{
+	assert(base || !count);
+	return sum_float_pairwise(base, NULL, count);
+}
+double sum_double(const double *base, const size_t count)
+{
+	assert(base || !count);
+	return sum_double_pairwise(base, NULL, count);
+}
+float dot_float(const float *first1, const float *first2, const size_t count)
+{
+	assert((first1 && first2) || !count);
+	return dot_float_pairwise(first1, first2, count);
+}
+double dot_double(const double *first1, const double *first2,
+		  const size_t count)
+{
+	assert((first1 && first2) || !count);
+	return dot_double_pairwise(first1, first2, count);
+}
+/**=============================================================================
+ Functions:  sum_float_kahan, sum_double_kahan
+
+ Purpose:    compensated sums, see the interface notes above.  For long
+             runs of small readings added to a big offset, where even the
+	     pairwise sum loses digits.
+
+ Parameters: base: count elements.
+
+Returns:     the sum, 0 for an empty range.
+
+Example:     float charge = sum_float_kahan(milliamps, count) * dt;
+==============================================================================*/
+float sum_float_kahan(const float *base, const size_t count)
+{
+	assert(base || !count);
+	return sum_float_kahan_lanes(base, count);
+}
+double sum_double_kahan(const double *base, const size_t count)
+{
+	assert(base || !count);
+	return sum_double_kahan_lanes(base, count);
+}
+#pragma GCC diagnostic pop
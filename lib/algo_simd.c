@@ -0,0 +1,659 @@
+/*==============================================================================
+ Name        : algo_simd.c
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#include "precompile.h"
+#include "algo.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+/**=============================================================================
+ Interface:  int and float kernels
+
+ Purpose:    count_if_int_eq, accumulate_int, equal_int, replace_int,
+             min_int, max_int, reverse_int and the float versions run
+	     without callbacks.  On an x86 host each has an SSE2 and an AVX2
+	     kernel, the best one the CPU supports is picked on the first
+	     call.  Every other target (the board) gets the scalar loops,
+	     which the compiler is free to vectorize itself.
+
+	     accumulate_int wraps like int arithmetic with -fwrapv, the
+	     result is the same at every level.  accumulate_float adds in
+	     lanes, so the last bits can differ from a sequential loop and
+	     between levels.  The float compares are the C operators: NaN
+	     never compares equal, min and max skip NaN unless every element
+	     is NaN, -0.0f equals 0.0f.
+==============================================================================*/
+typedef struct simd_ops {
+	size_t (*count_int_eq)(const int *, const size_t, const int);
+	int (*accumulate_int)(const int *, const size_t);
+	float (*accumulate_float)(const float *, const size_t);
+	bool (*equal_int)(const int *, const int *, const size_t);
+	bool (*equal_float)(const float *, const float *, const size_t);
+	void (*replace_int)(int *, const size_t, const int, const int);
+	void (*replace_float)(float *, const size_t, const float, const float);
+	int (*min_int)(const int *, const size_t);
+	int (*max_int)(const int *, const size_t);
+	float (*min_float)(const float *, const size_t);
+	float (*max_float)(const float *, const size_t);
+	void (*reverse32)(uint32_t *, const size_t);
+} simd_ops;
+
+/* scalar kernels, also the tails of the vector ones */
+static size_t count_int_eq_scalar(const int *base, const size_t count,
+				  const int val)
+{
+	size_t accum = 0;
+	for (size_t i = 0; i < count; i++)
+		accum += base[i] == val;
+	return accum;
+}
+static int accumulate_int_scalar(const int *base, const size_t count)
+{
+	unsigned accum = 0;
+	for (size_t i = 0; i < count; i++)
+		accum += (unsigned)base[i];
+	return (int)accum;
+}
+static float accumulate_float_scalar(const float *base, const size_t count)
+{
+	float accum = 0.0f;
+	for (size_t i = 0; i < count; i++)
+		accum += base[i];
+	return accum;
+}
+static bool equal_int_scalar(const int *first1, const int *first2,
+			     const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		if (first1[i] != first2[i])
+			return false;
+	return true;
+}
+static bool equal_float_scalar(const float *first1, const float *first2,
+			       const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		if (!(first1[i] == first2[i]))
+			return false;
+	return true;
+}
+static void replace_int_scalar(int *base, const size_t count, const int oldval,
+			       const int newval)
+{
+	for (size_t i = 0; i < count; i++)
+		if (base[i] == oldval)
+			base[i] = newval;
+}
+static void replace_float_scalar(float *base, const size_t count,
+				 const float oldval, const float newval)
+{
+	for (size_t i = 0; i < count; i++)
+		if (base[i] == oldval)
+			base[i] = newval;
+}
+static int min_int_scalar(const int *base, const size_t count)
+{
+	int m = base[0];
+	for (size_t i = 1; i < count; i++)
+		m = base[i] < m ? base[i] : m;
+	return m;
+}
+static int max_int_scalar(const int *base, const size_t count)
+{
+	int m = base[0];
+	for (size_t i = 1; i < count; i++)
+		m = base[i] > m ? base[i] : m;
+	return m;
+}
+/* a NaN m is replaced by the first number, NaN elements never win */
+static float min_float_scalar(const float *base, const size_t count)
+{
+	float m = base[0];
+	for (size_t i = 1; i < count; i++)
+		m = (base[i] < m || m != m) ? base[i] : m;
+	return m;
+}
+static float max_float_scalar(const float *base, const size_t count)
+{
+	float m = base[0];
+	for (size_t i = 1; i < count; i++)
+		m = (base[i] > m || m != m) ? base[i] : m;
+	return m;
+}
+static void reverse32_scalar(uint32_t *base, const size_t count)
+{
+	if (count < 2)
+		return;
+	for (uint32_t *l = base, *r = base + count - 1; l < r; l++, r--) {
+		uint32_t tmp = *l;
+		*l = *r;
+		*r = tmp;
+	}
+}
+static const simd_ops scalar_ops = {
+	count_int_eq_scalar, accumulate_int_scalar, accumulate_float_scalar,
+	equal_int_scalar, equal_float_scalar, replace_int_scalar,
+	replace_float_scalar, min_int_scalar, max_int_scalar,
+	min_float_scalar, max_float_scalar, reverse32_scalar
+};
+
+#ifdef SIMD_X86
+/* SSE2, the x86-64 baseline.  Unaligned loads, 4 lanes. */
+#define SSE2 __attribute__((target("sse2")))
+#define LOAD128(p) _mm_loadu_si128((const __m128i *)(p))
+
+SSE2 static int hsum_epi32(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4e));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xb1));
+	return _mm_cvtsi128_si32(v);
+}
+SSE2 static float hsum_ps(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 0x55));
+	return _mm_cvtss_f32(v);
+}
+SSE2 static size_t count_int_eq_sse2(const int *base, const size_t count,
+				     const int val)
+{
+	__m128i key = _mm_set1_epi32(val), acc = _mm_setzero_si128();
+	size_t i = 0;
+	/* each lane counts down by one (-1 is all ones) per match */
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = LOAD128(base + i);
+		acc = _mm_sub_epi32(acc, _mm_cmpeq_epi32(v, key));
+	}
+	return (size_t)(unsigned)hsum_epi32(acc) +
+	       count_int_eq_scalar(base + i, count - i, val);
+}
+SSE2 static int accumulate_int_sse2(const int *base, const size_t count)
+{
+	__m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		a0 = _mm_add_epi32(a0, LOAD128(base + i));
+		a1 = _mm_add_epi32(a1, LOAD128(base + i + 4));
+	}
+	unsigned tail = (unsigned)accumulate_int_scalar(base + i, count - i);
+	return (int)((unsigned)hsum_epi32(_mm_add_epi32(a0, a1)) + tail);
+}
+SSE2 static float accumulate_float_sse2(const float *base, const size_t count)
+{
+	__m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		a0 = _mm_add_ps(a0, _mm_loadu_ps(base + i));
+		a1 = _mm_add_ps(a1, _mm_loadu_ps(base + i + 4));
+	}
+	return hsum_ps(_mm_add_ps(a0, a1)) +
+	       accumulate_float_scalar(base + i, count - i);
+}
+SSE2 static bool equal_int_sse2(const int *first1, const int *first2,
+				const size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i a = LOAD128(first1 + i);
+		__m128i b = LOAD128(first2 + i);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) != 0xffff)
+			return false;
+	}
+	return equal_int_scalar(first1 + i, first2 + i, count - i);
+}
+SSE2 static bool equal_float_sse2(const float *first1, const float *first2,
+				  const size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 eq = _mm_cmpeq_ps(_mm_loadu_ps(first1 + i),
+					 _mm_loadu_ps(first2 + i));
+		if (_mm_movemask_ps(eq) != 0xf)
+			return false;
+	}
+	return equal_float_scalar(first1 + i, first2 + i, count - i);
+}
+SSE2 static void replace_int_sse2(int *base, const size_t count,
+				  const int oldval, const int newval)
+{
+	__m128i o = _mm_set1_epi32(oldval), n = _mm_set1_epi32(newval);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = LOAD128(base + i);
+		__m128i m = _mm_cmpeq_epi32(v, o);
+		v = _mm_or_si128(_mm_and_si128(m, n), _mm_andnot_si128(m, v));
+		_mm_storeu_si128((__m128i *)(base + i), v);
+	}
+	replace_int_scalar(base + i, count - i, oldval, newval);
+}
+SSE2 static void replace_float_sse2(float *base, const size_t count,
+				    const float oldval, const float newval)
+{
+	__m128 o = _mm_set1_ps(oldval), n = _mm_set1_ps(newval);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_loadu_ps(base + i);
+		__m128 m = _mm_cmpeq_ps(v, o);
+		v = _mm_or_ps(_mm_and_ps(m, n), _mm_andnot_ps(m, v));
+		_mm_storeu_ps(base + i, v);
+	}
+	replace_float_scalar(base + i, count - i, oldval, newval);
+}
+/* SSE2 has no pminsd/pmaxsd, select with a compare mask */
+SSE2 static __m128i min_epi32_sse2(__m128i a, __m128i b)
+{
+	__m128i gt = _mm_cmpgt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+SSE2 static __m128i max_epi32_sse2(__m128i a, __m128i b)
+{
+	__m128i gt = _mm_cmpgt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+SSE2 static int min_int_sse2(const int *base, const size_t count)
+{
+	if (count < 4)
+		return min_int_scalar(base, count);
+	__m128i m = LOAD128(base);
+	size_t i = 4;
+	for (; i + 4 <= count; i += 4)
+		m = min_epi32_sse2(m, LOAD128(base + i));
+	int lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, m);
+	int r = min_int_scalar(lanes, 4);
+	if (i < count) {
+		int t = min_int_scalar(base + i, count - i);
+		r = t < r ? t : r;
+	}
+	return r;
+}
+SSE2 static int max_int_sse2(const int *base, const size_t count)
+{
+	if (count < 4)
+		return max_int_scalar(base, count);
+	__m128i m = LOAD128(base);
+	size_t i = 4;
+	for (; i + 4 <= count; i += 4)
+		m = max_epi32_sse2(m, LOAD128(base + i));
+	int lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, m);
+	int r = max_int_scalar(lanes, 4);
+	if (i < count) {
+		int t = max_int_scalar(base + i, count - i);
+		r = t > r ? t : r;
+	}
+	return r;
+}
+/* minps returns the second operand when either is NaN, with the lanes
+   second and starting at infinity a NaN element is skipped.  Infinity at
+   the end may mean every element was NaN, the scalar scan sorts that out. */
+SSE2 static float min_float_sse2(const float *base, const size_t count)
+{
+	__m128 m = _mm_set1_ps(INFINITY);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		m = _mm_min_ps(_mm_loadu_ps(base + i), m);
+	float lanes[5];
+	_mm_storeu_ps(lanes, m);
+	lanes[4] = INFINITY;
+	if (i < count)
+		lanes[4] = min_float_scalar(base + i, count - i);
+	float r = min_float_scalar(lanes, 5);
+	return r == INFINITY ? min_float_scalar(base, count) : r;
+}
+SSE2 static float max_float_sse2(const float *base, const size_t count)
+{
+	__m128 m = _mm_set1_ps(-INFINITY);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		m = _mm_max_ps(_mm_loadu_ps(base + i), m);
+	float lanes[5];
+	_mm_storeu_ps(lanes, m);
+	lanes[4] = -INFINITY;
+	if (i < count)
+		lanes[4] = max_float_scalar(base + i, count - i);
+	float r = max_float_scalar(lanes, 5);
+	return r == -INFINITY ? max_float_scalar(base, count) : r;
+}
+/* swap 4 lane blocks from both ends, reversing each, the middle is scalar */
+SSE2 static void reverse32_sse2(uint32_t *base, const size_t count)
+{
+	uint32_t *l = base, *r = base + count;
+	for (; r - l >= 8; l += 4, r -= 4) {
+		__m128i a = LOAD128(l);
+		__m128i b = LOAD128(r - 4);
+		_mm_storeu_si128((__m128i *)l, _mm_shuffle_epi32(b, 0x1b));
+		_mm_storeu_si128((__m128i *)(r - 4),
+				 _mm_shuffle_epi32(a, 0x1b));
+	}
+	reverse32_scalar(l, r - l);
+}
+static const simd_ops sse2_ops = {
+	count_int_eq_sse2, accumulate_int_sse2, accumulate_float_sse2,
+	equal_int_sse2, equal_float_sse2, replace_int_sse2,
+	replace_float_sse2, min_int_sse2, max_int_sse2,
+	min_float_sse2, max_float_sse2, reverse32_sse2
+};
+
+/* AVX2, 8 lanes */
+#define AVX2 __attribute__((target("avx2")))
+#define LOAD256(p) _mm256_loadu_si256((const __m256i *)(p))
+
+AVX2 static int hsum256_epi32(__m256i v)
+{
+	__m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+				  _mm256_extracti128_si256(v, 1));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+	return _mm_cvtsi128_si32(s);
+}
+AVX2 static float hsum256_ps(__m256 v)
+{
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v),
+			      _mm256_extractf128_ps(v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+	return _mm_cvtss_f32(s);
+}
+AVX2 static size_t count_int_eq_avx2(const int *base, const size_t count,
+				     const int val)
+{
+	__m256i key = _mm256_set1_epi32(val), acc = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i v = LOAD256(base + i);
+		acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(v, key));
+	}
+	return (size_t)(unsigned)hsum256_epi32(acc) +
+	       count_int_eq_scalar(base + i, count - i, val);
+}
+AVX2 static int accumulate_int_avx2(const int *base, const size_t count)
+{
+	__m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		a0 = _mm256_add_epi32(a0, LOAD256(base + i));
+		a1 = _mm256_add_epi32(a1, LOAD256(base + i + 8));
+	}
+	unsigned tail = (unsigned)accumulate_int_scalar(base + i, count - i);
+	return (int)((unsigned)hsum256_epi32(_mm256_add_epi32(a0, a1)) + tail);
+}
+AVX2 static float accumulate_float_avx2(const float *base, const size_t count)
+{
+	__m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		a0 = _mm256_add_ps(a0, _mm256_loadu_ps(base + i));
+		a1 = _mm256_add_ps(a1, _mm256_loadu_ps(base + i + 8));
+	}
+	return hsum256_ps(_mm256_add_ps(a0, a1)) +
+	       accumulate_float_scalar(base + i, count - i);
+}
+AVX2 static bool equal_int_avx2(const int *first1, const int *first2,
+				const size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i a = LOAD256(first1 + i);
+		__m256i b = LOAD256(first2 + i);
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, b)) != -1)
+			return false;
+	}
+	return equal_int_scalar(first1 + i, first2 + i, count - i);
+}
+AVX2 static bool equal_float_avx2(const float *first1, const float *first2,
+				  const size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 a = _mm256_loadu_ps(first1 + i);
+		__m256 b = _mm256_loadu_ps(first2 + i);
+		__m256 eq = _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+		if (_mm256_movemask_ps(eq) != 0xff)
+			return false;
+	}
+	return equal_float_scalar(first1 + i, first2 + i, count - i);
+}
+AVX2 static void replace_int_avx2(int *base, const size_t count,
+				  const int oldval, const int newval)
+{
+	__m256i o = _mm256_set1_epi32(oldval), n = _mm256_set1_epi32(newval);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i v = LOAD256(base + i);
+		v = _mm256_blendv_epi8(v, n, _mm256_cmpeq_epi32(v, o));
+		_mm256_storeu_si256((__m256i *)(base + i), v);
+	}
+	replace_int_scalar(base + i, count - i, oldval, newval);
+}
+AVX2 static void replace_float_avx2(float *base, const size_t count,
+				    const float oldval, const float newval)
+{
+	__m256 o = _mm256_set1_ps(oldval), n = _mm256_set1_ps(newval);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 v = _mm256_loadu_ps(base + i);
+		v = _mm256_blendv_ps(v, n, _mm256_cmp_ps(v, o, _CMP_EQ_OQ));
+		_mm256_storeu_ps(base + i, v);
+	}
+	replace_float_scalar(base + i, count - i, oldval, newval);
+}
+AVX2 static int min_int_avx2(const int *base, const size_t count)
+{
+	if (count < 8)
+		return min_int_scalar(base, count);
+	__m256i m = LOAD256(base);
+	size_t i = 8;
+	for (; i + 8 <= count; i += 8)
+		m = _mm256_min_epi32(m, LOAD256(base + i));
+	int lanes[9];
+	_mm256_storeu_si256((__m256i *)lanes, m);
+	lanes[8] = i < count ? min_int_scalar(base + i, count - i) : lanes[0];
+	return min_int_scalar(lanes, 9);
+}
+AVX2 static int max_int_avx2(const int *base, const size_t count)
+{
+	if (count < 8)
+		return max_int_scalar(base, count);
+	__m256i m = LOAD256(base);
+	size_t i = 8;
+	for (; i + 8 <= count; i += 8)
+		m = _mm256_max_epi32(m, LOAD256(base + i));
+	int lanes[9];
+	_mm256_storeu_si256((__m256i *)lanes, m);
+	lanes[8] = i < count ? max_int_scalar(base + i, count - i) : lanes[0];
+	return max_int_scalar(lanes, 9);
+}
+AVX2 static float min_float_avx2(const float *base, const size_t count)
+{
+	__m256 m = _mm256_set1_ps(INFINITY);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		m = _mm256_min_ps(_mm256_loadu_ps(base + i), m);
+	float lanes[9];
+	_mm256_storeu_ps(lanes, m);
+	lanes[8] = INFINITY;
+	if (i < count)
+		lanes[8] = min_float_scalar(base + i, count - i);
+	float r = min_float_scalar(lanes, 9);
+	return r == INFINITY ? min_float_scalar(base, count) : r;
+}
+AVX2 static float max_float_avx2(const float *base, const size_t count)
+{
+	__m256 m = _mm256_set1_ps(-INFINITY);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		m = _mm256_max_ps(_mm256_loadu_ps(base + i), m);
+	float lanes[9];
+	_mm256_storeu_ps(lanes, m);
+	lanes[8] = -INFINITY;
+	if (i < count)
+		lanes[8] = max_float_scalar(base + i, count - i);
+	float r = max_float_scalar(lanes, 9);
+	return r == -INFINITY ? max_float_scalar(base, count) : r;
+}
+AVX2 static void reverse32_avx2(uint32_t *base, const size_t count)
+{
+	const __m256i rev = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	uint32_t *l = base, *r = base + count;
+	for (; r - l >= 16; l += 8, r -= 8) {
+		__m256i a = LOAD256(l);
+		__m256i b = LOAD256(r - 8);
+		_mm256_storeu_si256((__m256i *)l,
+				    _mm256_permutevar8x32_epi32(b, rev));
+		_mm256_storeu_si256((__m256i *)(r - 8),
+				    _mm256_permutevar8x32_epi32(a, rev));
+	}
+	reverse32_sse2(l, r - l);
+}
+static const simd_ops avx2_ops = {
+	count_int_eq_avx2, accumulate_int_avx2, accumulate_float_avx2,
+	equal_int_avx2, equal_float_avx2, replace_int_avx2,
+	replace_float_avx2, min_int_avx2, max_int_avx2,
+	min_float_avx2, max_float_avx2, reverse32_avx2
+};
+#endif
+
+/* resolved on the first call, racing threads store the same pointer */
+static const simd_ops *ops;
+static simd_level level;
+
+static simd_level simd_detect(void)
+{
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SIMD_SSE2;
+#endif
+	return SIMD_SCALAR;
+}
+static const simd_ops *simd(void)
+{
+	if (!ops)
+		simd_select(SIMD_AVX2);
+	return ops;
+}
+/**=============================================================================
+ Functions:  simd_select, simd_current
+
+ Purpose:    simd_select caps the kernels at max, or what the CPU supports
+             if that is less, e.g. SIMD_SCALAR to compare against the plain
+	     loops.  Not thread safe, call it before the kernels are shared.
+	     simd_current returns the level in use.
+
+Returns:     the level selected.
+
+Example:     simd_select(SIMD_SSE2);
+	     size_t n = count_if_int_eq(samples, count, 0);
+==============================================================================*/
+simd_level simd_select(const simd_level max)
+{
+	simd_level best = simd_detect();
+	level = max < best ? max : best;
+#ifdef SIMD_X86
+	ops = level == SIMD_AVX2 ? &avx2_ops :
+	      level == SIMD_SSE2 ? &sse2_ops : &scalar_ops;
+#else
+	ops = &scalar_ops;
+#endif
+	return level;
+}
+simd_level simd_current(void)
+{
+	simd();
+	return level;
+}
+/**=============================================================================
+ Functions:  count_if_int_eq, accumulate_int, accumulate_float, equal_int,
+             equal_float, replace_int, replace_float, min_int, max_int,
+	     min_float, max_float, reverse_int, reverse_float
+
+ Purpose:    the typed counterparts of count_if (element == val),
+             accumulate, equal, replace, a min/max scan and reverse.
+
+ Parameters: base: array of count elements, min and max need count > 0.
+
+Returns:     as the generic versions, count_if_int_eq the number of
+	     elements equal to val.
+
+Example:     size_t zeros = count_if_int_eq(samples, count, 0);
+	     float peak = max_float(volts, count);
+==============================================================================*/
+size_t count_if_int_eq(const int *base, const size_t count, const int val)
+{
+	assert(base || count == 0);
+	return simd()->count_int_eq(base, count, val);
+}
+int accumulate_int(const int *base, const size_t count)
+{
+	assert(base || count == 0);
+	return simd()->accumulate_int(base, count);
+}
+float accumulate_float(const float *base, const size_t count)
+{
+	assert(base || count == 0);
+	return simd()->accumulate_float(base, count);
+}
+bool equal_int(const int *first1, const int *first2, const size_t count)
+{
+	assert((first1 && first2) || count == 0);
+	return simd()->equal_int(first1, first2, count);
+}
+bool equal_float(const float *first1, const float *first2, const size_t count)
+{
+	assert((first1 && first2) || count == 0);
+	return simd()->equal_float(first1, first2, count);
+}
+void replace_int(int *base, const size_t count, const int oldval,
+		 const int newval)
+{
+	assert(base || count == 0);
+	simd()->replace_int(base, count, oldval, newval);
+}
+void replace_float(float *base, const size_t count, const float oldval,
+		   const float newval)
+{
+	assert(base || count == 0);
+	simd()->replace_float(base, count, oldval, newval);
+}
+int min_int(const int *base, const size_t count)
+{
+	assert(base && count);
+	return simd()->min_int(base, count);
+}
+int max_int(const int *base, const size_t count)
+{
+	assert(base && count);
+	return simd()->max_int(base, count);
+}
+float min_float(const float *base, const size_t count)
+{
+	assert(base && count);
+	return simd()->min_float(base, count);
+}
+float max_float(const float *base, const size_t count)
+{
+	assert(base && count);
+	return simd()->max_float(base, count);
+}
+void reverse_int(int *base, const size_t count)
+{
+	assert(base || count == 0);
+	simd()->reverse32((uint32_t *)base, count);
+}
+void reverse_float(float *base, const size_t count)
+{
+	assert(base || count == 0);
+	simd()->reverse32((uint32_t *)base, count);
+}
+#pragma GCC diagnostic pop
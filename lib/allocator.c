@@ -0,0 +1,119 @@
+/*==============================================================================
+ Name        : allocator.c
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#include "precompile.h"
+#include "heap.h"
+#include "allocator.h"
+
+/**=============================================================================
+ Interface:  allocator
+
+ Purpose:    Ready made allocators for the containers.  heap_allocator is the
+             custom static heap manager and the default everywhere.
+	     heap_instance_allocator targets one heap_t from Heap_InitRegion,
+	     so a subsystem can be fenced into its own region.
+	     system_allocator is the C library malloc.  pool_allocator and
+	     arena_allocator live with their classes in pool.c and arena.c.
+==============================================================================*/
+static genptr heap_alloc_fn(genptr ctx, const size_t bytes)
+{
+	(void)ctx;
+	return Heap_Malloc((long)bytes);
+}
+static void heap_free_fn(genptr ctx, genptr p)
+{
+	(void)ctx;
+	Heap_Free(p);
+}
+static genptr heap_realloc_fn(genptr ctx, genptr p, const size_t bytes)
+{
+	(void)ctx;
+	return Heap_Realloc(p, (long)bytes);
+}
+
+static size_t heap_alloc_batch_fn(genptr ctx, const size_t count,
+				  const size_t bytes, genptr *out)
+{
+	(void)ctx;
+	return (size_t)Heap_MallocBatch((long)count, (long)bytes, out);
+}
+static void heap_free_batch_fn(genptr ctx, genptr *ptrs, const size_t count)
+{
+	(void)ctx;
+	Heap_FreeBatch(ptrs, (long)count);
+}
+
+const allocator heap_allocator = {
+	heap_alloc_fn, heap_free_fn, heap_realloc_fn, NULL,
+	heap_alloc_batch_fn, heap_free_batch_fn
+};
+
+static genptr instance_alloc_fn(genptr ctx, const size_t bytes)
+{
+	return Heap_MallocIn(ctx, (long)bytes);
+}
+static void instance_free_fn(genptr ctx, genptr p)
+{
+	Heap_FreeIn(ctx, p);
+}
+static genptr instance_realloc_fn(genptr ctx, genptr p, const size_t bytes)
+{
+	return Heap_ReallocIn(ctx, p, (long)bytes);
+}
+static size_t instance_alloc_batch_fn(genptr ctx, const size_t count,
+				      const size_t bytes, genptr *out)
+{
+	return (size_t)Heap_MallocBatchIn(ctx, (long)count, (long)bytes, out);
+}
+static void instance_free_batch_fn(genptr ctx, genptr *ptrs,
+				   const size_t count)
+{
+	Heap_FreeBatchIn(ctx, ptrs, (long)count);
+}
+/**=============================================================================
+ Function:   heap_instance_allocator
+
+ Purpose:    Returns an allocator on one heap instance.  The ...In calls do
+             not take the HEAP_THREADSAFE lock, the caller owns the instance.
+
+ Parameters: heap: instance set up with Heap_InitRegion
+
+Returns:     allocator value, copy it or pass its address to a constructor.
+
+Example:     static long region[512];
+             static heap_t h;
+             Heap_InitRegion(&h, region, sizeof(region));
+             allocator al = heap_instance_allocator(&h);
+             slistptr pl = slist_alloc_with(sizeof(int), &al);
+==============================================================================*/
+allocator heap_instance_allocator(heap_t *heap)
+{
+	assert(heap);
+	allocator al = {
+		instance_alloc_fn, instance_free_fn, instance_realloc_fn, heap,
+		instance_alloc_batch_fn, instance_free_batch_fn
+	};
+	return al;
+}
+
+static genptr system_alloc_fn(genptr ctx, const size_t bytes)
+{
+	(void)ctx;
+	return malloc(bytes);
+}
+static void system_free_fn(genptr ctx, genptr p)
+{
+	(void)ctx;
+	free(p);
+}
+static genptr system_realloc_fn(genptr ctx, genptr p, const size_t bytes)
+{
+	(void)ctx;
+	return realloc(p, bytes);
+}
+
+const allocator system_allocator = {
+	system_alloc_fn, system_free_fn, system_realloc_fn, NULL, NULL, NULL
+};
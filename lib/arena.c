@@ -0,0 +1,183 @@
+/*==============================================================================
+ Name        : arena.c
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#include "precompile.h"
+#include "heap.h"
+#include "allocator.h"
+#include "arena.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+/**=============================================================================
+ Interface:  arena
+
+ Purpose:    arena is a bump pointer allocator for scratch memory.  Objects
+             are never freed one at a time, instead arena_mark remembers the
+	     top and arena_release drops everything allocated since, in O(1).
+	     The buffer is either one block from the custom static heap
+	     manager or attached to a caller buffer.
+==============================================================================*/
+struct arena {
+	genptr base;
+	size_t cap;
+	size_t top;
+	bool attached;
+};
+
+/**=============================================================================
+ Function:   arena_alloc
+
+ Purpose:    Allocates the arena buffer from the custom static heap manager
+             and returns an opaque interface pointer to the arena class.
+
+ Parameters: bytes: size of the arena buffer.
+
+Returns:     Opaque arena interface pointer (Pimpl idiom).
+
+Example:     arenaptr pa = arena_alloc(1024);
+==============================================================================*/
+arenaptr arena_alloc(const size_t bytes)
+{
+	arenaptr pa = Heap_Malloc(sizeof(arena));
+	assert(pa);
+	pa->base = Heap_Malloc(bytes);
+	assert(pa->base);
+	pa->cap = bytes;
+	pa->top = 0;
+	pa->attached = false;
+	return pa;
+}
+arenaptr arena_attach(const genptr base, const size_t bytes)
+{
+	assert(base);
+	arenaptr pa = Heap_Malloc(sizeof(arena));
+	assert(pa);
+	pa->base = base;
+	pa->cap = bytes;
+	pa->top = 0;
+	pa->attached = true;
+	return pa;
+}
+void arena_free(arenaptr pa)
+{
+	assert(pa && !pa->attached);
+	Heap_Free(pa->base);
+	Heap_Free(pa);
+	pa = NULL;
+}
+void arena_detach(arenaptr pa)
+{
+	assert(pa && pa->attached);
+	Heap_Free(pa);
+	pa = NULL;
+}
+/**=============================================================================
+ Function:   arena_get
+
+ Purpose:    Bumps the top of the arena, the result is aligned for a long.
+
+ Parameters: pa: arena interface pointer
+             bytes: size of the object
+
+Returns:     pointer to the object or NULL if the arena is full.
+
+Example:     char *line = arena_get(pa, 80);
+==============================================================================*/
+genptr arena_get(arenaptr pa, const size_t bytes)
+{
+	assert(pa);
+	size_t align = sizeof(long);
+	size_t start = (pa->top + align - 1) & ~(align - 1);
+	if (start > pa->cap || bytes > pa->cap - start)
+		return NULL;
+
+	pa->top = start + bytes;
+	return pa->base + start;
+}
+/**=============================================================================
+ Functions:  arena_mark, arena_release, arena_reset
+
+ Purpose:    arena_mark returns the current top.  arena_release rolls the top
+             back to a mark, freeing everything allocated after it.  Marks
+	     nest like a stack, releasing an outer mark also drops the inner
+	     ones.  arena_reset empties the arena.
+
+ Parameters: pa: arena interface pointer
+             mark: value previously returned by arena_mark
+
+Returns:     arena_mark returns the marker, the others return void.
+
+Example:     arena_marker m = arena_mark(pa);
+             handle_request(pa);
+	     arena_release(pa, m);
+==============================================================================*/
+arena_marker arena_mark(const arenaptr pa)
+{
+	assert(pa);
+	return pa->top;
+}
+void arena_release(arenaptr pa, const arena_marker mark)
+{
+	assert(pa && mark <= pa->top);
+	pa->top = mark;
+}
+void arena_reset(arenaptr pa)
+{
+	assert(pa);
+	pa->top = 0;
+}
+size_t arena_used(const arenaptr pa)
+{
+	assert(pa);
+	return pa->top;
+}
+/**=============================================================================
+ Function:   arena_allocator
+
+ Purpose:    Returns an allocator on the arena for the _with constructors.
+             free is a no-op, memory comes back with arena_release or
+	     arena_reset after the containers are freed.  realloc bumps a new
+	     object and copies, the old one is dropped with the arena.
+
+ Parameters: pa: arena interface pointer, must outlive the containers
+
+Returns:     allocator value, copy it or pass its address to a constructor.
+
+Example:     arena_marker m = arena_mark(pa);
+             allocator al = arena_allocator(pa);
+             stackptr ps = stack_alloc_with(sizeof(int), &al);
+	     ...
+	     stack_free(ps);
+	     arena_release(pa, m);
+==============================================================================*/
+static genptr arena_alloc_fn(genptr ctx, const size_t bytes)
+{
+	return arena_get(ctx, bytes);
+}
+static void arena_free_fn(genptr ctx, genptr p)
+{
+	(void)ctx;
+	(void)p;
+}
+static genptr arena_realloc_fn(genptr ctx, genptr p, const size_t bytes)
+{
+	genptr n = arena_get(ctx, bytes);
+	/* the old object ends at or before the new one, copy no further */
+	if (n && p) {
+		size_t old = (size_t)(n - p);
+		memcpy(n, p, old < bytes ? old : bytes);
+	}
+	return n;
+}
+allocator arena_allocator(arenaptr pa)
+{
+	assert(pa);
+	allocator al = {
+		arena_alloc_fn, arena_free_fn, arena_realloc_fn, pa, NULL, NULL
+	};
+	return al;
+}
+#pragma GCC diagnostic pop
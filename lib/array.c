@@ -7,6 +7,7 @@
 #include "array.h"
 #include "algo.h"
 #include "heap.h"
+#include "allocator.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
@@ -22,6 +23,8 @@ struct dynarray {
 	size_t cap;
 	size_t datasize;
 	size_t count;
+	size_t align;
+	allocator al;
 };
 /**=============================================================================
  Function:   array_alloc
@@ -37,13 +40,68 @@ Returns:     Opaque array interface pointer (Pimpl idiom).
 Example:     arrayptr pa = array_alloc(100, sizeof(int));
 ==============================================================================*/
 arrayptr array_alloc(const size_t capacity, const size_t datasize)
+{
+	return array_alloc_with(capacity, datasize, NULL);
+}
+/**=============================================================================
+ Function:   array_alloc_with
+
+ Purpose:    Same as array_alloc, but the descriptor and the element buffer
+             come from the given allocator instead of the custom static heap
+	     manager.
+
+ Parameters: capacity: how many elements to allocate.
+	     datasize: size in bytes of each element
+	     al: allocator, copied into the array, or NULL for heap_allocator.
+
+Returns:     Opaque array interface pointer (Pimpl idiom).
+
+Example:     allocator al = system_allocator;
+             arrayptr pa = array_alloc_with(100, sizeof(int), &al);
+==============================================================================*/
+arrayptr array_alloc_with(const size_t capacity, const size_t datasize,
+			  const allocator *al)
+{
+	allocator a = allocator_or_default(al);
+	arrayptr p = allocator_alloc(&a, sizeof(dynarray));
+	assert(p);
+	p->base = allocator_alloc(&a, capacity * datasize);
+	assert(p->base);
+	p->align = sizeof(long);
+	p->cap = capacity;
+	p->datasize = datasize;
+	p->count = 0;
+	p->al = a;
+
+	return p;
+}
+/**=============================================================================
+ Function:   array_alloc_aligned
+
+ Purpose:    Same as array_alloc but the element buffer is aligned, so
+             vectorized algorithm paths can use aligned loads on it.
+
+ Parameters: capacity: how many elements to allocate.
+	     datasize: size in bytes of each element
+	     align: alignment hint in bytes, a power of two (e.g. 16 or 32),
+		    0 for the heap's natural sizeof(long) alignment
+
+Returns:     Opaque array interface pointer (Pimpl idiom).
+
+Example:     arrayptr pa = array_alloc_aligned(100, sizeof(float), 16);
+==============================================================================*/
+arrayptr array_alloc_aligned(const size_t capacity, const size_t datasize,
+			     const size_t align)
 {
 	arrayptr p = Heap_Malloc(sizeof(dynarray));
 	assert(p);
-	p->base = Heap_Malloc(capacity * datasize);
+	p->align = align > sizeof(long) ? align : sizeof(long);
+	p->base = Heap_MallocAligned(capacity * datasize, p->align);
+	assert(p->base);
 	p->cap = capacity;
 	p->datasize = datasize;
 	p->count = 0;
+	p->al = heap_allocator;
 
 	return p;
 }
@@ -56,6 +114,9 @@ arrayptr array_attach(const genptr base, const size_t capacity,
 	p->cap = capacity;
 	p->datasize = datasize;
 	p->count = 0;
+	/* the largest power of two the caller's buffer happens to be aligned to */
+	p->align = (size_t)base & (~(size_t)base + 1);
+	p->al = heap_allocator;
 
 	return p;
 }
@@ -83,17 +144,26 @@ void array_add(arrayptr pa, const genptr data, const size_t count)
 	pa->count += count;
 }
 
+/* alignment in bytes of the element buffer, vectorized paths test it
+   before using aligned loads */
+size_t array_alignment(const arrayptr pa)
+{
+	assert(pa);
+	return pa->align;
+}
 void array_free(arrayptr pa)
 {
 	assert(pa);
-	Heap_Free(pa->base);
-	Heap_Free(pa);
+	allocator a = pa->al;
+	allocator_free(&a, pa->base);
+	allocator_free(&a, pa);
 	pa=NULL;
 }
 void array_detach(arrayptr pa)
 {
 	assert(pa);
-	Heap_Free(pa);
+	allocator a = pa->al;
+	allocator_free(&a, pa);
 	pa=NULL;
 }
 
@@ -154,6 +224,15 @@ void array_sort(arrayptr pa, bool (*cmp)(const genptr v1, const genptr v2),
 	assert(pa && cmp);
 	gensort(pa->base, pa->count, pa->datasize, cmp, swap);
 }
+/* scratch comes from the array's own allocator, nthreads 0 is one per core */
+void array_sort_parallel(arrayptr pa,
+			 bool (*cmp)(const genptr v1, const genptr v2),
+			 void (*swap)(genptr, genptr), const size_t nthreads)
+{
+	assert(pa && cmp);
+	gensort_parallel_with(pa->base, pa->count, pa->datasize, cmp, swap,
+			      nthreads, &pa->al);
+}
 genptr array_search(const arrayptr pa, const genptr val,
 		    int(*cmp)(const genptr, const genptr))
 {
@@ -45,9 +45,9 @@ done:
 rand_wrapper:
 	stmfd	sp!, {r4-r5}
 	stmfd	sp!, {r0-r3, lr}
-	bl	rand
+	bl	rng_rand	/* 32 bits, see rng.h */
 	mov 	r4, r0
-	lsr	r4, r4, #20
+	lsr	r4, r4, #20	/* top 12 bits */
 	ldmfd	sp!, {r0-r3, lr}
 	mov	r0, r4
 	ldmfd	sp!, {r4-r5}
@@ -5,6 +5,8 @@
 ==============================================================================*/
 #include "precompile.h"
 #include "heap.h"
+#include "allocator.h"
+#include "pool.h"
 #include "circ_list.h"
 
 #pragma GCC diagnostic push
@@ -13,11 +15,12 @@
  Interface:  circ_list
 
  Purpose:    circ_list is a circular linked list that uses the custom static
-             heap manager.
+             heap manager.  Each node is one allocation, the element is
+             stored inline after the link.
 ==============================================================================*/
 typedef struct node {
         struct node * next;
-        genptr data;
+        unsigned char data[];   /* payload inline, datasize bytes */
 }node;
 
 typedef node* nodeptr;
@@ -26,7 +29,15 @@ struct circ_list {
         nodeptr head;
         size_t count;
         size_t datasize;
+        allocator al;
 };
+/* one allocation per element, the payload follows the link */
+static nodeptr node_new(listptr pl)
+{
+        nodeptr n = allocator_alloc(&pl->al, list_node_size(pl->datasize));
+        assert(n);
+        return n;
+}
 /**=============================================================================
  Function:   list_alloc
 
@@ -41,14 +52,61 @@ Example:     listptr pl = list_alloc(sizeof(int));
 ==============================================================================*/
 listptr list_alloc(const size_t datasize)
 {
-        listptr pl = Heap_Malloc(sizeof(circ_list));
+        return list_alloc_with(datasize, NULL);
+}
+/**=============================================================================
+ Function:   list_alloc_pool
+
+ Purpose:    Same as list_alloc, but nodes come from a fixed size pool so
+             adding and freeing never touches the general heap.
+
+ Parameters: datasize: size in bytes of each element
+             pool: pool whose objects are at least list_node_size(datasize)
+             bytes, or NULL to use the heap.
+
+Returns:     Opaque circ_list interface pointer (Pimpl idiom).
+
+Example:     poolptr pp = pool_alloc(list_node_size(sizeof(int)), 64);
+             listptr pl = list_alloc_pool(sizeof(int), pp);
+==============================================================================*/
+listptr list_alloc_pool(const size_t datasize, poolptr pool)
+{
+        assert(pool == NULL || pool_objsize(pool) >= list_node_size(datasize));
+        if(pool == NULL)
+                return list_alloc_with(datasize, NULL);
+        allocator al = pool_allocator(pool);
+        return list_alloc_with(datasize, &al);
+}
+/**=============================================================================
+ Function:   list_alloc_with
+
+ Purpose:    Same as list_alloc, but the descriptor and every node come from
+             the given allocator instead of the custom static heap manager.
+
+ Parameters: datasize: size in bytes of each element
+             al: allocator, copied into the list, or NULL for heap_allocator.
+
+Returns:     Opaque list interface pointer (Pimpl idiom).
+
+Example:     allocator al = pool_allocator(pp);
+             listptr pl = list_alloc_with(sizeof(int), &al);
+==============================================================================*/
+listptr list_alloc_with(const size_t datasize, const allocator *al)
+{
+        allocator a = allocator_or_default(al);
+        listptr pl = allocator_alloc(&a, sizeof(circ_list));
         assert(pl);
         pl->head = NULL;
         pl->count = 0;
         pl->datasize = datasize;
+        pl->al = a;
 
         return pl;
 }
+size_t list_node_size(const size_t datasize)
+{
+        return offsetof(node, data) + datasize;
+}
 /**=============================================================================
  Function:   list_add
 
@@ -64,11 +122,8 @@ listptr list_alloc(const size_t datasize)
 void list_add(listptr pl, const genptr data)
 {
         assert(pl && data);
-        nodeptr n = Heap_Malloc(sizeof(node));
-        assert(n);
+        nodeptr n = node_new(pl);
         n->next = NULL;
-        n->data = Heap_Malloc(pl->datasize);
-        assert(n->data);
         memcpy(n->data, data, pl->datasize);
         if(pl->head == NULL) {
                 pl->head = n;
@@ -85,15 +140,18 @@ void list_free(listptr pl)
         assert(pl);
         nodeptr p = pl->head;
         nodeptr del = NULL;
+        allocator a = pl->al;
+        allocator_gather g;
+        allocator_gather_init(&g, &a);
 
         while(pl->count > 0) {
                 del = p;
                 p = p->next;
-                Heap_Free(del->data);
-                Heap_Free(del);
+                allocator_gather_add(&g, del);
                 pl->count--;
         }
-        Heap_Free(pl);
+        allocator_gather_add(&g, pl);
+        allocator_gather_flush(&g);
         pl = NULL;
 }
 void list_delete_element(listptr pl, const genptr data)
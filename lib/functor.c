@@ -5,6 +5,7 @@
 ==============================================================================*/
 #include "precompile.h"
 #include "functor.h"
+#include "rng.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
@@ -35,7 +36,7 @@ void double_int(const int *psrc, int *pdest)
 void rand_int(int *p) 
 { 
 	assert(p);
-	*p = rand() % 100; 
+	*p = (int)rng_range(rng_default(), 100);
 }
 void print_int(const int *el) 
 {
@@ -68,6 +69,12 @@ bool int_less(const int *v1, const int *v2)
 	assert(v1 && v2);
 	return *v1 < *v2;
 }
+/* reverses a sort, e.g. partial_sort for the top k */
+bool int_greater(const int *v1, const int *v2)
+{
+	assert(v1 && v2);
+	return *v1 > *v2;
+}
 bool str_less(const char **s1, const char **s2)
 {
 	assert(s1 && s2 && *s1 && *s2);
@@ -149,7 +156,7 @@ void record_genswap(genptr v1, genptr v2)
 void int_genrand(genptr pi)
 {
 	assert(pi);
-	*(int*)pi = rand() % 100; 
+	*(int*)pi = (int)rng_range(rng_default(), 100);
 }
 void int_genprint(const genptr pi)
 {
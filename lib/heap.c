@@ -33,16 +33,144 @@
 // If the block is used, the meta-sections record the room as a positive
 // number.  If the block is unused, the meta-sections record the room as a
 // negative number.
+//
+// [stevemac] Free blocks are also kept on segregated free lists, two level
+// segregated fit (TLSF, Masmano et al.).  The first two words of an unused
+// block's room hold the next and previous free block headers.  The first
+// level index is the log2 of the room, the second level splits each power
+// of two into HEAP_SL_COUNT linear classes.  A bitmap per level tells which
+// lists are non-empty, so finding a block is a couple of CLZ instructions
+// instead of a walk from the start of the heap.  Malloc and free are constant time.
+// The boundary tags are unchanged and still used for coalescing.
 
+//
+// [stevemac] All of the state lives in a heap_t, so any number of heaps can
+// be carved out of separate regions with Heap_InitRegion and used through
+// the ...In functions.  The original Heap_... functions work on a default
+// heap over the static Heap array below.
+//
+// [stevemac] With HEAP_LINKER_REGION (board builds) there is no Heap array,
+// the default heap is the SRAM between the end of .bss and the stack
+// reserve, named by symbols every STM32F4xx linker script provides.
+// Heap_AddRegion appends disjoint regions: the gap up to a region is one
+// used block whose header is taken from the top of the heap and whose
+// trailer is the first word of the region, so the heap is still a single
+// chain of blocks from start to end.
+//
+// [stevemac] With HEAP_THREADSAFE (host builds) the Heap_... functions lock
+// the default heap with one mutex.  Small blocks are also cached per thread:
+// a freed block whose room is at most HEAP_CACHE_ROOMS stays marked used and
+// is pushed on the thread's list for that room, the next malloc of that room
+// pops it.  An empty list is refilled with a batch under one lock and a full
+// one gives half back, so most mallocs and frees never take the lock.  The
+// ...In functions are never locked, a heap instance belongs to one thread
+// or the caller serializes it.
+//
+// [stevemac] With HEAP_TRACE the Heap_... functions append a record of each
+// call to the HeapTrace buffer, see heap.h for the format.  Blocks are named
+// by their offset in the heap so a trace can be replayed against any policy
+// without pointers, tests/heap-replay does that.
+
+#include <limits.h>
+#include <string.h>
 #include "heap.h"
+#ifdef HEAP_THREADSAFE
+#include <pthread.h>
+#ifndef HEAP_TRACE
+#define HEAP_THREAD_CACHE
+#endif
+#endif
+#ifdef HEAP_TRACE
+#include <stdio.h>
+#endif
+#ifdef HEAP_LINKER_REGION
+#include <errno.h>
+#include <stdint.h>
+#endif
+
+// free blocks need room for the next/previous links
+#define HEAP_MIN_ROOM 2
+// rooms below this are mapped exactly into first level 0
+#define HEAP_SMALL_ROOM HEAP_SL_COUNT
+// largest room the segregated lists can index
+#define HEAP_MAX_ROOM ((1L << (HEAP_FL_COUNT + HEAP_SL_LOG2 - 1)) - 1)
 
-#define HEAP_START (Heap)
-#define HEAP_END (HEAP_START + HEAP_SIZE_WORDS)
+#define HEAP_NEXT_FREE(block) (*(long**)((block) + 1))
+#define HEAP_PREV_FREE(block) (*(long**)((block) + 2))
+// marks a block freed by Heap_FreeBatchIn that is not merged yet
+#define HEAP_PENDING_FREE ((long*)&BatchPending)
+// first room word of a gap block, never a handle index
+#define HEAP_GAP_MARK (-1)
 
+#if defined(HEAP_LINKER_REGION)
+// from the linker script, see the .reserved_for_stack section.  Addresses,
+// not pointers: the reserves are outside both symbols' objects.
+extern long __reserved_for_stack_end__[];
+extern long _estack[];
+#define HEAP_REGION_START ((uintptr_t)__reserved_for_stack_end__ + HEAP_SBRK_RESERVE)
+#define HEAP_REGION_END ((uintptr_t)_estack - HEAP_STACK_RESERVE)
+#elif defined(HEAP_SIZE_BYTES)
 //The actual heap is just a big array.
 static long Heap[HEAP_SIZE_WORDS];
+#else
+#error "define HEAP_SIZE_BYTES or HEAP_LINKER_REGION"
+#endif
+static heap_t DefaultHeap;
+static long BatchPending;
+
+#ifdef HEAP_TRACE
+static unsigned char HeapTrace[HEAP_TRACE_BYTES];
+static size_t HeapTraceBytes;
+static void traceRecord(long op, void* block, long size, void* newBlock);
+#endif
 
-static long inHeapRange(long* address);
+#ifdef HEAP_THREADSAFE
+static pthread_mutex_t HeapLock = PTHREAD_MUTEX_INITIALIZER;
+#define HEAP_LOCK() pthread_mutex_lock(&HeapLock)
+#define HEAP_UNLOCK() pthread_mutex_unlock(&HeapLock)
+#else
+#define HEAP_LOCK()
+#define HEAP_UNLOCK()
+#endif
+
+#ifdef HEAP_THREAD_CACHE
+#define HEAP_CACHE_BATCH (HEAP_CACHE_DEPTH / 4)
+#define HEAP_NEXT_CACHED(block) (*(long**)((block) + 1))
+// second room word of a cached block, tells a double free from a first one
+#define HEAP_CACHE_TAG(block) (*(unsigned long*)((block) + 2))
+
+// one per thread, lists of used blocks indexed by room
+typedef struct heap_cache {
+  long* blocks[HEAP_CACHE_ROOMS + 1];
+  long counts[HEAP_CACHE_ROOMS + 1];
+  unsigned long generation;
+  long registered;
+} heap_cache_t;
+
+static pthread_once_t HeapCacheOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t HeapCacheKey;
+// bumped by Heap_Init so caches of the old heap are dropped
+static unsigned long HeapGeneration;
+static __thread heap_cache_t ThreadCache;
+// the tag is its address mixed with the generation, so a tag left in memory
+// from before a Heap_Init never matches
+static long CacheMark;
+#define HEAP_CACHE_MARK(cache) ((unsigned long)&CacheMark ^ (cache)->generation)
+
+static long cacheRoom(long desiredBytes);
+static heap_cache_t* threadCache(void);
+static void* cacheGet(long room);
+static long cachePut(void* pointer);
+static void cacheRelease(heap_cache_t* cache, long room, long count);
+#endif
+
+#ifdef HEAP_TRACE
+#define HEAP_TRACE_RECORD(op, block, size, newBlock) traceRecord(op, block, size, newBlock)
+#else
+#define HEAP_TRACE_RECORD(op, block, size, newBlock)
+#endif
+
+static long inHeapRange(heap_t* heap, long* address);
 static long blockUsed(long* block);
 static long blockUnused(long* block);
 static long blockRoom(long* block);
@@ -51,23 +179,149 @@ static long* blockHeader(long* blockEnd);
 static long* blockTrailer(long* blockStart);
 static long* nextBlockHeader(long* blockStart);
 static long* previousBlockHeader(long* blockStart);
+static long checkBlockToFree(heap_t* heap, long* blockStart);
 static long markBlockUsed(long* blockStart);
 static long markBlockUnused(long* blockStart);
-static long splitAndMarkBlockUsed(long* upperBlockStart, long desiredRoom);
-static void mergeBlockWithBelow(long* upperBlockStart);
+static long splitAndMarkBlockUsed(heap_t* heap, long* upperBlockStart, long desiredRoom);
+static void mergeBlockWithBelow(heap_t* heap, long* upperBlockStart);
+static void shrinkUsedBlock(heap_t* heap, long* blockStart, long desiredRoom);
+static long highestBit(unsigned long word);
+static long lowestBit(unsigned long word);
+static void mappingInsert(long room, long* fl, long* sl);
+static void mappingSearch(long room, long* fl, long* sl);
+static long* findSuitableBlock(heap_t* heap, long room);
+static long* findFirstFitBlock(heap_t* heap, long room);
+static long* findNextFitBlock(heap_t* heap, long room);
+static long* findBestFitBlock(heap_t* heap, long room);
+static void insertFreeBlock(heap_t* heap, long* blockStart);
+static void removeFreeBlock(heap_t* heap, long* blockStart);
+static void countAllocation(heap_t* heap, long* blockStart, long desiredBytes);
+static long* largestFreeBlock(heap_t* heap);
+static long alignedGap(long* blockStart, long alignWords);
+static void headerRemoved(heap_t* heap, long* removed, long* into);
+static long testBlock(heap_t* heap, long* blockStart);
+static long* findAlignedBlock(heap_t* heap, long room, long alignWords);
+static heap_handle_slot_t* handleSlot(heap_t* heap, heap_handle_t handle);
+static long blockMovable(heap_t* heap, long* blockStart);
+static long* slideBlockDown(heap_t* heap, long* freeStart);
 //static long byteIndex(long* ptr);
 
 //******** Heap_Init *************** 
 // Initialize the Heap
 // input: none
-// output: always HEAP_OK
+// output: HEAP_OK, or with HEAP_LINKER_REGION HEAP_ERROR_BAD_ARGUMENT when
+//  the linker script leaves no room between .bss plus HEAP_SBRK_RESERVE
+//  and the stack reserve, the heap is then empty
 // notes: Initializes/resets the heap to a clean state where no memory
 //  is allocated.
 long Heap_Init(void){
-  long* blockStart = HEAP_START;
-  long* blockEnd = (HEAP_START + HEAP_SIZE_WORDS - 1);
-  *blockStart = -(long)(HEAP_SIZE_WORDS - 2);  
-  *blockEnd = -(long)(HEAP_SIZE_WORDS - 2);
+  long status;
+  HEAP_LOCK();
+#ifdef HEAP_LINKER_REGION
+  status = HEAP_ERROR_BAD_ARGUMENT;
+  if(HEAP_REGION_END > HEAP_REGION_START){
+    status = Heap_InitRegion(&DefaultHeap, (void*)HEAP_REGION_START,
+                             HEAP_REGION_END - HEAP_REGION_START);
+  }
+#else
+  status = Heap_InitRegion(&DefaultHeap, Heap, sizeof(Heap));
+#endif
+#ifdef HEAP_TRACE
+  HeapTraceBytes = 0;
+#endif
+#ifdef HEAP_THREAD_CACHE
+  __atomic_add_fetch(&HeapGeneration, 1, __ATOMIC_RELEASE);
+#endif
+  HEAP_UNLOCK();
+  return status;
+}
+
+
+#ifdef HEAP_LINKER_REGION
+//******** __wrap__sbrk *************** 
+// newlib's _sbrk, bounded by the default heap
+// input: increment: bytes to grow (or shrink) newlib's malloc arena by
+// output: the old break, or (void*)-1 with errno ENOMEM when the arena
+//   would reach HEAP_REGION_START
+// notes: [stevemac] newlib's _sbrk grows from the linker script's end
+//   symbol with no limit of its own, past HEAP_SBRK_RESERVE it would
+//   overwrite the first blocks of the default heap.  stm32.mak links
+//   with --wrap=_sbrk, so every caller comes here and __real__sbrk is
+//   newlib's.
+void* __real__sbrk(ptrdiff_t increment);
+void* __wrap__sbrk(ptrdiff_t increment){
+  char* current = (char*)__real__sbrk(0);
+  if(increment > 0 &&
+     (uintptr_t)current + (uintptr_t)increment > HEAP_REGION_START){
+    errno = ENOMEM;
+    return (void*)-1;
+  }
+  return __real__sbrk(increment);
+}
+#endif
+
+
+//******** Heap_InitRegion *************** 
+// Initialize a heap over a region of memory
+// input:
+//   heap: heap to initialize
+//   region: memory the heap manages, need not be aligned
+//   bytes: size of the region in bytes
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT if the region is too small
+//   to hold a single block
+// notes: Initializes/resets the heap to a clean state where no memory
+//  is allocated.  The placement policy is reset to HEAP_POLICY_TLSF.
+//  Regions larger than the free lists can index are truncated.
+long Heap_InitRegion(heap_t* heap, void* region, size_t bytes){
+  unsigned long address = (unsigned long)region;
+  unsigned long aligned = (address + sizeof(long) - 1) & ~(sizeof(long) - 1);
+  long words;
+  long* blockStart;
+  long* blockEnd;
+  long fl, sl;
+  if(heap == 0 || region == 0 || bytes < aligned - address){
+    return HEAP_ERROR_BAD_ARGUMENT;
+  }
+  words = (long)((bytes - (aligned - address)) / sizeof(long));
+  if(words < HEAP_MIN_ROOM + 2){
+    return HEAP_ERROR_BAD_ARGUMENT;
+  }
+  if(words > HEAP_MAX_ROOM + 2){
+    words = HEAP_MAX_ROOM + 2;
+  }
+  heap->start = (long*)aligned;
+  heap->end = heap->start + words;
+  heap->policy = HEAP_POLICY_TLSF;
+  heap->rover = heap->start;
+  heap->checkCursor = heap->start;
+  heap->checkPasses = 0;
+  for(fl = 0; fl < HEAP_FL_COUNT; fl++){
+    for(sl = 0; sl < HEAP_SL_COUNT; sl++){
+      heap->freeLists[fl][sl] = 0;
+    }
+    heap->slBitmap[fl] = 0;
+  }
+  heap->flBitmap = 0;
+  heap->usedWords = 0;
+  heap->peakUsedWords = 0;
+  heap->usedBlocks = 0;
+  heap->freeBlocks = 0;
+  heap->highWater = heap->start;
+  heap->failedMallocs = 0;
+  for(fl = 0; fl < HEAP_HISTOGRAM_BINS; fl++){
+    heap->histogram[fl] = 0;
+  }
+  for(fl = 0; fl < HEAP_HANDLE_COUNT; fl++){
+    heap->handles[fl].block = 0;
+    heap->handles[fl].locks = 0;
+  }
+  heap->gaps = 0;
+  heap->gapWords = 0;
+  blockStart = heap->start;
+  blockEnd = heap->end - 1;
+  *blockStart = -(words - 2);
+  *blockEnd = -(words - 2);
+  insertFreeBlock(heap, blockStart);
   return HEAP_OK;
 }
 
@@ -79,40 +333,445 @@ long Heap_Init(void){
 // output: void* pointing to the allocated memory or will return NULL
 //   if there isn't sufficient space to satisfy allocation request
 void* Heap_Malloc(long desiredBytes){
-  long desiredWords = (desiredBytes + sizeof(long) - 1) / sizeof(long);
-  long* blockStart = HEAP_START;  // implements first fit
-  if(desiredWords <= 0){
-    return 0; //NULL
+  void* block;
+#ifdef HEAP_THREAD_CACHE
+  long room = cacheRoom(desiredBytes);
+  if(room){
+    block = cacheGet(room);
+    if(block){
+      return block;
+    }
   }
-  while(inHeapRange(blockStart)){
-  // one pass through the heap
-  // choose first block that is big enough
-    if(blockUnused(blockStart) && desiredWords <= blockRoom(blockStart)){
-      if(splitAndMarkBlockUsed(blockStart, desiredWords)){
-        return 0; //NULL
+#endif
+  HEAP_LOCK();
+  block = Heap_MallocIn(&DefaultHeap, desiredBytes);
+  HEAP_TRACE_RECORD(HEAP_TRACE_MALLOC, 0, desiredBytes, block);
+  HEAP_UNLOCK();
+  return block;
+}
+
+
+//******** Heap_Calloc *************** 
+// Allocate memory, data are initialized to 0
+// input:
+//   desiredBytes: desired number of bytes to allocate
+// output: void* pointing to the allocated memory block or will return NULL
+//   if there isn't sufficient space to satisfy allocation request
+//notes: the allocated memory block will be zeroed out
+void* Heap_Calloc(long desiredBytes){
+  void* block;
+  HEAP_LOCK();
+  block = Heap_CallocIn(&DefaultHeap, desiredBytes);
+  HEAP_TRACE_RECORD(HEAP_TRACE_MALLOC, 0, desiredBytes, block);
+  HEAP_UNLOCK();
+  return block;
+}
+
+
+//******** Heap_Realloc *************** 
+// Reallocate buffer to a new size
+//input: 
+//  oldBlock: pointer to a block
+//  desiredBytes: a desired number of bytes for a new block
+//    where the contents of the old block will be copied to
+// output: void* pointing to the new block or will return NULL
+//   if there is any reason the reallocation can't be completed
+// notes: the block is resized in place when it shrinks or the next
+//   block is free and big enough, and the same pointer is returned.
+//   Otherwise the given block will be unallocated after its contents
+//   are copied to the new block
+void* Heap_Realloc(void* oldBlock, long desiredBytes){
+  void* block;
+  HEAP_LOCK();
+  block = Heap_ReallocIn(&DefaultHeap, oldBlock, desiredBytes);
+  HEAP_TRACE_RECORD(HEAP_TRACE_REALLOC, oldBlock, desiredBytes, block);
+  HEAP_UNLOCK();
+  return block;
+}
+
+
+//******** Heap_MallocBatch *************** 
+// Allocate count blocks of the same size, data not initialized
+// input: 
+//   count: how many blocks
+//   desiredBytes: desired number of bytes for each block
+//   out: array of count pointers that receives the blocks
+// output: how many blocks were allocated, the rest of out is NULL
+long Heap_MallocBatch(long count, long desiredBytes, void** out){
+  long done;
+  HEAP_LOCK();
+  done = Heap_MallocBatchIn(&DefaultHeap, count, desiredBytes, out);
+#ifdef HEAP_TRACE
+  {
+    long i;
+    for(i = 0; i < done; i++){
+      HEAP_TRACE_RECORD(HEAP_TRACE_MALLOC, 0, desiredBytes, out[i]);
+    }
+  }
+#endif
+  HEAP_UNLOCK();
+  return done;
+}
+
+
+//******** Heap_MallocAligned *************** 
+// Allocate memory aligned to a power of two, data not initialized
+// input: 
+//   desiredBytes: desired number of bytes to allocate
+//   align: alignment in bytes, a power of two, e.g. 16/32/64 for SIMD
+//     or DMA buffers
+// output: void* aligned to align or NULL if there isn't sufficient space
+//   or align is not a power of two
+// notes: [stevemac] the result is an ordinary block, the words skipped to
+//   reach the alignment become a free block of their own instead of padding.
+//   Free with Heap_FreeAligned or Heap_Free.  Heap_Realloc may move the
+//   block and lose the alignment.
+void* Heap_MallocAligned(long desiredBytes, size_t align){
+  void* block;
+  HEAP_LOCK();
+  block = Heap_MallocAlignedIn(&DefaultHeap, desiredBytes, align);
+  HEAP_TRACE_RECORD(HEAP_TRACE_MALLOC, 0, desiredBytes, block);
+  HEAP_UNLOCK();
+  return block;
+}
+
+
+//******** Heap_FreeAligned *************** 
+// return a block from Heap_MallocAligned to the heap
+// input: pointer to memory to unallocate
+// output: same as Heap_Free
+// notes: the same as Heap_Free, kept so aligned allocations read in pairs
+long Heap_FreeAligned(void* pointer){
+  return Heap_Free(pointer);
+}
+
+
+//******** Heap_Free *************** 
+// return a block to the heap
+// input: pointer to memory to unallocate
+// output: HEAP_OK if everything is ok;
+//  HEAP_ERROR_POINTER_OUT_OF_RANGE if pointer points outside the heap;
+//  HEAP_ERROR_CORRUPTED_HEAP if heap has been corrupted or trying to
+//  unallocate memory that has already been unallocated;
+long Heap_Free(void* pointer){
+  long status;
+#ifdef HEAP_THREAD_CACHE
+  status = cachePut(pointer);
+  if(status > 0){
+    return HEAP_OK;
+  }
+  if(status < 0){
+    return HEAP_ERROR_CORRUPTED_HEAP;
+  }
+#endif
+  HEAP_LOCK();
+  status = Heap_FreeIn(&DefaultHeap, pointer);
+  if(status == HEAP_OK){
+    HEAP_TRACE_RECORD(HEAP_TRACE_FREE, pointer, 0, 0);
+  }
+  HEAP_UNLOCK();
+  return status;
+}
+
+
+//******** Heap_FreeBatch *************** 
+// return count blocks to the heap
+// input: 
+//   pointers: blocks to unallocate, in any order, NULL entries are skipped
+//   count: how many pointers
+// output: HEAP_OK or the first error Heap_Free would have returned
+// notes: the trace only records the frees when every pointer was valid
+long Heap_FreeBatch(void** pointers, long count){
+  long status;
+  HEAP_LOCK();
+  status = Heap_FreeBatchIn(&DefaultHeap, pointers, count);
+#ifdef HEAP_TRACE
+  if(status == HEAP_OK){
+    long i;
+    for(i = 0; i < count; i++){
+      if(pointers[i]){
+        HEAP_TRACE_RECORD(HEAP_TRACE_FREE, pointers[i], 0, 0);
       }
-      return blockStart + 1;
     }
-    blockStart = nextBlockHeader(blockStart);
   }
+#endif
+  HEAP_UNLOCK();
+  return status;
+}
+
+
+//******** Heap_Test *************** 
+// Test the heap
+// input: none
+// output: validity of the heap - either HEAP_OK or HEAP_ERROR_HEAP_CORRUPTED
+long Heap_Test(void){
+  long status;
+  HEAP_LOCK();
+  status = Heap_TestIn(&DefaultHeap);
+  HEAP_UNLOCK();
+  return status;
+}
+
+
+//******** Heap_TestStep *************** 
+// Test part of the heap, resuming where the last call stopped
+// input: budget, the most blocks to check, e.g. HEAP_CHECK_BUDGET
+// output: HEAP_OK or HEAP_ERROR_CORRUPTED_HEAP
+// notes: [stevemac] bounded cost per call for control loops and idle
+//  hooks, Heap_Telemetry counts the completed passes over the heap
+long Heap_TestStep(long budget){
+  long status;
+  HEAP_LOCK();
+  status = Heap_TestStepIn(&DefaultHeap, budget);
+  HEAP_UNLOCK();
+  return status;
+}
+
+
+//******** Heap_Stats *************** 
+// return the current status of the heap
+// input: none
+// output: a heap_stats_t that describes the current usage of the heap
+heap_stats_t Heap_Stats(void){
+  heap_stats_t stats;
+  HEAP_LOCK();
+  stats = Heap_StatsIn(&DefaultHeap);
+  HEAP_UNLOCK();
+  return stats;
+}
+
+
+//******** Heap_SetPolicy *************** 
+// Select how Heap_Malloc finds a free block
+// input: HEAP_POLICY_TLSF, HEAP_POLICY_FIRST_FIT, HEAP_POLICY_NEXT_FIT
+//  or HEAP_POLICY_BEST_FIT
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT for an unknown policy
+// notes: may be changed at any time, the free lists are maintained
+//  regardless of the policy in effect
+long Heap_SetPolicy(long policy){
+  long status;
+  HEAP_LOCK();
+  status = Heap_SetPolicyIn(&DefaultHeap, policy);
+  HEAP_UNLOCK();
+  return status;
+}
+
+
+//******** Heap_Telemetry *************** 
+// return the incrementally maintained counters of the heap
+// input: none
+// output: a heap_telemetry_t, see the struct
+// notes: does not walk the heap, only the free list of the largest size
+//  class which normally holds a single block.  Counters restart at
+//  Heap_Init.  Blocks in the per-thread caches count as used and cache
+//  hits are not in the histogram.
+heap_telemetry_t Heap_Telemetry(void){
+  heap_telemetry_t telemetry;
+  HEAP_LOCK();
+  telemetry = Heap_TelemetryIn(&DefaultHeap);
+  HEAP_UNLOCK();
+  return telemetry;
+}
+
+
+//******** Heap_TraceData *************** 
+// The allocation trace recorded since Heap_Init
+// input: bytes: set to the length of the trace
+// output: the trace, see HEAP_TRACE_MALLOC, or NULL without HEAP_TRACE
+// notes: on the board dump it with gdb or Heap_TraceSave (semihosting)
+const unsigned char* Heap_TraceData(size_t* bytes){
+#ifdef HEAP_TRACE
+  *bytes = HeapTraceBytes;
+  return HeapTrace;
+#else
+  *bytes = 0;
   return 0; //NULL
+#endif
 }
 
 
-//******** Heap_Calloc *************** 
+//******** Heap_TraceSave *************** 
+// Write the allocation trace to a file
+// input: path of the file
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT if the file can't be written
+//  or the library was built without HEAP_TRACE
+long Heap_TraceSave(const char* path){
+#ifdef HEAP_TRACE
+  FILE* file = fopen(path, "wb");
+  size_t written;
+  if(file == 0){
+    return HEAP_ERROR_BAD_ARGUMENT;
+  }
+  HEAP_LOCK();
+  written = fwrite(HeapTrace, 1, HeapTraceBytes, file);
+  HEAP_UNLOCK();
+  if(fclose(file) || written != HeapTraceBytes){
+    return HEAP_ERROR_BAD_ARGUMENT;
+  }
+  return HEAP_OK;
+#else
+  (void)path;
+  return HEAP_ERROR_BAD_ARGUMENT;
+#endif
+}
+
+
+//******** Heap_ThreadFlush *************** 
+// Return the calling thread's cached blocks to the default heap
+// input: none
+// output: none
+// notes: only does something when built with HEAP_THREADSAFE.  Runs
+//  automatically when a thread exits, call it before Heap_Test or
+//  Heap_Stats to see cached blocks as unused.
+void Heap_ThreadFlush(void){
+#ifdef HEAP_THREAD_CACHE
+  heap_cache_t* cache = threadCache();
+  long room;
+  for(room = HEAP_MIN_ROOM; room <= HEAP_CACHE_ROOMS; room++){
+    cacheRelease(cache, room, cache->counts[room]);
+  }
+#endif
+}
+
+
+//******** Heap_HandleAlloc *************** 
+// Allocate a relocatable block, data not initialized
+// input: 
+//   desiredBytes: desired number of bytes to allocate
+// output: a handle or 0 if there isn't sufficient space or no free
+//   handle.  Compacts the heap and tries again before giving up.
+heap_handle_t Heap_HandleAlloc(long desiredBytes){
+  heap_handle_t handle;
+  HEAP_LOCK();
+  handle = Heap_HandleAllocIn(&DefaultHeap, desiredBytes);
+  HEAP_UNLOCK();
+  return handle;
+}
+
+
+//******** Heap_HandleLock *************** 
+// Pin a relocatable block and return its address
+// input: handle from Heap_HandleAlloc
+// output: pointer to the data or NULL for an invalid handle
+void* Heap_HandleLock(heap_handle_t handle){
+  void* data;
+  HEAP_LOCK();
+  data = Heap_HandleLockIn(&DefaultHeap, handle);
+  HEAP_UNLOCK();
+  return data;
+}
+
+
+//******** Heap_HandleUnlock *************** 
+// Release one lock on a relocatable block
+// input: handle from Heap_HandleAlloc
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT
+long Heap_HandleUnlock(heap_handle_t handle){
+  long status;
+  HEAP_LOCK();
+  status = Heap_HandleUnlockIn(&DefaultHeap, handle);
+  HEAP_UNLOCK();
+  return status;
+}
+
+
+//******** Heap_HandleFree *************** 
+// return a relocatable block to the heap
+// input: handle from Heap_HandleAlloc
+// output: HEAP_OK, HEAP_ERROR_BAD_ARGUMENT or the errors of Heap_Free
+long Heap_HandleFree(heap_handle_t handle){
+  long status;
+  HEAP_LOCK();
+  status = Heap_HandleFreeIn(&DefaultHeap, handle);
+  HEAP_UNLOCK();
+  return status;
+}
+
+
+//******** Heap_Compact *************** 
+// Slide unlocked relocatable blocks down over the free blocks below them
+// input: none
+// output: number of blocks moved
+long Heap_Compact(void){
+  long moved;
+  HEAP_LOCK();
+  moved = Heap_CompactIn(&DefaultHeap);
+  HEAP_UNLOCK();
+  return moved;
+}
+
+
+//******** Heap_AddRegion *************** 
+// Give the default heap another region of memory
+// input: region and its size in bytes, above the end of the heap
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT
+long Heap_AddRegion(void* region, size_t bytes){
+  long status;
+  HEAP_LOCK();
+  status = Heap_AddRegionIn(&DefaultHeap, region, bytes);
+  HEAP_UNLOCK();
+  return status;
+}
+
+
+//******** Heap_MallocIn *************** 
+// Allocate memory, data not initialized
+// input: 
+//   heap: heap to use
+//   desiredBytes: desired number of bytes to allocate
+// output: void* pointing to the allocated memory or will return NULL
+//   if there isn't sufficient space to satisfy allocation request
+void* Heap_MallocIn(heap_t* heap, long desiredBytes){
+  long desiredWords = (desiredBytes + sizeof(long) - 1) / sizeof(long);
+  long* blockStart;
+  if(desiredWords <= 0){
+    return 0; //NULL
+  }
+  if(desiredWords < HEAP_MIN_ROOM){
+    desiredWords = HEAP_MIN_ROOM;
+  }
+  switch(heap->policy){
+  case HEAP_POLICY_FIRST_FIT:
+    blockStart = findFirstFitBlock(heap, desiredWords);
+    break;
+  case HEAP_POLICY_NEXT_FIT:
+    blockStart = findNextFitBlock(heap, desiredWords);
+    break;
+  case HEAP_POLICY_BEST_FIT:
+    blockStart = findBestFitBlock(heap, desiredWords);
+    break;
+  default:
+    blockStart = findSuitableBlock(heap, desiredWords);
+    break;
+  }
+  if(blockStart == 0){
+    heap->failedMallocs++;
+    return 0; //NULL
+  }
+  removeFreeBlock(heap, blockStart);
+  if(splitAndMarkBlockUsed(heap, blockStart, desiredWords)){
+    return 0; //NULL
+  }
+  countAllocation(heap, blockStart, desiredBytes);
+  return blockStart + 1;
+}
+
+
+//******** Heap_CallocIn *************** 
 // Allocate memory, data are initialized to 0
 // input:
+//   heap: heap to use
 //   desiredBytes: desired number of bytes to allocate
 // output: void* pointing to the allocated memory block or will return NULL
 //   if there isn't sufficient space to satisfy allocation request
 //notes: the allocated memory block will be zeroed out
-void* Heap_Calloc(long desiredBytes){  
+void* Heap_CallocIn(heap_t* heap, long desiredBytes){  
   long* blockPtr;
   long wordsToClear;
   long i;
   
   //malloc a block
-  blockPtr = (long*)Heap_Malloc(desiredBytes);
+  blockPtr = (long*)Heap_MallocIn(heap, desiredBytes);
 
   //did malloc fail?
   if(blockPtr == 0){
@@ -127,24 +786,155 @@ void* Heap_Calloc(long desiredBytes){
 }
 
 
-//******** Heap_Realloc *************** 
+//******** Heap_MallocBatchIn *************** 
+// Allocate count blocks of the same size, data not initialized
+// input: 
+//   heap: heap to use
+//   count: how many blocks
+//   desiredBytes: desired number of bytes for each block
+//   out: array of count pointers that receives the blocks
+// output: how many blocks were allocated, the rest of out is NULL
+// notes: asks the segregated lists for one free block that holds all of
+//  the blocks, whatever the policy.  When there is none the largest free
+//  block is carved and the search repeats for what is left.  Every block
+//  but the last from a free block is cut exactly, the last one takes the
+//  usual split so the leftover goes back on the lists.
+long Heap_MallocBatchIn(heap_t* heap, long count, long desiredBytes, void** out){
+  long desiredWords = (desiredBytes + sizeof(long) - 1) / sizeof(long);
+  long done = 0;
+  long i;
+  for(i = 0; i < count; i++){
+    out[i] = 0; //NULL
+  }
+  if(desiredWords <= 0){
+    return 0;
+  }
+  if(desiredWords < HEAP_MIN_ROOM){
+    desiredWords = HEAP_MIN_ROOM;
+  }
+  while(done < count){
+    long want = count - done;
+    long* blockStart;
+    long fit;
+    // a run too big to size in a long can only come from several blocks
+    if(want > LONG_MAX / (desiredWords + 2)){
+      blockStart = findSuitableBlock(heap, desiredWords);
+    }
+    else{
+      blockStart = findSuitableBlock(heap, want * (desiredWords + 2) - 2);
+    }
+    if(blockStart == 0){
+      blockStart = largestFreeBlock(heap);
+      if(blockStart == 0 || blockRoom(blockStart) < desiredWords){
+        heap->failedMallocs++;
+        break;
+      }
+    }
+    removeFreeBlock(heap, blockStart);
+    fit = (blockRoom(blockStart) + 2) / (desiredWords + 2);
+    if(fit > want){
+      fit = want;
+    }
+    while(fit-- > 1){
+      long leftoverRoom = blockRoom(blockStart) - desiredWords - 2;
+      long* nextStart = blockStart + desiredWords + 2;
+      *blockStart = desiredWords; // marked used
+      *(nextStart - 1) = desiredWords;
+      *nextStart = -leftoverRoom; // the rest, not on the lists
+      *blockTrailer(nextStart) = -leftoverRoom;
+      countAllocation(heap, blockStart, desiredBytes);
+      out[done++] = blockStart + 1;
+      blockStart = nextStart;
+    }
+    if(splitAndMarkBlockUsed(heap, blockStart, desiredWords)){
+      break;
+    }
+    countAllocation(heap, blockStart, desiredBytes);
+    out[done++] = blockStart + 1;
+  }
+  return done;
+}
+
+
+//******** Heap_MallocAlignedIn *************** 
+// Allocate memory aligned to a power of two, data not initialized
+// input: 
+//   heap: heap to use
+//   desiredBytes: desired number of bytes to allocate
+//   align: alignment in bytes, a power of two
+// output: void* aligned to align or NULL if there isn't sufficient space
+//   or align is not a power of two
+// notes: alignments up to sizeof(long) are plain mallocs.  Otherwise a
+//   free block is carved in three: a leading free block up to the aligned
+//   address (none if the block happens to be aligned), the used block and
+//   the usual trailing split.
+void* Heap_MallocAlignedIn(heap_t* heap, long desiredBytes, size_t align){
+  long desiredWords = (desiredBytes + sizeof(long) - 1) / sizeof(long);
+  long alignWords = (long)(align / sizeof(long));
+  long* blockStart;
+  long* alignedStart;
+  long room;
+  long gap;
+  if(align == 0 || (align & (align - 1))){
+    return 0; //NULL
+  }
+  if(align <= sizeof(long)){
+    return Heap_MallocIn(heap, desiredBytes);
+  }
+  if(desiredWords <= 0){
+    return 0; //NULL
+  }
+  if(desiredWords < HEAP_MIN_ROOM){
+    desiredWords = HEAP_MIN_ROOM;
+  }
+  blockStart = findAlignedBlock(heap, desiredWords, alignWords);
+  if(blockStart == 0){
+    heap->failedMallocs++;
+    return 0; //NULL
+  }
+  removeFreeBlock(heap, blockStart);
+  room = blockRoom(blockStart);
+  gap = alignedGap(blockStart, alignWords);
+  alignedStart = blockStart + gap;
+  if(gap){
+    // the skipped words are a free block, the block above is used
+    *blockStart = -(gap - 2);
+    *(alignedStart - 1) = -(gap - 2);
+    *alignedStart = -(room - gap);
+    *blockTrailer(alignedStart) = -(room - gap);
+    insertFreeBlock(heap, blockStart);
+  }
+  if(splitAndMarkBlockUsed(heap, alignedStart, desiredWords)){
+    return 0; //NULL
+  }
+  countAllocation(heap, alignedStart, desiredBytes);
+  return alignedStart + 1;
+}
+
+
+//******** Heap_ReallocIn *************** 
 // Reallocate buffer to a new size
 //input: 
+//  heap: heap to use
 //  oldBlock: pointer to a block
 //  desiredBytes: a desired number of bytes for a new block
 //    where the contents of the old block will be copied to
 // output: void* pointing to the new block or will return NULL
 //   if there is any reason the reallocation can't be completed
-// notes: the given block will be unallocated after its contents
-//   are copied to the new block
-void* Heap_Realloc(void* oldBlock, long desiredBytes){
+// notes: [stevemac] the block is resized in place when it can be:
+//   shrinking splits the tail off as a free block, growing takes room
+//   from the next block when it is free and big enough.  Only otherwise
+//   is a new block allocated, the contents copied and the given block
+//   unallocated.  On failure the given block is left untouched.
+void* Heap_ReallocIn(heap_t* heap, void* oldBlock, long desiredBytes){
   long* oldBlockPtr;
   long* oldBlockStart;
+  long* nextBlockStart;
   long* newBlockPtr;
+  long desiredWords;
   long oldBlockRoom;
   long newBlockRoom;
   long wordsToCopy;
-  long i;
   
   oldBlockPtr = (long*) oldBlock;
   // error if...
@@ -155,17 +945,49 @@ void* Heap_Realloc(void* oldBlock, long desiredBytes){
 #else
   oldBlockStart = oldBlockPtr - 1;
 #endif
-  if(!inHeapRange(oldBlockStart) || blockUnused(oldBlockStart)){
+  if(!inHeapRange(heap, oldBlockStart) || blockUnused(oldBlockStart)){
     return 0; // NULL
   }
+  desiredWords = (desiredBytes + sizeof(long) - 1) / sizeof(long);
+  if(desiredWords <= 0){
+    return 0; // NULL
+  }
+  if(desiredWords < HEAP_MIN_ROOM){
+    desiredWords = HEAP_MIN_ROOM;
+  }
+  oldBlockRoom = blockRoom(oldBlockStart);
 
-  newBlockPtr = (long*)Heap_Malloc(desiredBytes);
+  // shrink in place
+  if(desiredWords <= oldBlockRoom){
+    shrinkUsedBlock(heap, oldBlockStart, desiredWords);
+    heap->usedWords -= oldBlockRoom;
+    heap->usedBlocks--;
+    countAllocation(heap, oldBlockStart, desiredBytes);
+    return oldBlockPtr;
+  }
+  // grow in place into the next block
+  nextBlockStart = nextBlockHeader(oldBlockStart);
+  if(inHeapRange(heap, nextBlockStart) && blockUnused(nextBlockStart) &&
+     oldBlockRoom + 2 + blockRoom(nextBlockStart) >= desiredWords){
+    long* blockEnd = blockTrailer(nextBlockStart);
+    long room = oldBlockRoom + 2 + blockRoom(nextBlockStart);
+    removeFreeBlock(heap, nextBlockStart);
+    headerRemoved(heap, nextBlockStart, oldBlockStart);
+    *oldBlockStart = room;
+    *blockEnd = room;
+    shrinkUsedBlock(heap, oldBlockStart, desiredWords);
+    heap->usedWords -= oldBlockRoom;
+    heap->usedBlocks--;
+    countAllocation(heap, oldBlockStart, desiredBytes);
+    return oldBlockPtr;
+  }
+
+  // move
+  newBlockPtr = (long*)Heap_MallocIn(heap, desiredBytes);
   // did Malloc fail?
   if(newBlockPtr == 0){
     return 0; // NULL
   }
-  
-  oldBlockRoom = blockRoom(oldBlockStart);
   newBlockRoom = blockRoom(newBlockPtr - 1);
   if(oldBlockRoom < newBlockRoom){
     wordsToCopy = oldBlockRoom;
@@ -173,39 +995,32 @@ void* Heap_Realloc(void* oldBlock, long desiredBytes){
   else{
     wordsToCopy = newBlockRoom;
   }  
-  for(i = 0; i < wordsToCopy; i++){
-    newBlockPtr[i] = oldBlockPtr[i];
-  }
-  if(Heap_Free(oldBlockPtr)){
+  memcpy(newBlockPtr, oldBlockPtr, wordsToCopy * sizeof(long));
+  if(Heap_FreeIn(heap, oldBlockPtr)){
     return 0; // NULL Free failed
   }
   return newBlockPtr;
 }
 
 
-//******** Heap_Free *************** 
+//******** Heap_FreeIn *************** 
 // return a block to the heap
-// input: pointer to memory to unallocate
+// input: heap to use and pointer to memory to unallocate
 // output: HEAP_OK if everything is ok;
 //  HEAP_ERROR_POINTER_OUT_OF_RANGE if pointer points outside the heap;
 //  HEAP_ERROR_CORRUPTED_HEAP if heap has been corrupted or trying to
 //  unallocate memory that has already been unallocated;
-long Heap_Free(void* pointer){
+long Heap_FreeIn(heap_t* heap, void* pointer){
   long* blockStart;
-  long* blockEnd;
   long* nextBlockStart;
   
   blockStart = ((long*)pointer) - 1;
 
   //-----Begin error checking-------
-  if(!inHeapRange(blockStart)){
+  if(!inHeapRange(heap, blockStart)){
     return HEAP_ERROR_POINTER_OUT_OF_RANGE;
   }
-  if(blockUnused(blockStart)){
-    return HEAP_ERROR_CORRUPTED_HEAP;
-  }
-  blockEnd = blockTrailer(blockStart);
-  if(!inHeapRange(blockEnd) || blockUnused(blockEnd)){
+  if(checkBlockToFree(heap, blockStart) != HEAP_OK){
     return HEAP_ERROR_CORRUPTED_HEAP;
   }
   //-----End error checking-------
@@ -213,97 +1028,414 @@ long Heap_Free(void* pointer){
   if(markBlockUnused(blockStart)){
     return HEAP_ERROR_CORRUPTED_HEAP;
   }
+  heap->usedWords -= blockRoom(blockStart);
+  heap->usedBlocks--;
 
   // time to possibly merge with block above
   // first, make sure there IS a block above us
-  if(blockStart > HEAP_START){ 
+  if(blockStart > heap->start){ 
     long* previousBlockStart = previousBlockHeader(blockStart);
     // second, make sure we only merge with an unused block
     if(blockUnused(previousBlockStart)){
-      mergeBlockWithBelow(previousBlockStart);
+      removeFreeBlock(heap, previousBlockStart);
+      mergeBlockWithBelow(heap, previousBlockStart);
       blockStart = previousBlockStart; // start of block has moved
     }
   }
 
   // possibly merge with block below
   nextBlockStart = nextBlockHeader(blockStart);
-  if(inHeapRange(nextBlockStart) && blockUnused(nextBlockStart)){
-    mergeBlockWithBelow(blockStart);
+  if(inHeapRange(heap, nextBlockStart) && blockUnused(nextBlockStart)){
+    removeFreeBlock(heap, nextBlockStart);
+    mergeBlockWithBelow(heap, blockStart);
   }
+  insertFreeBlock(heap, blockStart);
   return HEAP_OK;
 }
 
 
-//******** Heap_Test *************** 
+//******** Heap_FreeBatchIn *************** 
+// return count blocks to the heap
+// input: 
+//   heap: heap to use
+//   pointers: blocks to unallocate, in any order, NULL entries are skipped
+//   count: how many pointers
+// output: HEAP_OK or the first error Heap_FreeIn would have returned
+// notes: two passes.  The first runs Heap_FreeIn's checks on each block,
+//  then marks it unused and tags it pending instead of putting it on a
+//  list.  The second takes each
+//  pending block, walks back to the first unused block of its run and
+//  merges the whole run in one go, so the other blocks of the run are
+//  skipped when their turn comes.  Linear in count whatever the order.
+long Heap_FreeBatchIn(heap_t* heap, void** pointers, long count){
+  long status = HEAP_OK;
+  long i;
+  for(i = 0; i < count; i++){
+    long* blockStart;
+    if(pointers[i] == 0){
+      continue;
+    }
+    blockStart = ((long*)pointers[i]) - 1;
+    if(!inHeapRange(heap, blockStart)){
+      if(status == HEAP_OK){
+        status = HEAP_ERROR_POINTER_OUT_OF_RANGE;
+      }
+      continue;
+    }
+    if(checkBlockToFree(heap, blockStart) != HEAP_OK ||
+       markBlockUnused(blockStart)){
+      if(status == HEAP_OK){
+        status = HEAP_ERROR_CORRUPTED_HEAP;
+      }
+      continue;
+    }
+    heap->usedWords -= blockRoom(blockStart);
+    heap->usedBlocks--;
+    HEAP_NEXT_FREE(blockStart) = HEAP_PENDING_FREE;
+  }
+  for(i = 0; i < count; i++){
+    long* blockStart;
+    long* runStart;
+    long* runEnd = 0;
+    long room;
+    if(pointers[i] == 0){
+      continue;
+    }
+    blockStart = ((long*)pointers[i]) - 1;
+    if(!inHeapRange(heap, blockStart) || !inHeapRange(heap, blockStart + 2) ||
+       !blockUnused(blockStart) ||
+       HEAP_NEXT_FREE(blockStart) != HEAP_PENDING_FREE){
+      continue; // invalid or already merged into an earlier run
+    }
+    runStart = blockStart;
+    while(runStart > heap->start && blockUnused(runStart - 1)){
+      runStart = blockHeader(runStart - 1);
+    }
+    for(blockStart = runStart; inHeapRange(heap, blockStart) && blockUnused(blockStart);
+        blockStart = runEnd + 1){
+      if(HEAP_NEXT_FREE(blockStart) == HEAP_PENDING_FREE){
+        HEAP_NEXT_FREE(blockStart) = 0;
+      }
+      else{
+        removeFreeBlock(heap, blockStart);
+      }
+      if(blockStart != runStart){
+        headerRemoved(heap, blockStart, runStart);
+      }
+      runEnd = blockTrailer(blockStart);
+    }
+    room = runEnd - runStart - 1;
+    *runStart = -room;
+    *runEnd = -room;
+    insertFreeBlock(heap, runStart);
+  }
+  return status;
+}
+
+
+//******** Heap_TestIn *************** 
 // Test the heap
-// input: none
+// input: heap to use
 // output: validity of the heap - either HEAP_OK or HEAP_ERROR_HEAP_CORRUPTED
-long Heap_Test(void){
-  long lastBlockWasUnused = 0;
-  long* blockStart = HEAP_START;
-  while(inHeapRange(blockStart)){
-    long* blockEnd;
-    
-    //shouldn't have any blocks holding zero words
-    if(*blockStart == 0){
+long Heap_TestIn(heap_t* heap){
+  long* blockStart = heap->start;
+  while(inHeapRange(heap, blockStart)){
+    if(testBlock(heap, blockStart)){
       return HEAP_ERROR_CORRUPTED_HEAP;
     }
-    blockEnd = blockTrailer(blockStart);
-    //error if blockEnd is not in the heap or blockend disagrees with blockStart
-    if(!inHeapRange(blockEnd) || *blockStart != *blockEnd){
+    blockStart = nextBlockHeader(blockStart);
+  }
+  //traversing the heap should end exactly where the heap ends
+  if(blockStart != heap->end){
+    return HEAP_ERROR_CORRUPTED_HEAP;
+  }
+  return HEAP_OK;
+}
+
+
+//******** Heap_TestStepIn *************** 
+// Test part of the heap, resuming where the last call stopped
+// input: heap to use and budget, the most blocks to check
+// output: HEAP_OK or HEAP_ERROR_CORRUPTED_HEAP
+// notes: the cursor stays on a block header while blocks are merged,
+//  so the heap can change freely between calls.  A corrupted block is
+//  reported again on every call until the heap is reinitialized.
+long Heap_TestStepIn(heap_t* heap, long budget){
+  long* blockStart = heap->checkCursor;
+  while(budget-- > 0){
+    if(testBlock(heap, blockStart)){
+      heap->checkCursor = blockStart;
       return HEAP_ERROR_CORRUPTED_HEAP;
     }
-    //error if we have two adjacent unused blocks
-    if(lastBlockWasUnused && blockUnused(blockStart)){
-      return HEAP_ERROR_CORRUPTED_HEAP;
+    blockStart = nextBlockHeader(blockStart);
+    if(blockStart == heap->end){
+      blockStart = heap->start;
+      heap->checkPasses++;
     }
-    lastBlockWasUnused = blockUnused(blockStart);
-    blockStart = blockEnd + 1;
   }
-  //traversing the heap should end exactly where the heap ends
-  if(blockStart != HEAP_END){
-    return HEAP_ERROR_CORRUPTED_HEAP;
+  heap->checkCursor = blockStart;
+  return HEAP_OK;
+}
+
+
+//******** Heap_StatsIn *************** 
+// return the current status of the heap
+// input: heap to use
+// output: a heap_stats_t that describes the current usage of the heap
+heap_stats_t Heap_StatsIn(heap_t* heap){
+  long* blockStart;
+  heap_stats_t stats;
+  
+  stats.wordsAllocated = 0;
+  stats.wordsAvailable = 0;
+  stats.blocksUsed = 0;
+  stats.blocksUnused = 0;
+
+  //just go through each block to get stats on heap usage
+  blockStart = heap->start;
+  while(inHeapRange(heap, blockStart)){
+    if(blockUsed(blockStart)){
+      stats.wordsAllocated += blockRoom(blockStart);
+      stats.blocksUsed++;
+    }
+    else{
+      stats.wordsAvailable += blockRoom(blockStart);
+      stats.blocksUnused++;
+    }
+    blockStart = nextBlockHeader(blockStart);
+  }
+  //the gap blocks are not allocations and the gaps are not overhead
+  stats.wordsAllocated -= heap->gapWords + heap->gaps;
+  stats.blocksUsed -= heap->gaps;
+  stats.wordsOverhead = (heap->end - heap->start) - heap->gapWords - stats.wordsAllocated - stats.wordsAvailable;
+  return stats;
+}
+
+
+//******** Heap_TelemetryIn *************** 
+// return the incrementally maintained counters of the heap
+// input: heap to use
+// output: a heap_telemetry_t, see the struct
+// notes: every block costs two words of overhead, so the free room is
+//  whatever the used blocks and the boundary tags leave.  A gap block
+//  covers its gap plus three words.  The high-water mark includes the gaps.
+heap_telemetry_t Heap_TelemetryIn(heap_t* heap){
+  heap_telemetry_t telemetry;
+  long* largest = largestFreeBlock(heap);
+  long freeWords = (heap->end - heap->start) - heap->gapWords - 3 * heap->gaps -
+                   heap->usedWords - 2 * (heap->usedBlocks + heap->freeBlocks);
+  long i;
+  telemetry.bytesInUse = heap->usedWords * sizeof(long);
+  telemetry.peakBytesInUse = heap->peakUsedWords * sizeof(long);
+  telemetry.highWaterBytes = (heap->highWater - heap->start) * sizeof(long);
+  telemetry.blocksInUse = heap->usedBlocks;
+  telemetry.bytesFree = freeWords * sizeof(long);
+  telemetry.blocksFree = heap->freeBlocks;
+  telemetry.largestFreeBytes = largest ? blockRoom(largest) * sizeof(long) : 0;
+  telemetry.fragmentation = 0;
+  if(freeWords > 0){
+    telemetry.fragmentation = 1000 - (1000 * (telemetry.largestFreeBytes / sizeof(long))) / freeWords;
+  }
+  telemetry.failedMallocs = heap->failedMallocs;
+  telemetry.checkPasses = heap->checkPasses;
+  for(i = 0; i < HEAP_HISTOGRAM_BINS; i++){
+    telemetry.histogram[i] = heap->histogram[i];
+  }
+  return telemetry;
+}
+
+
+//******** Heap_SetPolicyIn *************** 
+// Select how Heap_Malloc finds a free block
+// input: heap to use and one of the HEAP_POLICY_... values
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT for an unknown policy
+// notes: may be changed at any time, the free lists are maintained
+//  regardless of the policy in effect
+long Heap_SetPolicyIn(heap_t* heap, long policy){
+  if(policy < 0 || policy >= HEAP_POLICY_COUNT){
+    return HEAP_ERROR_BAD_ARGUMENT;
+  }
+  heap->policy = policy;
+  return HEAP_OK;
+}
+
+
+//******** Heap_HandleAllocIn *************** 
+// Allocate a relocatable block, data not initialized
+// input: 
+//   heap: heap to use
+//   desiredBytes: desired number of bytes to allocate
+// output: a handle or 0 if there isn't sufficient space or no free handle
+// notes: the first word of the room holds the handle's index, compaction
+//  uses it to find the master pointer of a block it moves.  A failed
+//  first attempt is not counted in failedMallocs when compaction saves it.
+heap_handle_t Heap_HandleAllocIn(heap_t* heap, long desiredBytes){
+  long index;
+  long* data;
+  if(desiredBytes <= 0){
+    return 0;
+  }
+  for(index = 0; index < HEAP_HANDLE_COUNT; index++){
+    if(heap->handles[index].block == 0){
+      break;
+    }
+  }
+  if(index == HEAP_HANDLE_COUNT){
+    heap->failedMallocs++;
+    return 0;
+  }
+  data = (long*)Heap_MallocIn(heap, desiredBytes + sizeof(long));
+  if(data == 0 && Heap_CompactIn(heap)){
+    heap->failedMallocs--;
+    data = (long*)Heap_MallocIn(heap, desiredBytes + sizeof(long));
+  }
+  if(data == 0){
+    return 0;
+  }
+  *data = index;
+  heap->handles[index].block = data - 1;
+  heap->handles[index].locks = 0;
+  return index + 1;
+}
+
+
+//******** Heap_HandleLockIn *************** 
+// Pin a relocatable block and return its address
+// input: heap to use and a handle from Heap_HandleAllocIn
+// output: pointer to the data or NULL for an invalid handle
+void* Heap_HandleLockIn(heap_t* heap, heap_handle_t handle){
+  heap_handle_slot_t* slot = handleSlot(heap, handle);
+  if(slot == 0){
+    return 0; //NULL
+  }
+  slot->locks++;
+  return slot->block + 2;
+}
+
+
+//******** Heap_HandleUnlockIn *************** 
+// Release one lock on a relocatable block
+// input: heap to use and a handle from Heap_HandleAllocIn
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT for an invalid or unlocked
+//   handle
+long Heap_HandleUnlockIn(heap_t* heap, heap_handle_t handle){
+  heap_handle_slot_t* slot = handleSlot(heap, handle);
+  if(slot == 0 || slot->locks == 0){
+    return HEAP_ERROR_BAD_ARGUMENT;
   }
+  slot->locks--;
   return HEAP_OK;
 }
 
 
-//******** Heap_Stats *************** 
-// return the current status of the heap
-// input: none
-// output: a heap_stats_t that describes the current usage of the heap
-heap_stats_t Heap_Stats(void){
-  long* blockStart;
-  heap_stats_t stats;
-  
-  stats.wordsAllocated = 0;
-  stats.wordsAvailable = 0;
-  stats.blocksUsed = 0;
-  stats.blocksUnused = 0;
+//******** Heap_HandleFreeIn *************** 
+// return a relocatable block to the heap
+// input: heap to use and a handle from Heap_HandleAllocIn
+// output: HEAP_OK, HEAP_ERROR_BAD_ARGUMENT for an invalid handle or the
+//   errors of Heap_FreeIn
+long Heap_HandleFreeIn(heap_t* heap, heap_handle_t handle){
+  heap_handle_slot_t* slot = handleSlot(heap, handle);
+  long status;
+  if(slot == 0){
+    return HEAP_ERROR_BAD_ARGUMENT;
+  }
+  status = Heap_FreeIn(heap, slot->block + 1);
+  if(status == HEAP_OK){
+    slot->block = 0;
+    slot->locks = 0;
+  }
+  return status;
+}
 
-  //just go through each block to get stats on heap usage
-  blockStart = HEAP_START;
-  while(inHeapRange(blockStart)){
-    if(blockUsed(blockStart)){
-      stats.wordsAllocated += blockRoom(blockStart);
-      stats.blocksUsed++;
+
+//******** Heap_CompactIn *************** 
+// Slide unlocked relocatable blocks down over the free blocks below them
+// input: heap to use
+// output: number of blocks moved
+// notes: a free block followed by a movable block swap places, the free
+//  block then merges with whatever free block follows and the walk goes
+//  on from it, so a run of movable blocks ends up packed against the
+//  first pinned block below it with all of the free space above.
+long Heap_CompactIn(heap_t* heap){
+  long* blockStart = heap->start;
+  long moved = 0;
+  while(inHeapRange(heap, blockStart)){
+    long* next = nextBlockHeader(blockStart);
+    if(blockUnused(blockStart) && inHeapRange(heap, next) && blockMovable(heap, next)){
+      blockStart = slideBlockDown(heap, blockStart);
+      moved++;
     }
     else{
-      stats.wordsAvailable += blockRoom(blockStart);
-      stats.blocksUnused++;
+      blockStart = next;
     }
-    blockStart = nextBlockHeader(blockStart);
   }
-  stats.wordsOverhead = HEAP_SIZE_WORDS - stats.wordsAllocated - stats.wordsAvailable;
-  return stats;
+  return moved;
+}
+
+
+//******** Heap_AddRegionIn *************** 
+// Give a heap another region of memory
+// input:
+//   heap: heap to grow
+//   region: memory to add, above the end of the heap, need not be aligned
+//   bytes: size of the region in bytes
+// output: HEAP_OK or HEAP_ERROR_BAD_ARGUMENT if the region is too small,
+//   below the end of the heap, or the highest block is used or too small
+//   to give up two words
+// notes: the highest block shrinks by two words for the header and the
+//  mark of the gap block, the first word of the region is its trailer.
+//  The gap block is used, so nothing merges with it, and its mark keeps
+//  Heap_CompactIn from taking it for a handle block.
+long Heap_AddRegionIn(heap_t* heap, void* region, size_t bytes){
+  unsigned long address = (unsigned long)region;
+  unsigned long aligned = (address + sizeof(long) - 1) & ~(sizeof(long) - 1);
+  long words;
+  long room;
+  long* top;
+  long* gapStart;
+  long* blockStart;
+  if(heap == 0 || region == 0 || bytes < aligned - address || (long*)aligned < heap->end){
+    return HEAP_ERROR_BAD_ARGUMENT;
+  }
+  words = (long)((bytes - (aligned - address)) / sizeof(long));
+  if(words < HEAP_MIN_ROOM + 3){
+    return HEAP_ERROR_BAD_ARGUMENT;
+  }
+  if(words > HEAP_MAX_ROOM + 3){
+    words = HEAP_MAX_ROOM + 3;
+  }
+  top = blockHeader(heap->end - 1);
+  room = blockRoom(top);
+  if(blockUsed(top) || room < HEAP_MIN_ROOM + 2){
+    return HEAP_ERROR_BAD_ARGUMENT;
+  }
+  removeFreeBlock(heap, top);
+  *top = -(room - 2);
+  *blockTrailer(top) = -(room - 2);
+  insertFreeBlock(heap, top);
+  //the gap block, from the old top of the heap to the region
+  gapStart = heap->end - 2;
+  blockStart = (long*)aligned;
+  *gapStart = blockStart - gapStart - 1;
+  *blockStart = *gapStart;
+  gapStart[1] = HEAP_GAP_MARK;
+  heap->gaps++;
+  heap->gapWords += *gapStart - 1;
+  //the rest of the region is one unused block
+  blockStart++;
+  heap->end = blockStart + words - 1;
+  *blockStart = -(words - 3);
+  *blockTrailer(blockStart) = -(words - 3);
+  insertFreeBlock(heap, blockStart);
+  return HEAP_OK;
 }
 
 
 // inHeapRange
 // input: a pointer
 // output: whether or not the pointer points inside the heap
-static long inHeapRange(long* address){
-  return address >= HEAP_START && address < HEAP_END;
+static long inHeapRange(heap_t* heap, long* address){
+  return address >= heap->start && address < heap->end;
 }
 
 
@@ -364,7 +1496,7 @@ static long* blockTrailer(long* blockStart){
 // nextBlockHeader
 // input: pointer to the header of a block
 // output: pointer the the header of the next block in the heap
-// notes: given the header of the last block in the heap, will point to HEAP_END,
+// notes: given the header of the last block in the heap, will point to heap->end,
 //   which is not a valid block; be careful
 static long* nextBlockHeader(long* blockStart){
   return blockTrailer(blockStart) + 1;
@@ -381,6 +1513,43 @@ static long* previousBlockHeader(long* blockStart){
 }
 
 
+// checkBlockToFree
+// input: heap and the header of a used block about to be freed, in range
+// output: HEAP_OK, or HEAP_ERROR_CORRUPTED_HEAP if the block is unused or
+//   its trailer or a neighbour's tags are wrong
+// notes: [stevemac] the neighbours' tags are about to be trusted for
+//   merging, a two word compare each catches a neighbour overrun before it
+//   spreads.  Heap_FreeIn and Heap_FreeBatchIn both run it.
+static long checkBlockToFree(heap_t* heap, long* blockStart){
+  long* blockEnd;
+  long* nextBlockStart;
+  if(blockUnused(blockStart)){
+    return HEAP_ERROR_CORRUPTED_HEAP;
+  }
+  blockEnd = blockTrailer(blockStart);
+  if(!inHeapRange(heap, blockEnd) || blockUnused(blockEnd)){
+    return HEAP_ERROR_CORRUPTED_HEAP;
+  }
+  if(blockStart > heap->start){
+    long* previousBlockEnd = blockStart - 1;
+    long* previousBlockStart = blockHeader(previousBlockEnd);
+    if(*previousBlockEnd == 0 || !inHeapRange(heap, previousBlockStart) ||
+       *previousBlockStart != *previousBlockEnd){
+      return HEAP_ERROR_CORRUPTED_HEAP;
+    }
+  }
+  nextBlockStart = blockEnd + 1;
+  if(inHeapRange(heap, nextBlockStart)){
+    long* nextBlockEnd = blockTrailer(nextBlockStart);
+    if(*nextBlockStart == 0 || !inHeapRange(heap, nextBlockEnd) ||
+       *nextBlockStart != *nextBlockEnd){
+      return HEAP_ERROR_CORRUPTED_HEAP;
+    }
+  }
+  return HEAP_OK;
+}
+
+
 // markBlockUsed
 // input: pointer to the header of a block
 // output: a heap flag - HEAP_OK if everything is ok or HEAP_ERROR_CORRUPTEDHEAP
@@ -421,11 +1590,12 @@ static long markBlockUnused(long* blockStart){
 // notes: splits the block given so that the new upper block holds desiredRoom
 //  words (or more).  Marks the upper block as used, lower block as unused.
 //  Will not split a block if the leftover room is insufficient to make another
-//  useful block.
-static long splitAndMarkBlockUsed(long* upperBlockStart, long desiredRoom){
+//  useful block.  The block must already be off the free lists, the lower
+//  block is put on them.
+static long splitAndMarkBlockUsed(heap_t* heap, long* upperBlockStart, long desiredRoom){
   long leftoverRoom = blockRoom(upperBlockStart) - desiredRoom - 2;
   // only split block if leftovers could actually make another useful block
-  if(leftoverRoom > 0){
+  if(leftoverRoom >= HEAP_MIN_ROOM){
     long* upperBlockEnd = upperBlockStart + desiredRoom + 1;
     long* lowerBlockStart = upperBlockEnd + 1;
     long* lowerBlockEnd = blockTrailer(upperBlockStart);
@@ -433,6 +1603,7 @@ static long splitAndMarkBlockUsed(long* upperBlockStart, long desiredRoom){
     *upperBlockEnd = desiredRoom;
     *lowerBlockStart = -leftoverRoom; // marked unused
     *lowerBlockEnd = -leftoverRoom;
+    insertFreeBlock(heap, lowerBlockStart);
   }
   // can't split block - just mark it at used
   else{
@@ -449,10 +1620,12 @@ static long splitAndMarkBlockUsed(long* upperBlockStart, long desiredRoom){
 // output: none
 // notes: will merge the given block with the block below it.
 //  WARNING: Does not check that the block below actually exists.
-static void mergeBlockWithBelow(long* upperBlockStart){
+//  Free list bookkeeping is left to the caller.
+static void mergeBlockWithBelow(heap_t* heap, long* upperBlockStart){
   long* upperBlockEnd = blockTrailer(upperBlockStart);
   long* lowerBlockStart = upperBlockEnd + 1;
   long* lowerBlockEnd = blockTrailer(lowerBlockStart);
+  headerRemoved(heap, lowerBlockStart, upperBlockStart);
 
   long room = lowerBlockEnd - upperBlockStart - 1;
   *upperBlockStart = -room;
@@ -461,3 +1634,662 @@ static void mergeBlockWithBelow(long* upperBlockStart){
 }
 
 
+
+
+// highestBit
+// input: a non-zero word
+// output: index of the most significant set bit, one CLZ instruction
+static long highestBit(unsigned long word){
+  return (long)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl(word);
+}
+
+
+// lowestBit
+// input: a non-zero word
+// output: index of the least significant set bit
+// notes: isolates the bit with word & -word so it is also a single CLZ
+static long lowestBit(unsigned long word){
+  return highestBit(word & (~word + 1));
+}
+
+
+// mappingInsert
+// input: room of a free block in words
+// output: the first and second level index of the list the block belongs on
+// notes: rooms too large for the table are kept in the last list
+static void mappingInsert(long room, long* fl, long* sl){
+  if(room < HEAP_SMALL_ROOM){
+    *fl = 0;
+    *sl = room;
+  }
+  else{
+    long msb = highestBit((unsigned long)room);
+    *fl = msb - HEAP_SL_LOG2 + 1;
+    *sl = (room >> (msb - HEAP_SL_LOG2)) - HEAP_SL_COUNT;
+  }
+  if(*fl >= HEAP_FL_COUNT){
+    *fl = HEAP_FL_COUNT - 1;
+    *sl = HEAP_SL_COUNT - 1;
+  }
+}
+
+
+// mappingSearch
+// input: desired room in words
+// output: the first and second level index of the smallest list whose
+//  blocks are all big enough
+// notes: rounds the room up to the next class boundary; *fl may come back
+//  as HEAP_FL_COUNT or more when nothing in the table can fit
+static void mappingSearch(long room, long* fl, long* sl){
+  if(room >= HEAP_SMALL_ROOM){
+    long msb = highestBit((unsigned long)room);
+    room += (1L << (msb - HEAP_SL_LOG2)) - 1;
+    msb = highestBit((unsigned long)room);
+    *fl = msb - HEAP_SL_LOG2 + 1;
+    *sl = (room >> (msb - HEAP_SL_LOG2)) - HEAP_SL_COUNT;
+    return;
+  }
+  *fl = 0;
+  *sl = room;
+}
+
+
+// findSuitableBlock
+// input: desired room in words
+// output: header of a free block with at least that much room or NULL
+// notes: constant time, two bitmap lookups
+static long* findSuitableBlock(heap_t* heap, long room){
+  long fl, sl;
+  unsigned long slMap;
+  mappingSearch(room, &fl, &sl);
+  if(fl >= HEAP_FL_COUNT){
+    // only the overflow list can hold a block this big, check its head
+    long* blockStart = heap->freeLists[HEAP_FL_COUNT - 1][HEAP_SL_COUNT - 1];
+    if(blockStart && blockRoom(blockStart) >= room){
+      return blockStart;
+    }
+    return 0; //NULL
+  }
+  slMap = heap->slBitmap[fl] & (~0UL << sl);
+  if(slMap == 0){
+    unsigned long flMap = heap->flBitmap & (~0UL << (fl + 1));
+    if(flMap == 0){
+      return 0; //NULL
+    }
+    fl = lowestBit(flMap);
+    slMap = heap->slBitmap[fl];
+  }
+  sl = lowestBit(slMap);
+  return heap->freeLists[fl][sl];
+}
+
+
+// findFirstFitBlock
+// input: desired room in words
+// output: header of the first free block from heap->start big enough or NULL
+// notes: the original allocation strategy, linear in the number of blocks
+static long* findFirstFitBlock(heap_t* heap, long room){
+  long* blockStart = heap->start;
+  while(inHeapRange(heap, blockStart)){
+  // one pass through the heap
+  // choose first block that is big enough
+    if(blockUnused(blockStart) && room <= blockRoom(blockStart)){
+      return blockStart;
+    }
+    blockStart = nextBlockHeader(blockStart);
+  }
+  return 0; //NULL
+}
+
+
+// findNextFitBlock
+// input: desired room in words
+// output: header of the first free block big enough from where the last
+//  search stopped, wrapping around once, or NULL
+// notes: linear like first fit, but spreads allocations over the heap
+//  instead of piling small blocks at its start
+static long* findNextFitBlock(heap_t* heap, long room){
+  long* blockStart = heap->rover;
+  do{
+    if(blockUnused(blockStart) && room <= blockRoom(blockStart)){
+      heap->rover = blockStart;
+      return blockStart;
+    }
+    blockStart = nextBlockHeader(blockStart);
+    if(!inHeapRange(heap, blockStart)){
+      blockStart = heap->start;
+    }
+  } while(blockStart != heap->rover);
+  return 0; //NULL
+}
+
+
+// findBestFitBlock
+// input: desired room in words
+// output: header of the smallest free block big enough or NULL
+// notes: the lists are ordered by size class, so only the list the room
+//  maps to and the first non-empty list above it are walked
+static long* findBestFitBlock(heap_t* heap, long room){
+  long fl, sl;
+  long* blockStart;
+  long* best = 0;
+  unsigned long slMap;
+  unsigned long flMap;
+  mappingInsert(room, &fl, &sl);
+  for(blockStart = heap->freeLists[fl][sl]; blockStart; blockStart = HEAP_NEXT_FREE(blockStart)){
+    if(blockRoom(blockStart) >= room && (best == 0 || blockRoom(blockStart) < blockRoom(best))){
+      best = blockStart;
+    }
+  }
+  if(best || (fl == HEAP_FL_COUNT - 1 && sl == HEAP_SL_COUNT - 1)){
+    return best;
+  }
+  // every block on a higher list fits, find the smallest on the next one
+  slMap = (sl + 1 < HEAP_SL_COUNT) ? heap->slBitmap[fl] & (~0UL << (sl + 1)) : 0;
+  if(slMap == 0){
+    flMap = heap->flBitmap & (~0UL << (fl + 1));
+    if(flMap == 0){
+      return 0; //NULL
+    }
+    fl = lowestBit(flMap);
+    slMap = heap->slBitmap[fl];
+  }
+  sl = lowestBit(slMap);
+  best = heap->freeLists[fl][sl];
+  for(blockStart = HEAP_NEXT_FREE(best); blockStart; blockStart = HEAP_NEXT_FREE(blockStart)){
+    if(blockRoom(blockStart) < blockRoom(best)){
+      best = blockStart;
+    }
+  }
+  return best;
+}
+
+
+// alignedGap
+// input:
+//  blockStart: header of a free block
+//  alignWords: alignment in words, a power of two of at least 2
+// output: how many words to skip from blockStart so the block placed
+//  there is aligned, 0 or enough to hold a free block of HEAP_MIN_ROOM
+static long alignedGap(long* blockStart, long alignWords){
+  unsigned long alignBytes = alignWords * sizeof(long);
+  unsigned long data = (unsigned long)(blockStart + 1);
+  long gap = (long)(((data + alignBytes - 1) & ~(alignBytes - 1)) - data) / sizeof(long);
+  while(gap && gap < HEAP_MIN_ROOM + 2){
+    gap += alignWords;
+  }
+  return gap;
+}
+
+
+// findAlignedBlock
+// input: desired room in words and alignment in words
+// output: header of a free block that holds the room at the alignment
+//  or NULL
+// notes: asks the segregated lists for a block big enough whatever its
+//  address, only a nearly full heap falls back to walking every block
+static long* findAlignedBlock(heap_t* heap, long room, long alignWords){
+  long* blockStart = findSuitableBlock(heap, room + 2 * alignWords + HEAP_MIN_ROOM + 2);
+  if(blockStart){
+    return blockStart;
+  }
+  for(blockStart = heap->start; inHeapRange(heap, blockStart); blockStart = nextBlockHeader(blockStart)){
+    if(blockUnused(blockStart) && blockRoom(blockStart) - alignedGap(blockStart, alignWords) >= room){
+      return blockStart;
+    }
+  }
+  return 0; //NULL
+}
+
+
+// headerRemoved
+// input:
+//  removed: header of a block that is being merged away
+//  into: header of the block that absorbs it
+// output: none
+// notes: the next fit rover and the incremental check cursor must always
+//  sit on a header
+static void headerRemoved(heap_t* heap, long* removed, long* into){
+  if(heap->rover == removed){
+    heap->rover = into;
+  }
+  if(heap->checkCursor == removed){
+    heap->checkCursor = into;
+  }
+}
+
+
+// testBlock
+// input: pointer to what should be the header of a block
+// output: HEAP_OK or HEAP_ERROR_CORRUPTED_HEAP
+// notes: checks the block's tags, that an unused block has no unused
+//  block below it and links only to free blocks
+static long testBlock(heap_t* heap, long* blockStart){
+  long* blockEnd;
+  //shouldn't have any blocks holding zero words
+  if(*blockStart == 0){
+    return HEAP_ERROR_CORRUPTED_HEAP;
+  }
+  blockEnd = blockTrailer(blockStart);
+  //error if blockEnd is not in the heap or blockend disagrees with blockStart
+  if(!inHeapRange(heap, blockEnd) || *blockStart != *blockEnd){
+    return HEAP_ERROR_CORRUPTED_HEAP;
+  }
+  if(blockUnused(blockStart)){
+    long* next = HEAP_NEXT_FREE(blockStart);
+    long* previous = HEAP_PREV_FREE(blockStart);
+    //error if we have two adjacent unused blocks
+    if(inHeapRange(heap, blockEnd + 1) && blockUnused(blockEnd + 1)){
+      return HEAP_ERROR_CORRUPTED_HEAP;
+    }
+    //error if an unused block links to something that is not a free block
+    if(next && (!inHeapRange(heap, next) || !blockUnused(next))){
+      return HEAP_ERROR_CORRUPTED_HEAP;
+    }
+    if(previous && (!inHeapRange(heap, previous) || !blockUnused(previous))){
+      return HEAP_ERROR_CORRUPTED_HEAP;
+    }
+  }
+  return HEAP_OK;
+}
+
+
+// insertFreeBlock
+// input: pointer to the header of an unused block
+// output: none
+// notes: pushes the block on the head of its segregated list
+static void insertFreeBlock(heap_t* heap, long* blockStart){
+  long fl, sl;
+  long* head;
+  mappingInsert(blockRoom(blockStart), &fl, &sl);
+  head = heap->freeLists[fl][sl];
+  HEAP_NEXT_FREE(blockStart) = head;
+  HEAP_PREV_FREE(blockStart) = 0;
+  if(head){
+    HEAP_PREV_FREE(head) = blockStart;
+  }
+  heap->freeLists[fl][sl] = blockStart;
+  heap->freeBlocks++;
+  heap->flBitmap |= 1UL << fl;
+  heap->slBitmap[fl] |= (unsigned char)(1U << sl);
+}
+
+
+// removeFreeBlock
+// input: pointer to the header of an unused block on the free lists
+// output: none
+// notes: unlinks the block, clears the bitmaps when its list becomes empty
+static void removeFreeBlock(heap_t* heap, long* blockStart){
+  long fl, sl;
+  long* next = HEAP_NEXT_FREE(blockStart);
+  long* previous = HEAP_PREV_FREE(blockStart);
+  heap->freeBlocks--;
+  if(next){
+    HEAP_PREV_FREE(next) = previous;
+  }
+  if(previous){
+    HEAP_NEXT_FREE(previous) = next;
+    return;
+  }
+  mappingInsert(blockRoom(blockStart), &fl, &sl);
+  heap->freeLists[fl][sl] = next;
+  if(next == 0){
+    heap->slBitmap[fl] &= (unsigned char)~(1U << sl);
+    if(heap->slBitmap[fl] == 0){
+      heap->flBitmap &= ~(1UL << fl);
+    }
+  }
+}
+
+
+// countAllocation
+// input:
+//  blockStart: header of a block that was just allocated or resized
+//  desiredBytes: the size that was asked for
+// output: none
+// notes: telemetry for a successful malloc or realloc
+static void countAllocation(heap_t* heap, long* blockStart, long desiredBytes){
+  long bin = highestBit((unsigned long)desiredBytes);
+  long* blockEnd = blockTrailer(blockStart) + 1;
+  heap->usedWords += blockRoom(blockStart);
+  heap->usedBlocks++;
+  if(heap->usedWords > heap->peakUsedWords){
+    heap->peakUsedWords = heap->usedWords;
+  }
+  if(blockEnd > heap->highWater){
+    heap->highWater = blockEnd;
+  }
+  if(bin >= HEAP_HISTOGRAM_BINS){
+    bin = HEAP_HISTOGRAM_BINS - 1;
+  }
+  heap->histogram[bin]++;
+}
+
+
+// largestFreeBlock
+// input: none
+// output: header of the largest unused block or NULL if there is none
+// notes: the largest block is on the highest non-empty list, only that
+//  list is walked
+static long* largestFreeBlock(heap_t* heap){
+  long fl, sl;
+  long* blockStart;
+  long* largest;
+  if(heap->flBitmap == 0){
+    return 0; //NULL
+  }
+  fl = highestBit(heap->flBitmap);
+  sl = highestBit(heap->slBitmap[fl]);
+  largest = heap->freeLists[fl][sl];
+  for(blockStart = HEAP_NEXT_FREE(largest); blockStart; blockStart = HEAP_NEXT_FREE(blockStart)){
+    if(blockRoom(blockStart) > blockRoom(largest)){
+      largest = blockStart;
+    }
+  }
+  return largest;
+}
+
+
+// shrinkUsedBlock
+// input: 
+//  blockStart: header of a used block
+//  desiredRoom: room in words the block should keep
+// output: none
+// notes: splits the tail off the block as an unused block when the leftover
+//  is big enough, merging it with the next block if that one is unused.
+//  Otherwise the block is left as it is.
+static void shrinkUsedBlock(heap_t* heap, long* blockStart, long desiredRoom){
+  long leftoverRoom = blockRoom(blockStart) - desiredRoom - 2;
+  long* tailStart;
+  long* nextBlockStart;
+  if(leftoverRoom < HEAP_MIN_ROOM){
+    return;
+  }
+  tailStart = blockStart + desiredRoom + 2;
+  nextBlockStart = nextBlockHeader(blockStart);
+  *blockStart = desiredRoom;
+  *(tailStart - 1) = desiredRoom;
+  *tailStart = -leftoverRoom;
+  *(nextBlockStart - 1) = -leftoverRoom;
+  if(inHeapRange(heap, nextBlockStart) && blockUnused(nextBlockStart)){
+    removeFreeBlock(heap, nextBlockStart);
+    mergeBlockWithBelow(heap, tailStart);
+  }
+  insertFreeBlock(heap, tailStart);
+}
+
+
+#ifdef HEAP_THREAD_CACHE
+// cacheRoom
+// input: desiredBytes: size of a malloc request
+// output: the room the request is rounded to, 0 if it is not cached
+static long cacheRoom(long desiredBytes){
+  long desiredWords = (desiredBytes + sizeof(long) - 1) / sizeof(long);
+  if(desiredBytes <= 0 || desiredWords > HEAP_CACHE_ROOMS){
+    return 0;
+  }
+  if(desiredWords < HEAP_MIN_ROOM){
+    desiredWords = HEAP_MIN_ROOM;
+  }
+  return desiredWords;
+}
+
+
+// cacheExit
+// input: the exiting thread's cache
+// output: none
+// notes: pthread key destructor, gives the cached blocks back
+static void cacheExit(void* cache){
+  long room;
+  for(room = HEAP_MIN_ROOM; room <= HEAP_CACHE_ROOMS; room++){
+    cacheRelease((heap_cache_t*)cache, room, ((heap_cache_t*)cache)->counts[room]);
+  }
+}
+
+
+static void cacheKeyCreate(void){
+  pthread_key_create(&HeapCacheKey, cacheExit);
+}
+
+
+// threadCache
+// input: none
+// output: the calling thread's cache
+// notes: registers the exit destructor on first use and empties a cache
+//  left over from before the last Heap_Init, its blocks no longer exist
+static heap_cache_t* threadCache(void){
+  heap_cache_t* cache = &ThreadCache;
+  unsigned long generation = __atomic_load_n(&HeapGeneration, __ATOMIC_ACQUIRE);
+  long room;
+  if(!cache->registered){
+    pthread_once(&HeapCacheOnce, cacheKeyCreate);
+    pthread_setspecific(HeapCacheKey, cache);
+    cache->registered = 1;
+  }
+  if(cache->generation != generation){
+    for(room = 0; room <= HEAP_CACHE_ROOMS; room++){
+      cache->blocks[room] = 0;
+      cache->counts[room] = 0;
+    }
+    cache->generation = generation;
+  }
+  return cache;
+}
+
+
+// cacheGet
+// input: room: room of the block wanted, HEAP_MIN_ROOM..HEAP_CACHE_ROOMS
+// output: a used block of at least that room or 0 (NULL), in which case
+//  the caller allocates from the heap
+// notes: an empty list is refilled with HEAP_CACHE_BATCH blocks under one
+//  lock.  Blocks the heap hands back with a different room, it does not
+//  split off less than HEAP_MIN_ROOM, go on their own list.
+static void* cacheGet(long room){
+  heap_cache_t* cache = threadCache();
+  long* block;
+  long count;
+  if(cache->counts[room] == 0){
+    HEAP_LOCK();
+    for(count = 0; count < HEAP_CACHE_BATCH; count++){
+      long* pointer = (long*)Heap_MallocIn(&DefaultHeap, room * sizeof(long));
+      long blockRoomFound;
+      if(pointer == 0){
+        break;
+      }
+      block = pointer - 1;
+      blockRoomFound = blockRoom(block);
+      if(blockRoomFound > HEAP_CACHE_ROOMS ||
+         cache->counts[blockRoomFound] >= HEAP_CACHE_DEPTH){
+        Heap_FreeIn(&DefaultHeap, pointer);
+        break;
+      }
+      HEAP_NEXT_CACHED(block) = cache->blocks[blockRoomFound];
+      HEAP_CACHE_TAG(block) = HEAP_CACHE_MARK(cache);
+      cache->blocks[blockRoomFound] = block;
+      cache->counts[blockRoomFound]++;
+    }
+    HEAP_UNLOCK();
+    if(cache->counts[room] == 0){
+      return 0; // NULL
+    }
+  }
+  block = cache->blocks[room];
+  cache->blocks[room] = HEAP_NEXT_CACHED(block);
+  cache->counts[room]--;
+  HEAP_CACHE_TAG(block) = 0;
+  return block + 1;
+}
+
+
+// cachePut
+// input: pointer: block given to Heap_Free
+// output: 1 if the block was cached, 0 if the heap must free it, -1 if it
+//  is in a cache already (a double free)
+// notes: only well formed used blocks of the default heap are cached,
+//  anything else goes to Heap_FreeIn to be reported.  A full list gives
+//  half of its blocks back to the heap first.  A cached block stays marked
+//  used, its tag word is what tells it from an allocated one.
+static long cachePut(void* pointer){
+  long* block = (long*)pointer - 1;
+  heap_cache_t* cache;
+  long room;
+  if(!inHeapRange(&DefaultHeap, block) || blockUnused(block)){
+    return 0;
+  }
+  room = blockRoom(block);
+  if(room > HEAP_CACHE_ROOMS || block + room + 1 >= DefaultHeap.end ||
+     *blockTrailer(block) != room){
+    return 0;
+  }
+  cache = threadCache();
+  if(HEAP_CACHE_TAG(block) == HEAP_CACHE_MARK(cache)){
+    return -1;
+  }
+  if(cache->counts[room] >= HEAP_CACHE_DEPTH){
+    cacheRelease(cache, room, HEAP_CACHE_DEPTH / 2);
+  }
+  HEAP_NEXT_CACHED(block) = cache->blocks[room];
+  HEAP_CACHE_TAG(block) = HEAP_CACHE_MARK(cache);
+  cache->blocks[room] = block;
+  cache->counts[room]++;
+  return 1;
+}
+
+
+// cacheRelease
+// input:
+//  cache: a thread's cache
+//  room: which list
+//  count: how many blocks to give back to the heap
+// output: none
+static void cacheRelease(heap_cache_t* cache, long room, long count){
+  long* block;
+  if(count == 0 || cache->generation !=
+     __atomic_load_n(&HeapGeneration, __ATOMIC_ACQUIRE)){
+    return;
+  }
+  HEAP_LOCK();
+  while(count-- > 0 && cache->blocks[room]){
+    block = cache->blocks[room];
+    cache->blocks[room] = HEAP_NEXT_CACHED(block);
+    cache->counts[room]--;
+    HEAP_CACHE_TAG(block) = 0;
+    Heap_FreeIn(&DefaultHeap, block + 1);
+  }
+  HEAP_UNLOCK();
+}
+#endif
+
+
+#ifdef HEAP_TRACE
+// traceRecord
+// input:
+//  op: HEAP_TRACE_MALLOC, HEAP_TRACE_FREE or HEAP_TRACE_REALLOC
+//  block: block given to free or realloc
+//  size: size given to malloc or realloc
+//  newBlock: block returned by malloc or realloc
+// output: none
+// notes: a record that does not fit ends the trace
+static void traceRecord(long op, void* block, long size, void* newBlock){
+  unsigned char record[1 + 3 * (sizeof(unsigned long) * 8 / 7 + 1)];
+  unsigned long fields[3];
+  long fieldCount = 0;
+  long length = 0;
+  long i;
+  if(HeapTraceBytes == HEAP_TRACE_BYTES){
+    return;
+  }
+  if(op != HEAP_TRACE_MALLOC){
+    fields[fieldCount++] = block ? (long*)block - DefaultHeap.start : 0;
+  }
+  if(op != HEAP_TRACE_FREE){
+    fields[fieldCount++] = (unsigned long)size;
+    fields[fieldCount++] = newBlock ? (long*)newBlock - DefaultHeap.start : 0;
+  }
+  record[length++] = (unsigned char)op;
+  for(i = 0; i < fieldCount; i++){
+    unsigned long value = fields[i];
+    do{
+      record[length] = value & 0x7f;
+      value >>= 7;
+      if(value){
+        record[length] |= 0x80;
+      }
+      length++;
+    } while(value);
+  }
+  if(HeapTraceBytes + length > HEAP_TRACE_BYTES){
+    HeapTraceBytes = HEAP_TRACE_BYTES; // full, stop recording
+    return;
+  }
+  memcpy(HeapTrace + HeapTraceBytes, record, length);
+  HeapTraceBytes += length;
+}
+#endif
+
+
+// handleSlot
+// input: a handle
+// output: its master pointer or NULL if the handle is out of range or free
+static heap_handle_slot_t* handleSlot(heap_t* heap, heap_handle_t handle){
+  if(handle <= 0 || handle > HEAP_HANDLE_COUNT || heap->handles[handle - 1].block == 0){
+    return 0; //NULL
+  }
+  return &heap->handles[handle - 1];
+}
+
+
+// blockMovable
+// input: header of a block
+// output: whether it is an unlocked handle block
+// notes: a plain block can hold any value in its first word, but only a
+//  handle block is pointed at by the master pointer that word names
+static long blockMovable(heap_t* heap, long* blockStart){
+  long index;
+  if(blockUnused(blockStart)){
+    return 0;
+  }
+  index = blockStart[1];
+  return index >= 0 && index < HEAP_HANDLE_COUNT &&
+         heap->handles[index].block == blockStart &&
+         heap->handles[index].locks == 0;
+}
+
+
+// slideBlockDown
+// input: header of an unused block followed by a movable block
+// output: header of the unused block, now above the moved block and
+//  merged with the next block if that one is unused
+// notes: the two blocks swap places, the room of each is unchanged
+static long* slideBlockDown(heap_t* heap, long* freeStart){
+  long freeRoom = blockRoom(freeStart);
+  long* usedStart = nextBlockHeader(freeStart);
+  long usedRoom = blockRoom(usedStart);
+  long* newFreeStart = freeStart + usedRoom + 2;
+  long* following;
+  removeFreeBlock(heap, freeStart);
+  memmove(freeStart, usedStart, (usedRoom + 2) * sizeof(long));
+  heap->handles[freeStart[1]].block = freeStart;
+  *newFreeStart = -freeRoom;
+  *blockTrailer(newFreeStart) = -freeRoom;
+  // headers stay headers, just at each other's old place
+  if(heap->rover == freeStart){
+    heap->rover = newFreeStart;
+  }
+  else if(heap->rover == usedStart){
+    heap->rover = freeStart;
+  }
+  if(heap->checkCursor == freeStart){
+    heap->checkCursor = newFreeStart;
+  }
+  else if(heap->checkCursor == usedStart){
+    heap->checkCursor = freeStart;
+  }
+  following = nextBlockHeader(newFreeStart);
+  if(inHeapRange(heap, following) && blockUnused(following)){
+    removeFreeBlock(heap, following);
+    mergeBlockWithBelow(heap, newFreeStart);
+  }
+  insertFreeBlock(heap, newFreeStart);
+  return newFreeStart;
+}
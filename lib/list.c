@@ -5,16 +5,19 @@
 ==============================================================================*/
 #include "precompile.h"
 #include "heap.h"
+#include "allocator.h"
+#include "pool.h"
 #include "list.h"
 /**=============================================================================
  Interface:  slist
 
  Purpose:    slist is a singlar linked list that uses the custom static
-             heap manager.
+             heap manager.  Each node is one allocation, the element is
+             stored inline after the link.
 ==============================================================================*/
 typedef struct snode {
         struct snode * next;
-        genptr data;
+        unsigned char data[];   /* payload inline, datasize bytes */
 }snode;
 
 typedef snode* snodeptr;
@@ -22,7 +25,19 @@ typedef snode* snodeptr;
 struct slist {
         snodeptr head;
         size_t datasize;
+        allocator al;
 };
+/* one allocation per element, the payload follows the link */
+static snodeptr snode_new(slistptr pl)
+{
+        snodeptr n = allocator_alloc(&pl->al, slist_node_size(pl->datasize));
+        assert(n);
+        return n;
+}
+static void snode_delete(slistptr pl, snodeptr n)
+{
+        allocator_free(&pl->al, n);
+}
 /**=============================================================================
  Function:   slist_alloc
 
@@ -37,12 +52,59 @@ Example:     slistptr pl = list_alloc(sizeof(int));
 ==============================================================================*/
 slistptr slist_alloc(const size_t datasize)
 {
-        slistptr pl = Heap_Malloc(sizeof(slist));
+        return slist_alloc_with(datasize, NULL);
+}
+/**=============================================================================
+ Function:   slist_alloc_pool
+
+ Purpose:    Same as slist_alloc, but nodes come from a fixed size pool so
+             pushing and popping never touches the general heap.
+
+ Parameters: datasize: size in bytes of each element
+             pool: pool whose objects are at least slist_node_size(datasize)
+             bytes, or NULL to use the heap.
+
+Returns:     Opaque slist interface pointer (Pimpl idiom).
+
+Example:     poolptr pp = pool_alloc(slist_node_size(sizeof(int)), 64);
+             slistptr pl = slist_alloc_pool(sizeof(int), pp);
+==============================================================================*/
+slistptr slist_alloc_pool(const size_t datasize, poolptr pool)
+{
+        assert(pool == NULL || pool_objsize(pool) >= slist_node_size(datasize));
+        if(pool == NULL)
+                return slist_alloc_with(datasize, NULL);
+        allocator al = pool_allocator(pool);
+        return slist_alloc_with(datasize, &al);
+}
+/**=============================================================================
+ Function:   slist_alloc_with
+
+ Purpose:    Same as slist_alloc, but the descriptor and every node come from
+             the given allocator instead of the custom static heap manager.
+
+ Parameters: datasize: size in bytes of each element
+             al: allocator, copied into the slist, or NULL for heap_allocator.
+
+Returns:     Opaque slist interface pointer (Pimpl idiom).
+
+Example:     allocator al = pool_allocator(pp);
+             slistptr pl = slist_alloc_with(sizeof(int), &al);
+==============================================================================*/
+slistptr slist_alloc_with(const size_t datasize, const allocator *al)
+{
+        allocator a = allocator_or_default(al);
+        slistptr pl = allocator_alloc(&a, sizeof(slist));
         assert(pl);
         pl->head = NULL;
         pl->datasize = datasize;
+        pl->al = a;
         return pl;
 }
+size_t slist_node_size(const size_t datasize)
+{
+        return offsetof(snode, data) + datasize;
+}
 /**=============================================================================
  Function:   slist_push
 
@@ -58,11 +120,8 @@ slistptr slist_alloc(const size_t datasize)
 void slist_push(slistptr pl, const genptr data)
 {
         assert(pl && data);
-        snodeptr n = Heap_Malloc(sizeof(snode));
-        assert(n);
+        snodeptr n = snode_new(pl);
         n->next = NULL;
-        n->data = Heap_Malloc(pl->datasize);
-        assert(n->data);
         memcpy(n->data, data, pl->datasize);
         
         if(pl->head == NULL) 
@@ -76,14 +135,17 @@ void slist_free(slistptr pl)
 {
         assert(pl);
         snodeptr p = pl->head;
+        allocator a = pl->al;
+        allocator_gather g;
+        allocator_gather_init(&g, &a);
         
         while(p) {
                 snodeptr del = p;
                 p = p->next;      
-                Heap_Free(del->data);
-                Heap_Free(del);
+                allocator_gather_add(&g, del);
         }
-        Heap_Free(pl);
+        allocator_gather_add(&g, pl);
+        allocator_gather_flush(&g);
         pl = NULL;
 }
 /**=============================================================================
@@ -114,8 +176,7 @@ void slist_pop(slistptr pl)
         if(p) {
                 del = p;
                 p = p->next;
-                Heap_Free(del->data);
-                Heap_Free(del);
+                snode_delete(pl, del);
                 del = NULL;
         }
         pl->head = p;
@@ -8,6 +8,7 @@
 #include "functor.h"
 #include "algo.h"
 #include "heap.h"
+#include "allocator.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
@@ -27,6 +28,7 @@ struct polyarray {
 	bool (*lessthan)(const genptr, const genptr);
 	void (*swap)(genptr, genptr);
 	void (*print)(const genptr);
+	allocator al;
 };
 /**=============================================================================
  Function:   poly_alloc
@@ -47,9 +49,37 @@ polyptr poly_alloc(const size_t capacity, const size_t datasize,
 		   void(*swap)(genptr, genptr),
 		   void(*print)(const genptr))
 {
-	polyptr p = Heap_Malloc(sizeof(polyarray));
+	return poly_alloc_with(capacity, datasize, cmp, lessthan, swap, print,
+			       NULL);
+}
+/**=============================================================================
+ Function:   poly_alloc_with
+
+ Purpose:    Same as poly_alloc, but the descriptor and the element buffer
+             come from the given allocator instead of the custom static heap
+	     manager.
+
+ Parameters: same as poly_alloc, plus
+	     al: allocator, copied into the array, or NULL for heap_allocator.
+
+Returns:     Opaque array interface pointer (Pimpl idiom).
+
+Example:     allocator al = pool_allocator(pp);
+             polyptr pa = poly_alloc_with(100, sizeof(int), int_cmp,
+				          int_lt, int_swap, int_print, &al);
+==============================================================================*/
+polyptr poly_alloc_with(const size_t capacity, const size_t datasize,
+			int (*cmp)(const genptr, const genptr),
+			bool(*lessthan)(const genptr, const genptr),
+			void(*swap)(genptr, genptr),
+			void(*print)(const genptr),
+			const allocator *al)
+{
+	allocator a = allocator_or_default(al);
+	polyptr p = allocator_alloc(&a, sizeof(polyarray));
 	assert(p);
-	p->base = Heap_Malloc(capacity * datasize);
+	p->base = allocator_alloc(&a, capacity * datasize);
+	assert(p->base);
 	p->cap = capacity;
 	p->datasize = datasize;
 	p->count = 0;
@@ -57,6 +87,7 @@ polyptr poly_alloc(const size_t capacity, const size_t datasize,
 	p->lessthan = lessthan;
 	p->swap = swap;
 	p->print = print;
+	p->al = a;
 
 	return p;
 }
@@ -86,8 +117,9 @@ void poly_add(polyptr pa, const genptr data, const size_t count)
 void poly_free(polyptr pa)
 {
 	assert(pa);
-	Heap_Free(pa->base);
-	Heap_Free(pa);
+	allocator a = pa->al;
+	allocator_free(&a, pa->base);
+	allocator_free(&a, pa);
 	pa=NULL;
 }
 
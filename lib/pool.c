@@ -0,0 +1,228 @@
+/*==============================================================================
+ Name        : pool.c
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#include "precompile.h"
+#include "heap.h"
+#include "allocator.h"
+#include "pool.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+/**=============================================================================
+ Interface:  pool
+
+ Purpose:    pool hands out fixed size objects from one slab, either carved
+             from the custom static heap manager or attached to a caller
+	     buffer.  Freed objects are kept on an intrusive free list (the
+	     link lives in the object itself), so get and put are O(1) and
+	     have no per object header.  The slab is carved lazily, the
+	     constructor does not touch every object.
+==============================================================================*/
+typedef struct freeobj {
+	struct freeobj *next;
+} freeobj;
+
+struct pool {
+	genptr base;
+	genptr end;
+	genptr carve;
+	freeobj *freelist;
+	size_t objsize;
+	size_t available;
+	bool attached;
+};
+
+/* objects must hold the free list link and keep it aligned */
+static size_t pool_roundup(const size_t objsize)
+{
+	size_t align = sizeof(long);
+	size_t sz = (objsize < sizeof(freeobj)) ? sizeof(freeobj) : objsize;
+	return (sz + align - 1) & ~(align - 1);
+}
+static void pool_init(poolptr pp, const genptr base, const size_t bytes,
+		      const size_t objsize)
+{
+	pp->objsize = pool_roundup(objsize);
+	pp->available = bytes / pp->objsize;
+	pp->base = base;
+	pp->end = base + (pp->available * pp->objsize);
+	pp->carve = base;
+	pp->freelist = NULL;
+}
+/**=============================================================================
+ Function:   pool_alloc
+
+ Purpose:    Allocates one slab from the custom static heap manager big
+             enough for capacity objects and returns an opaque interface
+	     pointer to the pool class.
+
+ Parameters: objsize: size in bytes of each object.
+	     capacity: how many objects the pool holds.
+
+Returns:     Opaque pool interface pointer (Pimpl idiom).
+
+Example:     poolptr pp = pool_alloc(slist_node_size(sizeof(int)), 100);
+==============================================================================*/
+poolptr pool_alloc(const size_t objsize, const size_t capacity)
+{
+	assert(objsize && capacity);
+	poolptr pp = Heap_Malloc(sizeof(pool));
+	assert(pp);
+	size_t bytes = pool_roundup(objsize) * capacity;
+	genptr base = Heap_Malloc(bytes);
+	assert(base);
+	pool_init(pp, base, bytes, objsize);
+	pp->attached = false;
+	return pp;
+}
+/**=============================================================================
+ Function:   pool_attach
+
+ Purpose:    Same as pool_alloc but the objects come from a caller owned
+             buffer, e.g. a static array, so the heap only holds the pool
+	     descriptor.
+
+ Parameters: base: buffer aligned for a long.
+	     bytes: size of the buffer in bytes.
+	     objsize: size in bytes of each object.
+
+Returns:     Opaque pool interface pointer (Pimpl idiom).
+
+Example:     static long buf[256];
+             poolptr pp = pool_attach(buf, sizeof(buf), 12);
+==============================================================================*/
+poolptr pool_attach(const genptr base, const size_t bytes, const size_t objsize)
+{
+	assert(base && objsize);
+	poolptr pp = Heap_Malloc(sizeof(pool));
+	assert(pp);
+	pool_init(pp, base, bytes, objsize);
+	pp->attached = true;
+	return pp;
+}
+void pool_free(poolptr pp)
+{
+	assert(pp && !pp->attached);
+	Heap_Free(pp->base);
+	Heap_Free(pp);
+	pp = NULL;
+}
+void pool_detach(poolptr pp)
+{
+	assert(pp && pp->attached);
+	Heap_Free(pp);
+	pp = NULL;
+}
+/**=============================================================================
+ Functions:  pool_get, pool_put
+
+ Purpose:    pool_get pops the free list or carves the next untouched object
+             from the slab.  pool_put pushes an object back on the free list.
+
+ Parameters: pp: pool interface pointer
+             obj: object previously returned by pool_get on the same pool
+
+Returns:     pool_get returns the object or NULL if the pool is exhausted.
+
+Example:     snode *n = pool_get(pp);
+             pool_put(pp, n);
+==============================================================================*/
+genptr pool_get(poolptr pp)
+{
+	assert(pp);
+	genptr obj = NULL;
+	if (pp->freelist) {
+		obj = pp->freelist;
+		pp->freelist = pp->freelist->next;
+	} else if (pp->carve < pp->end) {
+		obj = pp->carve;
+		pp->carve += pp->objsize;
+	} else {
+		return NULL;
+	}
+	pp->available--;
+	return obj;
+}
+void pool_put(poolptr pp, genptr obj)
+{
+	assert(pp && pool_owns(pp, obj));
+	freeobj *f = obj;
+	f->next = pp->freelist;
+	pp->freelist = f;
+	pp->available++;
+}
+bool pool_owns(const poolptr pp, const genptr obj)
+{
+	assert(pp);
+	return obj >= pp->base && obj < pp->end &&
+	       ((obj - pp->base) % pp->objsize) == 0;
+}
+size_t pool_objsize(const poolptr pp)
+{
+	assert(pp);
+	return pp->objsize;
+}
+size_t pool_available(const poolptr pp)
+{
+	assert(pp);
+	return pp->available;
+}
+/**=============================================================================
+ Function:   pool_allocator
+
+ Purpose:    Returns an allocator on the pool for the _with constructors.
+             Requests up to the object size come from the pool, anything
+	     bigger (a container descriptor or buffer) falls back to the
+	     custom static heap manager, free tells the two apart with
+	     pool_owns.  A full pool returns NULL, it does not spill.
+
+ Parameters: pp: pool interface pointer, must outlive the containers
+
+Returns:     allocator value, copy it or pass its address to a constructor.
+
+Example:     poolptr pp = pool_alloc(slist_node_size(sizeof(int)), 64);
+             allocator al = pool_allocator(pp);
+             slistptr pl = slist_alloc_with(sizeof(int), &al);
+==============================================================================*/
+static genptr pool_alloc_fn(genptr ctx, const size_t bytes)
+{
+	poolptr pp = ctx;
+	return bytes <= pp->objsize ? pool_get(pp) : Heap_Malloc((long)bytes);
+}
+static void pool_free_fn(genptr ctx, genptr p)
+{
+	poolptr pp = ctx;
+	if (pool_owns(pp, p))
+		pool_put(pp, p);
+	else
+		Heap_Free(p);
+}
+static genptr pool_realloc_fn(genptr ctx, genptr p, const size_t bytes)
+{
+	poolptr pp = ctx;
+	if (p == NULL)
+		return pool_alloc_fn(pp, bytes);
+	if (!pool_owns(pp, p))
+		return Heap_Realloc(p, (long)bytes);
+	if (bytes <= pp->objsize)
+		return p;
+
+	genptr n = Heap_Malloc((long)bytes);
+	if (n) {
+		memcpy(n, p, pp->objsize);
+		pool_put(pp, p);
+	}
+	return n;
+}
+allocator pool_allocator(poolptr pp)
+{
+	assert(pp);
+	allocator al = {
+		pool_alloc_fn, pool_free_fn, pool_realloc_fn, pp, NULL, NULL
+	};
+	return al;
+}
+#pragma GCC diagnostic pop
@@ -0,0 +1,210 @@
+/*==============================================================================
+ Name        : rng.c
+ Author      : Stephen MacKenzie
+ Copyright   : Licensed under GPL version 2 (GPLv2)
+==============================================================================*/
+#include "precompile.h"
+#include "rng.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+/**=============================================================================
+ Function:   rng_seed
+
+ Purpose:    Seeds an xoshiro128** generator from one 64 bit number, which
+             splitmix64 spreads over the 128 bit state, so nearby seeds such
+	     as thread ids still give unrelated sequences.  The same seed
+	     always gives the same sequence on the board and on a host.
+
+ Parameters: r: generator, any storage.
+	     seed: any value, 0 included.
+
+Returns:     void
+
+Example:     rng r;
+	     rng_seed(&r, 1234567);
+	     uint32_t die = rng_range(&r, 6) + 1;
+==============================================================================*/
+void rng_seed(rng *r, uint64_t seed)
+{
+	assert(r);
+	for (int i = 0; i < 4; i += 2) {
+		uint64_t z = rng_splitmix64(&seed);
+		r->s[i] = (uint32_t)z;
+		r->s[i + 1] = (uint32_t)(z >> 32);
+	}
+	/* an all zero state never leaves zero */
+	if ((r->s[0] | r->s[1] | r->s[2] | r->s[3]) == 0)
+		r->s[0] = 1;
+}
+static void rng_jump_by(rng *r, const uint32_t *poly)
+{
+	uint32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	for (int i = 0; i < 4; i++)
+		for (int b = 0; b < 32; b++) {
+			if (poly[i] & (1u << b)) {
+				s0 ^= r->s[0];
+				s1 ^= r->s[1];
+				s2 ^= r->s[2];
+				s3 ^= r->s[3];
+			}
+			rng_u32(r);
+		}
+	r->s[0] = s0;
+	r->s[1] = s1;
+	r->s[2] = s2;
+	r->s[3] = s3;
+}
+/**=============================================================================
+ Functions:  rng_jump, rng_long_jump
+
+ Purpose:    Moves a generator 2^64 (rng_jump) or 2^96 (rng_long_jump)
+             draws ahead in 128 steps.  Seed one generator, copy it for
+	     each thread and jump every copy one more time than the last:
+	     the threads then draw from 2^64 long slices of one sequence that
+	     cannot overlap, and a rerun gives each thread the same numbers.
+	     rng_long_jump spaces out groups of those, e.g. per process.
+
+ Parameters: r: seeded generator.
+
+Returns:     void
+
+Example:     rng streams[4];
+	     rng_seed(&streams[0], 42);
+	     for (int i = 1; i < 4; i++) {
+		     streams[i] = streams[i - 1];
+		     rng_jump(&streams[i]);
+	     }
+==============================================================================*/
+void rng_jump(rng *r)
+{
+	static const uint32_t poly[] = {0x8764000b, 0xf542d2d3, 0x6fa035c3,
+					0x77f2db5b};
+	assert(r);
+	rng_jump_by(r, poly);
+}
+void rng_long_jump(rng *r)
+{
+	static const uint32_t poly[] = {0xb523952e, 0x0b6f099f, 0xccf5a0ef,
+					0x1c580662};
+	assert(r);
+	rng_jump_by(r, poly);
+}
+/**=============================================================================
+ Functions:  rng_pcg32_seed, rng_pcg32_advance
+
+ Purpose:    PCG32 keeps 64 bits of state and a stream: the LCG increment,
+             one of 2^63, so the stream number alone (a thread id) gives
+	     each thread a different sequence.  rng_pcg32_advance skips delta
+	     draws, forwards only, in log2(delta) steps by squaring the LCG,
+	     e.g. to hand out consecutive slices of one stream.
+
+ Parameters: r: generator, any storage.
+	     seed: initial state, any value.
+	     stream: sequence selector, any value, only the low 63 bits count.
+	     delta: draws to skip.
+
+Returns:     void
+
+Example:     rng_pcg32 r;
+	     rng_pcg32_seed(&r, 42, thread_id);
+	     uint32_t bin = rng_pcg32_range(&r, 16);
+==============================================================================*/
+void rng_pcg32_seed(rng_pcg32 *r, uint64_t seed, uint64_t stream)
+{
+	assert(r);
+	r->state = 0;
+	r->inc = (stream << 1) | 1;
+	rng_pcg32_u32(r);
+	r->state += seed;
+	rng_pcg32_u32(r);
+}
+void rng_pcg32_advance(rng_pcg32 *r, uint64_t delta)
+{
+	assert(r);
+	uint64_t mult = 6364136223846793005ull, plus = r->inc;
+	uint64_t acc_mult = 1, acc_plus = 0;
+	for (; delta; delta >>= 1) {
+		if (delta & 1) {
+			acc_mult *= mult;
+			acc_plus = acc_plus * mult + plus;
+		}
+		plus = (mult + 1) * plus;
+		mult *= mult;
+	}
+	r->state = acc_mult * r->state + acc_plus;
+}
+/**=============================================================================
+ Functions:  rng_fill_u32, rng_fill_range, rng_fill_float
+
+ Purpose:    Fill a buffer from one generator.  The state is copied into
+             locals for the whole loop and written back once, so there is no
+	     call and no load and store of the state per element, which is
+	     what modify with rand_int costs.  Same numbers, in the same
+	     order, as calling rng_u32, rng_range or rng_float count times.
+
+ Parameters: r: seeded generator, left where count single draws would.
+	     dest: count elements.
+	     n: rng_fill_range only, values are in [0, n).
+
+Returns:     void
+
+Example:     static float noise[1024];
+	     rng_fill_float(rng_default(), noise, _countof(noise));
+==============================================================================*/
+void rng_fill_u32(rng *r, uint32_t *dest, const size_t count)
+{
+	assert(r && (dest || !count));
+	rng local = *r;
+	for (size_t i = 0; i < count; i++)
+		dest[i] = rng_u32(&local);
+	*r = local;
+}
+void rng_fill_range(rng *r, uint32_t *dest, const size_t count,
+		    const uint32_t n)
+{
+	assert(r && (dest || !count));
+	rng local = *r;
+	for (size_t i = 0; i < count; i++)
+		dest[i] = rng_range(&local, n);
+	*r = local;
+}
+void rng_fill_float(rng *r, float *dest, const size_t count)
+{
+	assert(r && (dest || !count));
+	rng local = *r;
+	for (size_t i = 0; i < count; i++)
+		dest[i] = rng_float(&local);
+	*r = local;
+}
+/**=============================================================================
+ Functions:  rng_default, rng_rand
+
+ Purpose:    One generator for the library, seeded with a fixed value so a
+             test run is reproducible; rng_seed(rng_default(), x) reseeds
+	     it.  rng_rand is its next 32 bits, a drop in for rand() e.g.
+	     from assembly.  Shared and unlocked: threads should own an rng.
+
+Returns:     the default generator, the next number.
+
+Example:     random_shuffle(a, _countof(a), sizeof(int), int_swap);
+==============================================================================*/
+#define RNG_DEFAULT_SEED 1234567
+
+static rng default_rng;
+static bool default_seeded;
+
+rng *rng_default(void)
+{
+	if (!default_seeded) {
+		rng_seed(&default_rng, RNG_DEFAULT_SEED);
+		default_seeded = true;
+	}
+	return &default_rng;
+}
+uint32_t rng_rand(void)
+{
+	return rng_u32(rng_default());
+}
+#pragma GCC diagnostic pop
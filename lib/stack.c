@@ -5,6 +5,8 @@
 ==============================================================================*/
 #include "precompile.h"
 #include "heap.h"
+#include "allocator.h"
+#include "pool.h"
 #include "stack.h"
 #include "list.h"
 /**=============================================================================
@@ -12,11 +14,12 @@
 
  Purpose:    stack is a LIFO pattern that internally uses a singlar linked list 
              that uses the custom static heap manager.  It uses the top/pop
-	     pattern similar to std::stack.
+	     pattern similar to std::stack.  Each node is one allocation, the
+	     element is stored inline after the link.
 ==============================================================================*/
 typedef struct stacknode {
         struct stacknode * next;
-        genptr data;
+        unsigned char data[];   /* payload inline, datasize bytes */
 }stacknode;
 
 typedef stacknode* stacknodeptr;
@@ -24,7 +27,19 @@ typedef stacknode* stacknodeptr;
 struct stack {
         stacknodeptr head;
         size_t datasize;
+        allocator al;
 };
+/* one allocation per element, the payload follows the link */
+static stacknodeptr stacknode_new(stackptr ps)
+{
+        stacknodeptr n = allocator_alloc(&ps->al, stack_node_size(ps->datasize));
+        assert(n);
+        return n;
+}
+static void stacknode_delete(stackptr ps, stacknodeptr n)
+{
+        allocator_free(&ps->al, n);
+}
 /**=============================================================================
  Function:   stack_alloc
 
@@ -39,24 +54,74 @@ struct stack {
 ==============================================================================*/
 stackptr stack_alloc(const size_t datasize)
 {
-        stackptr ps = Heap_Malloc(sizeof(stack));
+        return stack_alloc_with(datasize, NULL);
+}
+/**=============================================================================
+ Function:   stack_alloc_pool
+
+ Purpose:    Same as stack_alloc, but nodes come from a fixed size pool so
+             pushing and popping never touches the general heap.
+
+ Parameters: datasize: size in bytes of each element
+             pool: pool whose objects are at least stack_node_size(datasize)
+             bytes, or NULL to use the heap.
+
+ Returns:     Opaque stack interface pointer (Pimpl idiom).
+
+ Example:     poolptr pp = pool_alloc(stack_node_size(sizeof(int)), 64);
+              stackptr ps = stack_alloc_pool(sizeof(int), pp);
+==============================================================================*/
+stackptr stack_alloc_pool(const size_t datasize, poolptr pool)
+{
+        assert(pool == NULL || pool_objsize(pool) >= stack_node_size(datasize));
+        if(pool == NULL)
+                return stack_alloc_with(datasize, NULL);
+        allocator al = pool_allocator(pool);
+        return stack_alloc_with(datasize, &al);
+}
+/**=============================================================================
+ Function:   stack_alloc_with
+
+ Purpose:    Same as stack_alloc, but the descriptor and every node come from
+             the given allocator instead of the custom static heap manager.
+
+ Parameters: datasize: size in bytes of each element
+             al: allocator, copied into the stack, or NULL for heap_allocator.
+
+ Returns:     Opaque stack interface pointer (Pimpl idiom).
+
+ Example:     allocator al = pool_allocator(pp);
+              stackptr ps = stack_alloc_with(sizeof(int), &al);
+==============================================================================*/
+stackptr stack_alloc_with(const size_t datasize, const allocator *al)
+{
+        allocator a = allocator_or_default(al);
+        stackptr ps = allocator_alloc(&a, sizeof(stack));
         assert(ps);
         ps->head = NULL;
         ps->datasize = datasize;
+        ps->al = a;
         return ps;
 }
+size_t stack_node_size(const size_t datasize)
+{
+        return offsetof(stacknode, data) + datasize;
+}
 void stack_free(stackptr ps)
 {
         assert(ps);
         stacknodeptr p = ps->head;
+        allocator a = ps->al;
+        allocator_gather g;
+        allocator_gather_init(&g, &a);
         
         while(p) {
                 stacknodeptr del = p;
                 p = p->next;      
-                Heap_Free(del->data);
-                Heap_Free(del);
+                allocator_gather_add(&g, del);
         }
-        Heap_Free(ps);
+        allocator_gather_add(&g, ps);
+        allocator_gather_flush(&g);
         ps = NULL;
 }
 /**=============================================================================
@@ -74,11 +139,8 @@ void stack_free(stackptr ps)
 void stack_push(stackptr ps, const genptr data)
 {
         assert(ps && data);
-        stacknodeptr n = Heap_Malloc(sizeof(stacknode));
-        assert(n);
+        stacknodeptr n = stacknode_new(ps);
         n->next = NULL;
-        n->data = Heap_Malloc(ps->datasize);
-        assert(n->data);
         memcpy(n->data, data, ps->datasize);
         
         if(ps->head == NULL) 
@@ -116,8 +178,7 @@ void stack_pop(stackptr ps)
         if(p) {
                 del = p;
                 p = p->next;
-                Heap_Free(del->data);
-                Heap_Free(del);
+                stacknode_delete(ps, del);
                 del = NULL;
         }
         ps->head = p;
@@ -6,6 +6,8 @@
 #include "precompile.h"
 #include "static_tree.h"
 #include "heap.h"
+#include "allocator.h"
+#include "pool.h"
 
 
 #pragma GCC diagnostic push
@@ -29,17 +31,21 @@ struct binarytree {
 	int(*cmp)(const genptr v1, const genptr v2);
 	int count;
 	bool dupes_allowed;
+	allocator al;
 };
 
 /* private */
-nodeptr node_alloc(const genptr val, nodeptr parent);
+nodeptr node_alloc(const genptr val, nodeptr parent, const allocator *al);
+void node_free(nodeptr p, const allocator *al);
 nodeptr tree_dupes_add(nodeptr p, const genptr val, 
-	int(*cmp)(const genptr v1, const genptr v2), nodeptr parent);
+	int(*cmp)(const genptr v1, const genptr v2), nodeptr parent,
+	const allocator *al);
 
 nodeptr tree_nodupes_add(nodeptr p, const genptr val, 
-	int(*cmp)(const genptr v1, const genptr v2), nodeptr parent);
+	int(*cmp)(const genptr v1, const genptr v2), nodeptr parent,
+	const allocator *al);
 
-void tree_postorder_free(nodeptr p);
+void tree_postorder_free(nodeptr p, allocator_gather *g);
 
 nodeptr tree_inner_find(node *p, const genptr k, 
 	int(*cmp)(const genptr v1, const genptr v2));
@@ -64,21 +70,72 @@ Returns:     Opaque binarytree interface pointer (Pimpl idiom).
 Example:     treeptr pt = tree_alloc(cmp_int, true);
 ==============================================================================*/
 treeptr tree_alloc(int(*cmp)(const genptr v1, const genptr v2), bool fdupes)
+{
+	return tree_alloc_with(cmp, fdupes, NULL);
+}
+/**=============================================================================
+ Function:   tree_alloc_pool
+
+ Purpose:    Same as tree_alloc, but nodes come from a fixed size pool so
+             adding and deleting never touches the general heap.
+
+ Parameters: cmp: user provided compare function
+             fdupes: flag to indicate whether duplicates are allowed.
+	     pool: pool whose objects are at least tree_node_size() bytes,
+	     or NULL to use the heap.
+
+Returns:     Opaque binarytree interface pointer (Pimpl idiom).
+
+Example:     poolptr pp = pool_alloc(tree_node_size(), 64);
+             treeptr pt = tree_alloc_pool(cmp_int, true, pp);
+==============================================================================*/
+treeptr tree_alloc_pool(int(*cmp)(const genptr v1, const genptr v2), bool fdupes,
+			poolptr pool)
+{
+	assert(pool == NULL || pool_objsize(pool) >= tree_node_size());
+	if(pool == NULL)
+		return tree_alloc_with(cmp, fdupes, NULL);
+	allocator al = pool_allocator(pool);
+	return tree_alloc_with(cmp, fdupes, &al);
+}
+/**=============================================================================
+ Function:   tree_alloc_with
+
+ Purpose:    Same as tree_alloc, but the descriptor and every node come from
+             the given allocator instead of the custom static heap manager.
+
+ Parameters: cmp: user provided compare function
+             fdupes: flag to indicate whether duplicates are allowed.
+	     al: allocator, copied into the tree, or NULL for heap_allocator.
+
+Returns:     Opaque binarytree interface pointer (Pimpl idiom).
+
+Example:     allocator al = pool_allocator(pp);
+             treeptr pt = tree_alloc_with(cmp_int, true, &al);
+==============================================================================*/
+treeptr tree_alloc_with(int(*cmp)(const genptr v1, const genptr v2), bool fdupes,
+			const allocator *al)
 {
 	assert(cmp);
-	treeptr p = Heap_Malloc(sizeof(binarytree));
+	allocator a = allocator_or_default(al);
+	treeptr p = allocator_alloc(&a, sizeof(binarytree));
 	assert(p);
 	p->cmp = cmp;
 	p->dupes_allowed = fdupes;
 	p->root = NULL;
 	p->count = 0;
+	p->al = a;
 	return p;
 }
+size_t tree_node_size(void)
+{
+	return sizeof(node);
+}
 
-nodeptr node_alloc(const genptr val, nodeptr parent)
+nodeptr node_alloc(const genptr val, nodeptr parent, const allocator *al)
 {
 	assert(val);
-	nodeptr p = Heap_Malloc(sizeof(node));
+	nodeptr p = allocator_alloc(al, sizeof(node));
 	assert(p);
 
 	p->data = val;
@@ -88,12 +145,20 @@ nodeptr node_alloc(const genptr val, nodeptr parent)
 	p->parent = parent;
 	return p;
 }
+void node_free(nodeptr p, const allocator *al)
+{
+	allocator_free(al, p);
+}
 
 void tree_free(treeptr pt)
 {
 	assert(pt);
-        tree_postorder_free(pt->root);
-       	Heap_Free(pt);
+	allocator a = pt->al;
+	allocator_gather g;
+	allocator_gather_init(&g, &a);
+        tree_postorder_free(pt->root, &g);
+	allocator_gather_add(&g, pt);
+	allocator_gather_flush(&g);
        	pt = NULL;
 }
 /**=============================================================================
@@ -112,9 +177,11 @@ void tree_add(treeptr pt, const genptr val)
 {
 	assert(pt && val);
 	if(pt->dupes_allowed)
-		pt->root = tree_dupes_add(pt->root, val, pt->cmp, NULL);
+		pt->root = tree_dupes_add(pt->root, val, pt->cmp, NULL,
+					  &pt->al);
 	else
-		pt->root = tree_nodupes_add(pt->root, val, pt->cmp, NULL);
+		pt->root = tree_nodupes_add(pt->root, val, pt->cmp, NULL,
+					    &pt->al);
 
 	pt->count++;
 }
@@ -163,31 +230,33 @@ void tree_visit(treeptr pt, enum traverse_order order, void (*vis)(const genptr)
 }
 
 nodeptr tree_nodupes_add(nodeptr p, const genptr val, 
-	int(*cmp)(const genptr v1, const genptr v2), nodeptr parent)
+	int(*cmp)(const genptr v1, const genptr v2), nodeptr parent,
+	const allocator *al)
 {
 	assert(val && cmp);
 	int cond=0;
 	if(p == NULL) 
-		p = node_alloc(val, parent);
+		p = node_alloc(val, parent, al);
 	else if((cond = cmp(val, p->data)) < 0)
-		p->left = tree_nodupes_add(p->left, val, cmp, p);
+		p->left = tree_nodupes_add(p->left, val, cmp, p, al);
 	else if( cond > 0)
-		p->right = tree_nodupes_add(p->right, val, cmp, p);
+		p->right = tree_nodupes_add(p->right, val, cmp, p, al);
 	else
 		p->count++;
 		
 	return p;
 }
 nodeptr tree_dupes_add(nodeptr p, const genptr val, 
-	int(*cmp)(const genptr v1, const genptr v2), nodeptr parent)
+	int(*cmp)(const genptr v1, const genptr v2), nodeptr parent,
+	const allocator *al)
 {
 	assert(val && cmp);
 	if(p == NULL) 
-		p = node_alloc(val, parent);
+		p = node_alloc(val, parent, al);
 	else if(cmp(val, p->data) < 0)
-		p->left = tree_dupes_add(p->left, val, cmp, p);
+		p->left = tree_dupes_add(p->left, val, cmp, p, al);
 	else 
-		p->right = tree_dupes_add(p->right, val, cmp, p);
+		p->right = tree_dupes_add(p->right, val, cmp, p, al);
 		
 	return p;
 }
@@ -218,12 +287,12 @@ void tree_postorder_visit(nodeptr p, void(*vis)(const genptr))
 		vis(p->data);
 	}
 }
-void tree_postorder_free(nodeptr p)
+void tree_postorder_free(nodeptr p, allocator_gather *g)
 {
 	if(p) {
-		tree_postorder_free(p->left);
-		tree_postorder_free(p->right);
-		Heap_Free(p);
+		tree_postorder_free(p->left, g);
+		tree_postorder_free(p->right, g);
+		allocator_gather_add(g, p);
 		p = NULL;
 	}
 }
@@ -293,7 +362,7 @@ void tree_delete_node(treeptr pt, const genptr k)
 		else
 			parent->right = x->left;
 
-	Heap_Free(x);
+	node_free(x, &pt->al);
 	x = NULL;
 }
 
@@ -22,10 +22,25 @@ ADDITIONAL_LINKER_INPUTS +=
 MACOS_FRAMEWORKS += 
 LINUX_PACKAGES += 
 
-CFLAGS += -ggdb -DSTM32F401xx -std=c17 -DHEAP_SIZE_BYTES=8088
+#The default heap takes the SRAM between .bss and the stack reserve, see
+#heap.h.  A test that needs a known heap size sets HEAP_SIZE_BYTES before
+#including this file to get the fixed static array instead.  newlib's
+#_sbrk is wrapped so its malloc stops where the default heap starts; the
+#wrapper is in heap.c, so a test that does not link heap.c sets NO_HEAP.
+HEAP_STACK_RESERVE ?= 8192
+ifdef HEAP_SIZE_BYTES
+HEAP_FLAGS := -DHEAP_SIZE_BYTES=$(HEAP_SIZE_BYTES)
+else ifdef NO_HEAP
+HEAP_FLAGS :=
+else
+HEAP_FLAGS := -DHEAP_LINKER_REGION -DHEAP_STACK_RESERVE=$(HEAP_STACK_RESERVE)
+HEAP_LDFLAGS := -Wl,--wrap=_sbrk
+endif
+
+CFLAGS += -ggdb -DSTM32F401xx -std=c17 $(HEAP_FLAGS)
 CXXFLAGS += -ggdb -DSTM32F401xx -std=c++20 
 ASFLAGS += -mfpu=fpv4-sp-d16 -ggdb -DSTM32F401xx
-LDFLAGS += -u _printf_float -specs=rdimon.specs 
+LDFLAGS += -u _printf_float -specs=rdimon.specs $(HEAP_LDFLAGS)
 COMMONFLAGS += -mcpu=cortex-m4 -mthumb -mfloat-abi=soft
 LINKER_SCRIPT := $(BSP_ROOT)/STM32F4xxxx/LinkerScripts/STM32F401RE_flash.lds
 
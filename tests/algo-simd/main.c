@@ -0,0 +1,243 @@
+#include "precompile.h"
+#include "harness.h"
+#include "bench.h"
+#include "algo.h"
+#include "functor.h"
+#include "heap.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+#define CHECK_MAX 100
+#define BENCH_COUNT (1 << 20)
+#define BENCH_ROUNDS 4
+
+#ifndef NL
+#define NL printf("\n")
+#endif
+
+// test data
+static const char *level_names[] = {"scalar", "sse2", "avx2"};
+static int ibuf[BENCH_COUNT];
+static int ibuf2[BENCH_COUNT];
+static float fbuf[BENCH_COUNT];
+static float fbuf2[BENCH_COUNT];
+
+// test helper
+void dummy();
+static bool is_zero(const int *v)
+{
+	return *v == 0;
+}
+static void fill_ints(int *a, const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		a[i] = rand() % 16 - 8;
+}
+static void fill_floats(float *a, const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		a[i] = (float)(rand() % 2001 - 1000) / 8.0f;
+}
+
+// test functions
+void simd_int_test();
+void simd_float_test();
+void simd_bench();
+
+int main()
+{
+	PROJECT_BANNER("ALGO SIMD, int and float kernels at every level");
+	Heap_Init();
+	bench_init();
+	simd_level best = simd_select(SIMD_AVX2);
+	printf("best level: %s\n", level_names[best]);
+	for (int lvl = SIMD_SCALAR; lvl <= best; lvl++) {
+		VERIFY(simd_select(lvl) == lvl);
+		printf("level: %s\n", level_names[lvl]);
+		simd_int_test();
+		simd_float_test();
+	}
+	simd_select(SIMD_AVX2);
+	simd_bench();
+	REPORT("host Algo-SIMD");
+	dummy();
+}
+
+/*-----------------------------------------------------------------------------
+Test functions and data
+-----------------------------------------------------------------------------*/
+void dummy()
+{
+}
+/* every length up to CHECK_MAX so each tail is covered, against plain loops
+   and the callback versions */
+void simd_int_test()
+{
+	TC_BEGIN(__func__);
+	bool ok = true;
+	for (size_t n = 0; n <= CHECK_MAX; n++) {
+		fill_ints(ibuf, n);
+		size_t zeros = 0;
+		unsigned sum = 0;
+		int lo = INT_MAX, hi = INT_MIN;
+		for (size_t i = 0; i < n; i++) {
+			zeros += ibuf[i] == 0;
+			sum += (unsigned)ibuf[i];
+			lo = ibuf[i] < lo ? ibuf[i] : lo;
+			hi = ibuf[i] > hi ? ibuf[i] : hi;
+		}
+		ok = ok && count_if_int_eq(ibuf, n, 0) == zeros &&
+		     zeros == count_if(ibuf, n, sizeof(int), is_zero);
+		ok = ok && accumulate_int(ibuf, n) == (int)sum;
+		if (n) {
+			ok = ok && min_int(ibuf, n) == lo;
+			ok = ok && max_int(ibuf, n) == hi;
+		}
+
+		memcpy(ibuf2, ibuf, n * sizeof(int));
+		ok = ok && equal_int(ibuf, ibuf2, n);
+		if (n) {
+			ibuf2[n - 1 - rand() % n] ^= 0x100;
+			ok = ok && !equal_int(ibuf, ibuf2, n);
+		}
+
+		memcpy(ibuf2, ibuf, n * sizeof(int));
+		int oldval = 3, newval = 99;
+		replace_int(ibuf, n, oldval, newval);
+		replace(ibuf2, &oldval, &newval, n, sizeof(int), int_cmp);
+		ok = ok && equal_int(ibuf, ibuf2, n);
+
+		reverse_int(ibuf, n);
+		reverse(ibuf2, n, sizeof(int), int_swap);
+		ok = ok && equal_int(ibuf, ibuf2, n);
+	}
+	VERIFY(ok);
+
+	int big[] = {INT_MAX, 1, INT_MIN, -1, INT_MAX, INT_MAX, 7, 8, 9};
+	VERIFY(min_int(big, _countof(big)) == INT_MIN);
+	VERIFY(max_int(big, _countof(big)) == INT_MAX);
+	unsigned wrap = 0;
+	for (size_t i = 0; i < _countof(big); i++)
+		wrap += (unsigned)big[i];
+	VERIFY(accumulate_int(big, _countof(big)) == (int)wrap);
+	PASSED(__func__, __LINE__);
+}
+void simd_float_test()
+{
+	TC_BEGIN(__func__);
+	bool ok = true;
+	for (size_t n = 0; n <= CHECK_MAX; n++) {
+		fill_floats(fbuf, n);
+		/* eighths up to 125 add exactly in any order */
+		float sum = 0.0f, lo = INFINITY, hi = -INFINITY;
+		for (size_t i = 0; i < n; i++) {
+			sum += fbuf[i];
+			lo = fbuf[i] < lo ? fbuf[i] : lo;
+			hi = fbuf[i] > hi ? fbuf[i] : hi;
+		}
+		ok = ok && accumulate_float(fbuf, n) == sum;
+		if (n) {
+			ok = ok && min_float(fbuf, n) == lo;
+			ok = ok && max_float(fbuf, n) == hi;
+		}
+
+		memcpy(fbuf2, fbuf, n * sizeof(float));
+		ok = ok && equal_float(fbuf, fbuf2, n);
+		if (n) {
+			size_t k = rand() % n;
+			fbuf2[k] = fbuf2[k] == 0.0f ? -0.0f : NAN;
+			ok = ok && equal_float(fbuf, fbuf2, n) ==
+					   (fbuf[k] == 0.0f);
+		}
+
+		replace_float(fbuf, n, 0.0f, 1.5f);
+		bool replaced = true;
+		for (size_t i = 0; i < n; i++)
+			replaced = replaced && fbuf[i] != 0.0f;
+		ok = ok && replaced;
+
+		memcpy(fbuf2, fbuf, n * sizeof(float));
+		reverse_float(fbuf, n);
+		for (size_t i = 0; i < n; i++)
+			ok = ok && fbuf[i] == fbuf2[n - 1 - i];
+	}
+	VERIFY(ok);
+
+	/* NaN elements are skipped, all NaN gives NaN */
+	float nans[] = {NAN, 4.0f, NAN, -2.0f, 9.0f, NAN, NAN, 1.0f,
+			NAN, NAN, 3.0f, NAN, -7.5f, NAN, NAN, NAN, NAN};
+	VERIFY(min_float(nans, _countof(nans)) == -7.5f);
+	VERIFY(max_float(nans, _countof(nans)) == 9.0f);
+	for (size_t i = 0; i < _countof(nans); i++)
+		nans[i] = NAN;
+	VERIFY(isnan(min_float(nans, _countof(nans))));
+	VERIFY(isnan(max_float(nans, _countof(nans))));
+	float infs[] = {INFINITY, NAN, INFINITY, INFINITY, INFINITY};
+	VERIFY(min_float(infs, _countof(infs)) == INFINITY);
+	PASSED(__func__, __LINE__);
+}
+/* each kernel at each level, an op is one pass over BENCH_COUNT elements.
+   The callback versions from algo.c come first where there is one.  An
+   even number of rounds leaves the reversed buffer as it was. */
+#define TIME(label, expr)                                                      \
+	do {                                                                   \
+		uint64_t t0 = bench_now();                                     \
+		for (int r = 0; r < BENCH_ROUNDS; r++)                         \
+			expr;                                                  \
+		BENCH_REPORT(label, bench_now() - t0, BENCH_ROUNDS);           \
+	} while (0)
+
+static volatile size_t sink;
+static volatile float fsink;
+void simd_bench()
+{
+	TC_BEGIN(__func__);
+	simd_level best = simd_current();
+	char label[48];
+	fill_ints(ibuf, BENCH_COUNT);
+	memcpy(ibuf2, ibuf, sizeof(ibuf));
+	fill_floats(fbuf, BENCH_COUNT);
+	memcpy(fbuf2, fbuf, sizeof(fbuf));
+	int oldval = 3, newval = 3;
+
+	TIME("count_if genptr", sink = count_if(ibuf, BENCH_COUNT, sizeof(int),
+						is_zero));
+	TIME("accumulate genptr", sink = accumulate(ibuf, BENCH_COUNT,
+						    sizeof(int), ret_int));
+	TIME("equal genptr", sink = equal(ibuf, ibuf2, BENCH_COUNT, sizeof(int),
+					  int_cmp));
+	TIME("replace genptr", replace(ibuf, &oldval, &newval, BENCH_COUNT,
+				       sizeof(int), int_cmp));
+	TIME("reverse genptr", reverse(ibuf, BENCH_COUNT, sizeof(int),
+				       int_swap));
+
+	for (int lvl = SIMD_SCALAR; lvl <= best; lvl++) {
+		simd_select(lvl);
+		const char *name = level_names[lvl];
+#define KERNEL(kernel, expr)                                                   \
+	snprintf(label, sizeof(label), "%s %s", kernel, name);                 \
+	TIME(label, expr)
+		KERNEL("count_if_int_eq", sink = count_if_int_eq(ibuf,
+								 BENCH_COUNT,
+								 0));
+		KERNEL("accumulate_int",
+		       sink = (size_t)accumulate_int(ibuf, BENCH_COUNT));
+		KERNEL("accumulate_float",
+		       fsink = accumulate_float(fbuf, BENCH_COUNT));
+		KERNEL("equal_int", sink = equal_int(ibuf, ibuf2, BENCH_COUNT));
+		KERNEL("equal_float",
+		       sink = equal_float(fbuf, fbuf2, BENCH_COUNT));
+		KERNEL("replace_int", replace_int(ibuf, BENCH_COUNT, 3, 3));
+		KERNEL("replace_float",
+		       replace_float(fbuf, BENCH_COUNT, 0.0f, 0.0f));
+		KERNEL("min_int", sink = (size_t)min_int(ibuf, BENCH_COUNT));
+		KERNEL("max_float", fsink = max_float(fbuf, BENCH_COUNT));
+		KERNEL("reverse_int", reverse_int(ibuf, BENCH_COUNT));
+#undef KERNEL
+	}
+	simd_select(best);
+	VERIFY(equal_int(ibuf, ibuf2, BENCH_COUNT));
+	PASSED(__func__, __LINE__);
+}
+#pragma GCC diagnostic pop
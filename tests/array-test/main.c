@@ -6,6 +6,7 @@
 #include "functor.h"
 #include "heap.h"
 #include "stack.h"
+#include "pool.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
@@ -29,6 +30,7 @@ static student recs[] = {{"Joe", 2.0},   {"Mary", 4.0},  {"Larry", 3.5},
 void print_int_array(int *arr, const size_t count);
 void array_test();
 void poly_test();
+void allocator_test();
 
 void Delay()
 {
@@ -40,9 +42,11 @@ void dummy();
 int main()
 {
 	PROJECT_BANNER("ARRAY TEST, Dynamic Array and Algorithms");
-	Heap_Init();
+	long heap_status = Heap_Init();
+	VERIFY(heap_status == HEAP_OK);
 	array_test();
 	poly_test();
+	allocator_test();
 	REPORT("emb Array-Test");
 	dummy();
 
@@ -94,7 +98,20 @@ void array_test()
 	pas = array_alloc(_countof(strs), sizeof(const char *));
 	array_add(pas, strs, _countof(strs));
 	array_print(pas, print_pstr);
+	VERIFY(array_alignment(pas) >= sizeof(long));
 	array_free(pas);
+
+	for (size_t align = 16; align <= 64; align *= 2) {
+		pai = array_alloc_aligned(_countof(a), sizeof(int), align);
+		VERIFY(array_alignment(pai) == align);
+		array_add(pai, a, _countof(a));
+		VERIFY(((size_t)array_at(pai, 0) % align) == 0);
+		array_sort(pai, int_less, int_swap);
+		VERIFY(*(int *)array_at(pai, 0) == 0);
+		array_free(pai);
+	}
+	long ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
 	PASSED(__func__, __LINE__);
 }
 
@@ -130,6 +147,45 @@ void poly_test()
 	poly_free(pa);
 	PASSED(__func__, __LINE__);
 }
+/* arrays whose descriptor and buffer live outside the default heap */
+void allocator_test()
+{
+	TC_BEGIN(__func__);
+	long used = Heap_Stats().blocksUsed;
+	arrayptr pai = array_alloc_with(_countof(a), sizeof(int),
+					&system_allocator);
+	array_add(pai, a, _countof(a));
+	array_sort(pai, int_less, int_swap);
+	VERIFY(*(int *)array_at(pai, 0) == 0);
+	VERIFY(Heap_Stats().blocksUsed == used);
+	array_free(pai);
+
+	polyptr pa = poly_alloc_with(_countof(a), sizeof(int), int_cmp,
+				     int_less, int_swap, print_int,
+				     &system_allocator);
+	poly_add(pa, a, _countof(a));
+	poly_sort(pa);
+	VERIFY(*(int *)poly_at(pa, 0) == 0);
+	VERIFY(Heap_Stats().blocksUsed == used);
+	poly_free(pa);
+
+	/* the buffer is one pool object, the descriptor may fall back to the
+	   heap depending on its size */
+	poolptr pp = pool_alloc(_countof(a) * sizeof(int), 2);
+	allocator al = pool_allocator(pp);
+	pai = array_alloc_with(_countof(a), sizeof(int), &al);
+	VERIFY(pool_available(pp) < 2);
+	array_add(pai, a, _countof(a));
+	VERIFY(*(int *)array_at(pai, 9) == 0);
+	array_free(pai);
+	VERIFY(pool_available(pp) == 2);
+	pool_free(pp);
+
+	VERIFY(Heap_Stats().blocksUsed == used);
+	long ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	PASSED(__func__, __LINE__);
+}
 // often used print integer array
 void print_int_array(int *arr, const size_t count)
 {
@@ -1,13 +1,33 @@
 #include "precompile.h"
 #include "harness.h"
+#include "bench.h"
 #include "algo.h"
 #include "functor.h"
 #include "heap.h"
 #include "bitmanip.inl"
+#include <float.h>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
 #define SINE_ARRAY_SIZE 91
+#define SORT_TEST_MAX 1500
+#define SORT_BENCH_COUNT 2000
+#define SORT_BENCH_ROUNDS 5
+#define STABLE_TEST_MAX 1200
+#define SCRATCH_HEAP_BYTES 2048
+#define SEARCH_BENCH_KEYS 512
+#if defined(__arm__)
+#define SEARCH_BENCH_COUNT 2048
+#else
+#define SEARCH_BENCH_COUNT (1 << 20)
+#endif
+#if defined(__arm__)
+#define REDUCE_COUNT 1024
+#else
+#define REDUCE_COUNT (1 << 20)
+#endif
+#define REDUCE_ROUNDS 5
+#define REDUCE_TEST_MAX 300
 
 #ifndef NL
 #define NL printf("\n")
@@ -22,9 +42,40 @@ static student recs[] = {{"Joe", 2.0},   {"Mary", 4.0},  {"Larry", 3.5},
 			 {"Moe", 3.0},   {"Harry", 3.5}, {"Mary", 2.0},
 			 {"Jill", 4.0},  {"Jerry", 2.9}, {"Mike", 3.5},
 			 {"Harry", 3.0}, {"Abel", 3.5},  {"Abel", 2.0}};
+static int sort_buf[SORT_BENCH_COUNT];
+static const char *patterns[] = {"sorted", "reversed", "random",
+				 "few unique", "organ pipe"};
+static long compares;
+
+/* sorted by key only, seq records the original order */
+typedef struct keyed {
+	int key;
+	int seq;
+} keyed;
+static int sort_ref[SORT_BENCH_COUNT];
+/* one scratch buffer for the typed sort, stable sort, search and reduce
+   tests, which never run at the same time.  On the board .bss has to end
+   low enough to leave the linker heap room for sort_int's scratch */
+static union {
+	uint32_t u32[SORT_BENCH_COUNT];
+	float floats[SORT_BENCH_COUNT];
+	double doubles[SORT_BENCH_COUNT];
+	keyed keys[STABLE_TEST_MAX];
+	struct {
+		int table[SEARCH_BENCH_COUNT];
+		int keys[SEARCH_BENCH_KEYS];
+		int *results[SEARCH_BENCH_KEYS];
+	} search;
+	struct {
+		int ints[REDUCE_COUNT];
+		float floats[REDUCE_COUNT];
+		double doubles[REDUCE_TEST_MAX];
+	} reduce;
+} shared;
 
 // test helper
 void print_int_array(int *arr, const size_t count);
+void fill_pattern(int *a, const size_t count, const int pattern);
 
 // test functions
 void visit_sort_trans_mod_test();
@@ -40,6 +91,22 @@ void replace_test();
 void reverse_test();
 void copy_backward_test();
 void product_test();
+void sort_pattern_test();
+void sort_bench();
+void stable_sort_test();
+void merge_ranges_test();
+void stable_sort_bench();
+void radix_sort_test();
+void radix_sort_bench();
+void typed_algos_test();
+void typed_algos_bench();
+void search_batch_test();
+void search_bench();
+void rotate_test();
+void selection_test();
+void selection_bench();
+void reduce_test();
+void reduce_bench();
 
 void Delay()
 {
@@ -52,7 +119,9 @@ void dummy();
 int main()
 {
 	PROJECT_BANNER("C ALGORITHMS, C Range Based Algorithms");
-	Heap_Init();
+	long heap_status = Heap_Init();
+	VERIFY(heap_status == HEAP_OK);
+	bench_init();
 	visit_sort_trans_mod_test();
 	search_test();
 	bit_manip_test();
@@ -66,6 +135,22 @@ int main()
 	reverse_test();
 	copy_backward_test();
 	product_test();
+	sort_pattern_test();
+	sort_bench();
+	stable_sort_test();
+	merge_ranges_test();
+	stable_sort_bench();
+	radix_sort_test();
+	radix_sort_bench();
+	typed_algos_test();
+	typed_algos_bench();
+	search_batch_test();
+	search_bench();
+	rotate_test();
+	selection_test();
+	selection_bench();
+	reduce_test();
+	reduce_bench();
 	REPORT("emb C-Algo");
 	dummy();
 
@@ -154,8 +239,11 @@ void merge_test()
 	deduce_sort(src2, 10);
 	print_int_array(src1, 10);
 	print_int_array(src2, 10);
-	merge(dest, src1, src2, 20, sizeof(int), int_less);
+	merge_ranges(dest, src1, 10, src2, 10, sizeof(int), int_less);
 	print_int_array(dest, 20);
+	int expect[] = {0, 1, 11, 11, 21, 22, 31, 33, 41, 44,
+			51, 55, 61, 66, 71, 77, 81, 88, 91, 99};
+	VERIFY(memcmp(dest, expect, sizeof(expect)) == 0);
 	PASSED(__func__, __LINE__);
 }
 void swap_ranges_test()
@@ -179,6 +267,29 @@ void random_shuffle_test()
 	print_int_array(a, _countof(a));
 	random_shuffle(a, _countof(a), sizeof(int), int_swap);
 	print_int_array(a, _countof(a));
+	VERIFY(accumulate(a, _countof(a), sizeof(int), ret_int) == 495);
+
+	/* the same seed gives the same order */
+	int b[_countof(a)], c[_countof(a)];
+	memcpy(b, a, sizeof(a));
+	memcpy(c, a, sizeof(a));
+	rng r1, r2;
+	rng_seed(&r1, 42);
+	rng_seed(&r2, 42);
+	random_shuffle_with(b, _countof(b), sizeof(int), int_swap, &r1);
+	random_shuffle_with(c, _countof(c), sizeof(int), int_swap, &r2);
+	VERIFY(equal(b, c, _countof(b), sizeof(int), int_cmp));
+
+	/* all 6 orders of 3 elements about equally often, the old shuffle
+	   never left an element in place */
+	int counts[6] = {0};
+	for (int i = 0; i < 6000; i++) {
+		int t[] = {0, 1, 2};
+		random_shuffle_with(t, 3, sizeof(int), int_swap, &r1);
+		counts[t[0] * 2 + (t[1] > t[2])]++;
+	}
+	for (int i = 0; i < 6; i++)
+		VERIFY(counts[i] > 900 && counts[i] < 1100);
 	PASSED(__func__, __LINE__);
 }
 void count_if_test()
@@ -246,9 +357,858 @@ void product_test()
 	
 	prod = inner_product(a, a, _countof(a), sizeof(int), ret_int);
 	printf("inner product: %d\n", prod);
-	VERIFY(prod == 240);
+	VERIFY(prod == 55);
+}
+
+/* every pattern at sizes around the insertion and ninther cutoffs, checked
+   for order, for the same multiset and for an n log n compare count */
+static bool int_less_counted(const int *v1, const int *v2)
+{
+	compares++;
+	return *v1 < *v2;
+}
+static int int_qsort_cmp(const void *v1, const void *v2)
+{
+	return (*(const int *)v1 > *(const int *)v2) -
+	       (*(const int *)v1 < *(const int *)v2);
+}
+void sort_pattern_test()
+{
+	TC_BEGIN(__func__);
+	static const size_t sizes[] = {0, 1, 2, 15, 16, 17, 100, 129, 1000,
+				       SORT_TEST_MAX};
+	for (int pat = 0; pat < _countof(patterns); pat++)
+		for (int i = 0; i < _countof(sizes); i++) {
+			size_t n = sizes[i];
+			long sum = 0, log2n = 1;
+			fill_pattern(sort_buf, n, pat);
+			for (size_t k = 0; k < n; k++)
+				sum += sort_buf[k];
+			for (size_t k = n; k > 1; k >>= 1)
+				log2n++;
+			compares = 0;
+			gensort(sort_buf, n, sizeof(int), int_less_counted,
+				int_swap);
+			bool ordered = true;
+			for (size_t k = 1; k < n; k++) {
+				ordered = ordered && sort_buf[k - 1] <= sort_buf[k];
+				sum -= sort_buf[k];
+			}
+			if (n)
+				sum -= sort_buf[0];
+			VERIFY(ordered && sum == 0);
+			VERIFY(compares <= 4 * (long)n * log2n);
+		}
+
+	/* records, a different element size, best gpa first */
+	gensort(recs, _countof(recs), sizeof(student), record_gpaless,
+		record_swap);
+	for (int i = 1; i < _countof(recs); i++)
+		VERIFY(!record_gpaless(&recs[i], &recs[i - 1]));
+	PASSED(__func__, __LINE__);
+}
+/* gensort against the C library's qsort on each input pattern */
+void sort_bench()
+{
+	TC_BEGIN(__func__);
+	char label[48];
+	for (int pat = 0; pat < _countof(patterns); pat++) {
+		uint64_t sort_ticks = 0, qsort_ticks = 0;
+		for (int r = 0; r < SORT_BENCH_ROUNDS; r++) {
+			fill_pattern(sort_buf, SORT_BENCH_COUNT, pat);
+			uint64_t t0 = bench_now();
+			gensort(sort_buf, SORT_BENCH_COUNT, sizeof(int),
+				int_less, int_swap);
+			sort_ticks += bench_now() - t0;
+			VERIFY(sort_buf[0] <= sort_buf[SORT_BENCH_COUNT - 1]);
+
+			fill_pattern(sort_buf, SORT_BENCH_COUNT, pat);
+			t0 = bench_now();
+			qsort(sort_buf, SORT_BENCH_COUNT, sizeof(int),
+			      int_qsort_cmp);
+			qsort_ticks += bench_now() - t0;
+		}
+		snprintf(label, sizeof(label), "gensort %s", patterns[pat]);
+		BENCH_REPORT(label, sort_ticks,
+			     SORT_BENCH_ROUNDS * SORT_BENCH_COUNT);
+		snprintf(label, sizeof(label), "qsort %s", patterns[pat]);
+		BENCH_REPORT(label, qsort_ticks,
+			     SORT_BENCH_ROUNDS * SORT_BENCH_COUNT);
+	}
+	PASSED(__func__, __LINE__);
+}
+static bool keyed_less(const keyed *v1, const keyed *v2)
+{
+	return v1->key < v2->key;
+}
+static bool gpa_less(const student *v1, const student *v2)
+{
+	return v1->gpa < v2->gpa;
+}
+static bool name_less(const student *v1, const student *v2)
+{
+	return strcmp(v1->name, v2->name) < 0;
+}
+/* order and original order of equal keys, every pattern and some sizes
+   around the minimum run */
+void stable_sort_test()
+{
+	TC_BEGIN(__func__);
+	keyed *keyed_buf = shared.keys;
+	static const size_t sizes[] = {0, 1, 2, 31, 32, 33, 64, 65, 500,
+				       STABLE_TEST_MAX};
+	for (int pat = 0; pat < _countof(patterns); pat++)
+		for (int i = 0; i < _countof(sizes); i++) {
+			size_t n = sizes[i];
+			fill_pattern(sort_buf, n, pat);
+			for (size_t k = 0; k < n; k++) {
+				keyed_buf[k].key = sort_buf[k] % 16;
+				keyed_buf[k].seq = (int)k;
+			}
+			VERIFY(gensort_stable(keyed_buf, n, sizeof(keyed),
+					      keyed_less));
+			bool stable = true;
+			for (size_t k = 1; k < n; k++) {
+				keyed *prev = &keyed_buf[k - 1], *cur = &keyed_buf[k];
+				stable = stable && (prev->key < cur->key ||
+						    (prev->key == cur->key &&
+						     prev->seq < cur->seq));
+			}
+			VERIFY(stable);
+		}
+
+	/* students by gpa, names stay in alphabetical order within a gpa */
+	gensort_stable(recs, _countof(recs), sizeof(student), name_less);
+	gensort_stable(recs, _countof(recs), sizeof(student), gpa_less);
+	for (int i = 1; i < _countof(recs); i++) {
+		VERIFY(recs[i - 1].gpa <= recs[i].gpa);
+		if (recs[i - 1].gpa == recs[i].gpa)
+			VERIFY(strcmp(recs[i - 1].name, recs[i].name) <= 0);
+	}
+	visit(recs, _countof(recs), sizeof(student), print_student);
+
+	/* the scratch buffer from a caller heap, too small leaves the data */
+	static long scratch[SCRATCH_HEAP_BYTES / sizeof(long)];
+	heap_t sh;
+	Heap_InitRegion(&sh, scratch, sizeof(scratch));
+	allocator al = heap_instance_allocator(&sh);
+	fill_pattern(sort_buf, STABLE_TEST_MAX, 1);
+	VERIFY(!gensort_stable_with(sort_buf, STABLE_TEST_MAX, sizeof(int),
+				    int_less, &al));
+	VERIFY(sort_buf[0] == STABLE_TEST_MAX);
+	VERIFY(gensort_stable_with(sort_buf, 20, sizeof(int), int_less, &al));
+	VERIFY(sort_buf[0] == STABLE_TEST_MAX - 19);
+	VERIFY(Heap_StatsIn(&sh).blocksUsed == 0);
+	PASSED(__func__, __LINE__);
+}
+void merge_ranges_test()
+{
+	TC_BEGIN(__func__);
+	int src1[] = {1, 3, 5, 7};
+	int src2[] = {0, 2, 4, 6, 8, 10, 12, 14};
+	int dest[12];
+	int cmp[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 14};
+	merge_ranges(dest, src1, _countof(src1), src2, _countof(src2),
+		     sizeof(int), int_less);
+	print_int_array(dest, _countof(dest));
+	VERIFY(equal(dest, cmp, _countof(dest), sizeof(int), int_cmp));
+	merge_ranges(dest, src2, _countof(src2), src1, 0, sizeof(int),
+		     int_less);
+	VERIFY(equal(dest, src2, _countof(src2), sizeof(int), int_cmp));
+
+	/* ties come from the first range first */
+	keyed k1[] = {{1, 0}, {2, 1}}, k2[] = {{1, 2}, {2, 3}}, kd[4];
+	merge_ranges(kd, k1, 2, k2, 2, sizeof(keyed), keyed_less);
+	for (int i = 0; i < 4; i++)
+		VERIFY(kd[i].seq == (i % 2) * 2 + i / 2);
+	PASSED(__func__, __LINE__);
+}
+/* nearly sorted input like a sensor stream, one sample in a hundred out
+   of place, and random input */
+void stable_sort_bench()
+{
+	TC_BEGIN(__func__);
+	uint64_t stable_ticks[2] = {0, 0}, sort_ticks[2] = {0, 0};
+	for (int r = 0; r < SORT_BENCH_ROUNDS; r++)
+		for (int pat = 0; pat < 2; pat++) {
+			for (int i = 0; i < SORT_BENCH_COUNT; i++)
+				sort_buf[i] = pat ? rand() :
+					    (i % 100 == 0 ? rand() % SORT_BENCH_COUNT : i);
+			uint64_t t0 = bench_now();
+			gensort_stable(sort_buf, SORT_BENCH_COUNT, sizeof(int),
+				       int_less);
+			stable_ticks[pat] += bench_now() - t0;
+			VERIFY(sort_buf[0] <= sort_buf[SORT_BENCH_COUNT - 1]);
+
+			for (int i = 0; i < SORT_BENCH_COUNT; i++)
+				sort_buf[i] = pat ? rand() :
+					    (i % 100 == 0 ? rand() % SORT_BENCH_COUNT : i);
+			t0 = bench_now();
+			gensort(sort_buf, SORT_BENCH_COUNT, sizeof(int),
+				int_less, int_swap);
+			sort_ticks[pat] += bench_now() - t0;
+		}
+	const int ops = SORT_BENCH_ROUNDS * SORT_BENCH_COUNT;
+	BENCH_REPORT("gensort_stable nearly sorted", stable_ticks[0], ops);
+	BENCH_REPORT("gensort nearly sorted", sort_ticks[0], ops);
+	BENCH_REPORT("gensort_stable random", stable_ticks[1], ops);
+	BENCH_REPORT("gensort random", sort_ticks[1], ops);
+	PASSED(__func__, __LINE__);
+}
+static int float_qsort_cmp(const void *v1, const void *v2)
+{
+	return (*(const float *)v1 > *(const float *)v2) -
+	       (*(const float *)v1 < *(const float *)v2);
+}
+/* radix results against gensort, around the cutoff and with digits that
+   are the same in every key */
+void radix_sort_test()
+{
+	TC_BEGIN(__func__);
+	uint32_t *u32_buf = shared.u32;
+	float *float_buf = shared.floats;
+	static const size_t sizes[] = {0, 1, 63, 64, 65, 1000,
+				       SORT_BENCH_COUNT};
+	for (int i = 0; i < _countof(sizes); i++) {
+		size_t n = sizes[i];
+		for (size_t k = 0; k < n; k++)
+			sort_buf[k] = sort_ref[k] = rand() - RAND_MAX / 2;
+		sort_int(sort_buf, n);
+		gensort(sort_ref, n, sizeof(int), int_less, int_swap);
+		VERIFY(n == 0 || equal(sort_buf, sort_ref, n, sizeof(int),
+				       int_cmp));
+
+		for (size_t k = 0; k < n; k++)
+			u32_buf[k] = (k % 2) ? (uint32_t)rand() << 16 ^ rand() :
+					       (uint32_t)(rand() % 256);
+		deduce_sort(u32_buf, n);
+		bool ordered = true;
+		for (size_t k = 1; k < n; k++)
+			ordered = ordered && u32_buf[k - 1] <= u32_buf[k];
+		VERIFY(ordered);
+
+		for (size_t k = 0; k < n; k++)
+			float_buf[k] = (float)(rand() - RAND_MAX / 2) / 1000.0f;
+		if (n > 4) {
+			float_buf[0] = -0.0f;
+			float_buf[1] = 0.0f;
+			float_buf[2] = INFINITY;
+			float_buf[3] = -INFINITY;
+		}
+		deduce_sort(float_buf, n);
+		ordered = true;
+		for (size_t k = 1; k < n; k++)
+			ordered = ordered && float_buf[k - 1] <= float_buf[k];
+		VERIFY(ordered);
+		if (n > 4)
+			VERIFY(float_buf[0] == -INFINITY &&
+			       float_buf[n - 1] == INFINITY);
+	}
+
+	/* keys that only differ in the low byte, three passes skipped */
+	for (int k = 0; k < SORT_BENCH_COUNT; k++)
+		sort_buf[k] = 0x12345600 | (rand() & 0xff);
+	sort_int(sort_buf, SORT_BENCH_COUNT);
+	VERIFY(sort_buf[0] <= sort_buf[SORT_BENCH_COUNT / 2] &&
+	       sort_buf[SORT_BENCH_COUNT / 2] <= sort_buf[SORT_BENCH_COUNT - 1]);
+	PASSED(__func__, __LINE__);
+}
+/* random int and float samples, radix against gensort and qsort */
+void radix_sort_bench()
+{
+	TC_BEGIN(__func__);
+	float *float_buf = shared.floats;
+	uint64_t radix = 0, generic = 0, lib = 0, fradix = 0, flib = 0;
+	for (int r = 0; r < SORT_BENCH_ROUNDS; r++) {
+		for (int k = 0; k < SORT_BENCH_COUNT; k++)
+			sort_buf[k] = rand() - RAND_MAX / 2;
+		memcpy(sort_ref, sort_buf, sizeof(sort_ref));
+		uint64_t t0 = bench_now();
+		sort_int(sort_buf, SORT_BENCH_COUNT);
+		radix += bench_now() - t0;
+		memcpy(sort_buf, sort_ref, sizeof(sort_ref));
+		t0 = bench_now();
+		gensort(sort_buf, SORT_BENCH_COUNT, sizeof(int), int_less,
+			int_swap);
+		generic += bench_now() - t0;
+		memcpy(sort_buf, sort_ref, sizeof(sort_ref));
+		t0 = bench_now();
+		qsort(sort_buf, SORT_BENCH_COUNT, sizeof(int), int_qsort_cmp);
+		lib += bench_now() - t0;
+
+		for (int k = 0; k < SORT_BENCH_COUNT; k++)
+			float_buf[k] = (float)sort_ref[k] / 1000.0f;
+		t0 = bench_now();
+		sort_float(float_buf, SORT_BENCH_COUNT);
+		fradix += bench_now() - t0;
+		for (int k = 0; k < SORT_BENCH_COUNT; k++)
+			float_buf[k] = (float)sort_ref[k] / 1000.0f;
+		t0 = bench_now();
+		qsort(float_buf, SORT_BENCH_COUNT, sizeof(float),
+		      float_qsort_cmp);
+		flib += bench_now() - t0;
+	}
+	const int ops = SORT_BENCH_ROUNDS * SORT_BENCH_COUNT;
+	BENCH_REPORT("sort_int radix random", radix, ops);
+	BENCH_REPORT("gensort int random", generic, ops);
+	BENCH_REPORT("qsort int random", lib, ops);
+	BENCH_REPORT("sort_float radix random", fradix, ops);
+	BENCH_REPORT("qsort float random", flib, ops);
+	PASSED(__func__, __LINE__);
+}
+/* a struct instance, the built in types are instantiated in algo_typed.h */
+static inline bool gpa_lt(student v1, student v2)
+{
+	return v1.gpa < v2.gpa;
+}
+MLIBS_DEFINE_ORDERED(student, gpa_lt)
+
+static inline int third(int v)
+{
+	return v / 3;
+}
+static inline bool odd(int v)
+{
+	return v & 1;
+}
+static void third_gen(const int *psrc, int *pdest)
+{
+	*pdest = *psrc / 3;
+}
+static bool odd_gen(const int *v)
+{
+	return *v & 1;
+}
+/* the typed instances against the genptr versions */
+void typed_algos_test()
+{
+	TC_BEGIN(__func__);
+	uint32_t *u32_buf = shared.u32;
+	double *double_buf = shared.doubles;
+	for (int pat = 0; pat < _countof(patterns); pat++) {
+		for (size_t n = 0; n <= SORT_TEST_MAX; n += 1 + n / 2) {
+			fill_pattern(sort_buf, n, pat);
+			memcpy(sort_ref, sort_buf, n * sizeof(int));
+			sort_int_lt(sort_buf, n);
+			gensort(sort_ref, n, sizeof(int), int_less, int_swap);
+			VERIFY(n == 0 || equal(sort_buf, sort_ref, n,
+					       sizeof(int), int_cmp));
+		}
+	}
+
+	for (int k = 0; k < SORT_BENCH_COUNT; k++)
+		double_buf[k] = (double)(rand() - RAND_MAX / 2) / 7.0;
+	deduce_sort(double_buf, SORT_BENCH_COUNT);
+	VERIFY(is_sorted_double_lt(double_buf, SORT_BENCH_COUNT));
+	double dkey = double_buf[SORT_BENCH_COUNT / 3];
+	double *pd = deduce_search(double_buf, &dkey, 0, SORT_BENCH_COUNT - 1);
+	VERIFY(pd && *pd == dkey);
+
+	long longs[] = {40, -7, 100000, 3, 3, -90000, 12};
+	deduce_sort(longs, _countof(longs));
+	VERIFY(is_sorted_long_lt(longs, _countof(longs)));
+	long lkey = 12, lmiss = 13;
+	VERIFY(*deduce_search(longs, &lkey, 0, _countof(longs) - 1) == 12);
+	VERIFY(deduce_search(longs, &lmiss, 0, _countof(longs) - 1) == NULL);
+
+	for (int k = 0; k < SORT_BENCH_COUNT; k++)
+		sort_buf[k] = 2 * k;
+	bool agree = true;
+	for (int key = 0; key < 2 * SORT_BENCH_COUNT; key++)
+		agree = agree && search_int_lt(sort_buf, &key, 0,
+					       SORT_BENCH_COUNT - 1) ==
+					 search_int(sort_buf, &key, 0,
+						    SORT_BENCH_COUNT - 1);
+	VERIFY(agree);
+	int below = -1;
+	VERIFY(search_int_lt(sort_buf, &below, 0, SORT_BENCH_COUNT - 1) ==
+	       NULL);
+
+	int src1[] = {1, 3, 5, 7, 9}, src2[] = {0, 3, 4, 10}, dest[9];
+	merge_int_lt(dest, src1, _countof(src1), src2, _countof(src2));
+	VERIFY(is_sorted_int_lt(dest, _countof(dest)) && dest[8] == 10);
+
+	fill_pattern(sort_buf, SORT_BENCH_COUNT, 2);
+	transform_int_lt(sort_ref, sort_buf, SORT_BENCH_COUNT, third);
+	transform(u32_buf, sort_buf, SORT_BENCH_COUNT, sizeof(int), third_gen);
+	VERIFY(memcmp(sort_ref, u32_buf, sizeof(sort_ref)) == 0);
+	VERIFY(count_if_int_lt(sort_buf, SORT_BENCH_COUNT, odd) ==
+	       count_if(sort_buf, SORT_BENCH_COUNT, sizeof(int), odd_gen));
+	fill_pattern(sort_buf, SORT_BENCH_COUNT, 3);
+	VERIFY(accumulate_int_lt(sort_buf, SORT_BENCH_COUNT) ==
+	       accumulate(sort_buf, SORT_BENCH_COUNT, sizeof(int), ret_int));
+	reverse_int_lt(dest, _countof(dest));
+	VERIFY(dest[0] == 10 && dest[8] == 0);
+
+	student copy[_countof(recs)];
+	memcpy(copy, recs, sizeof(copy));
+	sort_gpa_lt(copy, _countof(copy));
+	VERIFY(is_sorted_gpa_lt(copy, _countof(copy)));
+	PASSED(__func__, __LINE__);
+}
+/* what inlining the comparator and functor buys over the genptr calls */
+void typed_algos_bench()
+{
+	TC_BEGIN(__func__);
+	uint64_t typed = 0, generic = 0, t0;
+	for (int r = 0; r < SORT_BENCH_ROUNDS; r++) {
+		fill_pattern(sort_ref, SORT_BENCH_COUNT, 2);
+		memcpy(sort_buf, sort_ref, sizeof(sort_ref));
+		t0 = bench_now();
+		sort_int_lt(sort_buf, SORT_BENCH_COUNT);
+		typed += bench_now() - t0;
+		memcpy(sort_buf, sort_ref, sizeof(sort_ref));
+		t0 = bench_now();
+		gensort(sort_buf, SORT_BENCH_COUNT, sizeof(int), int_less,
+			int_swap);
+		generic += bench_now() - t0;
+	}
+	const int ops = SORT_BENCH_ROUNDS * SORT_BENCH_COUNT;
+	BENCH_REPORT("sort_int_lt random", typed, ops);
+	BENCH_REPORT("gensort int random", generic, ops);
+
+	typed = generic = 0;
+	size_t ntyped = 0, ngeneric = 0;
+	for (int r = 0; r < SORT_BENCH_ROUNDS; r++) {
+		t0 = bench_now();
+		transform_int_lt(sort_buf, sort_ref, SORT_BENCH_COUNT, third);
+		ntyped += count_if_int_lt(sort_buf, SORT_BENCH_COUNT, odd);
+		typed += bench_now() - t0;
+		t0 = bench_now();
+		transform(sort_buf, sort_ref, SORT_BENCH_COUNT, sizeof(int),
+			  third_gen);
+		ngeneric += count_if(sort_buf, SORT_BENCH_COUNT, sizeof(int),
+				     odd_gen);
+		generic += bench_now() - t0;
+	}
+	VERIFY(ntyped == ngeneric);
+	BENCH_REPORT("transform+count_if_int_lt", typed, ops);
+	BENCH_REPORT("transform+count_if genptr", generic, ops);
+	PASSED(__func__, __LINE__);
 }
+/* edges the old search got wrong and every key against a linear scan,
+   including duplicates where the first match is returned */
+void search_batch_test()
+{
+	TC_BEGIN(__func__);
+	int *search_keys = shared.search.keys;
+	int **search_results = shared.search.results;
+	int sorted[] = {1, 3, 3, 3, 5, 8, 8, 13};
+	int below = 0, above = 14, three = 3, eight = 8;
+	VERIFY(gensearch(sorted, &below, 0, _countof(sorted) - 1, sizeof(int),
+			 int_cmp) == NULL);
+	VERIFY(gensearch(sorted, &above, 0, _countof(sorted) - 1, sizeof(int),
+			 int_cmp) == NULL);
+	VERIFY(gensearch(sorted, &three, 0, _countof(sorted) - 1, sizeof(int),
+			 int_cmp) == &sorted[1]);
+	VERIFY(search_int(sorted, &eight, 0, _countof(sorted) - 1) ==
+	       &sorted[5]);
+	VERIFY(gensearch(sorted, &eight, 6, 7, sizeof(int), int_cmp) ==
+	       &sorted[6]);
+	VERIFY(gensearch(sorted, &eight, 2, 1, sizeof(int), int_cmp) == NULL);
+	size_t empty = 0;
+	VERIFY(gensearch(sorted, &three, 0, empty - 1, sizeof(int), int_cmp) ==
+	       NULL);
+	VERIFY(search_int(sorted, &three, 0, empty - 1) == NULL);
 
+	for (size_t n = 0; n <= 70; n++) {
+		for (size_t i = 0; i < n; i++)
+			sort_buf[i] = (int)(i / 2) * 3;
+		bool agree = true;
+		for (int key = -1; key <= (int)n * 2; key++) {
+			int *expect = NULL;
+			for (size_t i = 0; i < n && !expect; i++)
+				if (sort_buf[i] == key)
+					expect = &sort_buf[i];
+			agree = agree &&
+				gensearch(sort_buf, &key, 0, n - 1, sizeof(int),
+					  int_cmp) == expect &&
+				search_int(sort_buf, &key, 0, n - 1) == expect;
+			search_keys[key + 1] = key;
+		}
+		size_t nkeys = (size_t)n * 2 + 2;
+		gensearch_batch(sort_buf, n, search_keys, nkeys, sizeof(int),
+				int_cmp, search_results);
+		for (size_t k = 0; k < nkeys; k++)
+			agree = agree &&
+				search_results[k] ==
+					gensearch(sort_buf, &search_keys[k], 0,
+						  n - 1, sizeof(int), int_cmp);
+		search_batch_int_lt(sort_buf, n, search_keys, nkeys,
+				    search_results);
+		for (size_t k = 0; k < nkeys; k++)
+			agree = agree &&
+				search_results[k] ==
+					search_int(sort_buf, &search_keys[k], 0,
+						   n - 1);
+		VERIFY(agree);
+	}
+	PASSED(__func__, __LINE__);
+}
+/* random hits and misses in a big table, one at a time and batched */
+void search_bench()
+{
+	TC_BEGIN(__func__);
+	int *search_table = shared.search.table;
+	int *search_keys = shared.search.keys;
+	int **search_results = shared.search.results;
+	for (int i = 0; i < SEARCH_BENCH_COUNT; i++)
+		search_table[i] = 2 * i;
+	for (int k = 0; k < SEARCH_BENCH_KEYS; k++)
+		search_keys[k] = (int)(((uint32_t)rand() << 8 ^ rand()) %
+				       (2 * SEARCH_BENCH_COUNT));
+
+	uint64_t single = 0, batch = 0, typed = 0, typed_batch = 0, t0;
+	size_t found = 0, found_batch = 0;
+	for (int r = 0; r < SORT_BENCH_ROUNDS; r++) {
+		t0 = bench_now();
+		for (int k = 0; k < SEARCH_BENCH_KEYS; k++)
+			found += gensearch(search_table, &search_keys[k], 0,
+					   SEARCH_BENCH_COUNT - 1, sizeof(int),
+					   int_cmp) != NULL;
+		single += bench_now() - t0;
+
+		t0 = bench_now();
+		gensearch_batch(search_table, SEARCH_BENCH_COUNT, search_keys,
+				SEARCH_BENCH_KEYS, sizeof(int), int_cmp,
+				search_results);
+		batch += bench_now() - t0;
+		for (int k = 0; k < SEARCH_BENCH_KEYS; k++)
+			found_batch += search_results[k] != NULL;
+
+		t0 = bench_now();
+		for (int k = 0; k < SEARCH_BENCH_KEYS; k++)
+			found -= search_int(search_table, &search_keys[k], 0,
+					    SEARCH_BENCH_COUNT - 1) != NULL;
+		typed += bench_now() - t0;
+
+		t0 = bench_now();
+		search_batch_int_lt(search_table, SEARCH_BENCH_COUNT,
+				    search_keys, SEARCH_BENCH_KEYS,
+				    search_results);
+		typed_batch += bench_now() - t0;
+		for (int k = 0; k < SEARCH_BENCH_KEYS; k++)
+			found_batch -= search_results[k] != NULL;
+	}
+	VERIFY(found == 0 && found_batch == 0);
+	const int ops = SORT_BENCH_ROUNDS * SEARCH_BENCH_KEYS;
+	BENCH_REPORT("gensearch", single, ops);
+	BENCH_REPORT("gensearch_batch", batch, ops);
+	BENCH_REPORT("search_int", typed, ops);
+	BENCH_REPORT("search_batch_int_lt", typed_batch, ops);
+	PASSED(__func__, __LINE__);
+}
+/* every split of the lengths up to 40 against the rotated index, and an
+   8 byte element */
+void rotate_test()
+{
+	TC_BEGIN(__func__);
+	int a[] = {0, 1, 2, 3, 4};
+	int cmp[] = {2, 3, 4, 0, 1};
+	rotate(a, 2, _countof(a), sizeof(int));
+	print_int_array(a, _countof(a));
+	VERIFY(equal(a, cmp, _countof(a), sizeof(int), int_cmp));
+
+	bool ok = true;
+	for (size_t n = 0; n <= 40; n++)
+		for (size_t mid = 0; mid <= n; mid++) {
+			for (size_t i = 0; i < n; i++)
+				sort_buf[i] = (int)i;
+			rotate(sort_buf, mid, n, sizeof(int));
+			for (size_t i = 0; i < n; i++)
+				ok = ok && sort_buf[i] == (int)((i + mid) % n);
+		}
+	VERIFY(ok);
+
+	keyed k[7];
+	for (size_t i = 0; i < _countof(k); i++) {
+		k[i].key = (int)i;
+		k[i].seq = (int)(i * 10);
+	}
+	const size_t nk = _countof(k);
+	rotate(k, 4, nk, sizeof(keyed));
+	for (size_t i = 0; i < nk; i++)
+		ok = ok && k[i].key == (int)((i + 4) % nk) &&
+		     k[i].seq == k[i].key * 10;
+	VERIFY(ok);
+	PASSED(__func__, __LINE__);
+}
+/* nth_element and partial_sort against a sorted copy, every pattern, sizes
+   around the insertion cutoff, the first, middle and last positions */
+void selection_test()
+{
+	TC_BEGIN(__func__);
+	static const size_t sizes[] = {1, 2, 15, 16, 17, 100, 129, 1000,
+				       SORT_TEST_MAX};
+	for (size_t pat = 0; pat < _countof(patterns); pat++) {
+		bool ok = true;
+		for (size_t i = 0; i < _countof(sizes); i++) {
+			size_t n = sizes[i];
+			fill_pattern(sort_ref, n, pat);
+			memcpy(sort_buf, sort_ref, n * sizeof(int));
+			gensort(sort_ref, n, sizeof(int), int_less, int_swap);
+			const size_t nths[] = {0, n / 2, n - 1, n / 10};
+			for (size_t j = 0; j < _countof(nths); j++) {
+				size_t nth = nths[j];
+				nth_element(sort_buf, nth, n, sizeof(int),
+					    int_less, int_swap);
+				int v = sort_buf[nth];
+				ok = ok && v == sort_ref[nth];
+				for (size_t k = 0; k < n; k++)
+					ok = ok && (k < nth ? sort_buf[k] <= v :
+							      sort_buf[k] >= v);
+			}
+
+			size_t middle = n < 10 ? n : 10;
+			partial_sort(sort_buf, middle, n, sizeof(int), int_less,
+				     int_swap);
+			ok = ok && equal(sort_buf, sort_ref, middle,
+					 sizeof(int), int_cmp);
+			long sum = 0;
+			for (size_t k = 0; k < n; k++)
+				sum += sort_buf[k] - sort_ref[k];
+			ok = ok && sum == 0;
+		}
+		printf("%s\n", patterns[pat]);
+		VERIFY(ok);
+	}
+
+	/* top 3 into a bigger and a smaller buffer, src untouched */
+	int src[] = {5, 9, 1, 7, 3, 9, 2};
+	int top[3], all[10];
+	int top_cmp[] = {9, 9, 7};
+	int all_cmp[] = {1, 2, 3, 5, 7, 9, 9};
+	VERIFY(partial_sort_copy(top, _countof(top), src, _countof(src),
+				 sizeof(int), int_greater, int_swap) == 3);
+	VERIFY(equal(top, top_cmp, _countof(top), sizeof(int), int_cmp));
+	VERIFY(partial_sort_copy(all, _countof(all), src, _countof(src),
+				 sizeof(int), int_less, int_swap) == 7);
+	VERIFY(equal(all, all_cmp, _countof(all_cmp), sizeof(int), int_cmp));
+	VERIFY(src[0] == 5 && src[6] == 2);
+	VERIFY(partial_sort_copy(top, 0, src, _countof(src), sizeof(int),
+				 int_less, int_swap) == 0);
+
+	/* median of the students by gpa, a different element size */
+	student copy[_countof(recs)];
+	memcpy(copy, recs, sizeof(recs));
+	nth_element(copy, _countof(copy) / 2, _countof(copy), sizeof(student),
+		    gpa_less, record_swap);
+	gensort(recs, _countof(recs), sizeof(student), gpa_less, record_swap);
+	VERIFY(copy[_countof(copy) / 2].gpa == recs[_countof(recs) / 2].gpa);
+	PASSED(__func__, __LINE__);
+}
+/* a median and a top 10 of SORT_BENCH_COUNT samples against a full sort */
+void selection_bench()
+{
+	TC_BEGIN(__func__);
+	char label[48];
+	int top[10];
+	for (int pat = 0; pat < _countof(patterns); pat++) {
+		uint64_t sort_ticks = 0, nth_ticks = 0, top_ticks = 0;
+		for (int r = 0; r < SORT_BENCH_ROUNDS; r++) {
+			fill_pattern(sort_ref, SORT_BENCH_COUNT, pat);
+			memcpy(sort_buf, sort_ref, sizeof(sort_buf));
+			uint64_t t0 = bench_now();
+			gensort(sort_buf, SORT_BENCH_COUNT, sizeof(int),
+				int_less, int_swap);
+			sort_ticks += bench_now() - t0;
+			int median = sort_buf[SORT_BENCH_COUNT / 2];
+
+			memcpy(sort_buf, sort_ref, sizeof(sort_buf));
+			t0 = bench_now();
+			nth_element(sort_buf, SORT_BENCH_COUNT / 2,
+				    SORT_BENCH_COUNT, sizeof(int), int_less,
+				    int_swap);
+			nth_ticks += bench_now() - t0;
+			VERIFY(sort_buf[SORT_BENCH_COUNT / 2] == median);
+
+			t0 = bench_now();
+			partial_sort_copy(top, _countof(top), sort_ref,
+					  SORT_BENCH_COUNT, sizeof(int),
+					  int_greater, int_swap);
+			top_ticks += bench_now() - t0;
+		}
+		const int ops = SORT_BENCH_ROUNDS;
+		snprintf(label, sizeof(label), "gensort median %s",
+			 patterns[pat]);
+		BENCH_REPORT(label, sort_ticks, ops);
+		snprintf(label, sizeof(label), "nth_element median %s",
+			 patterns[pat]);
+		BENCH_REPORT(label, nth_ticks, ops);
+		snprintf(label, sizeof(label), "partial_sort_copy top10 %s",
+			 patterns[pat]);
+		BENCH_REPORT(label, top_ticks, ops);
+	}
+	PASSED(__func__, __LINE__);
+}
+static float naive_sum(const float *base, const size_t count)
+{
+	float sum = 0.0f;
+	for (size_t i = 0; i < count; i++)
+		sum += base[i];
+	return sum;
+}
+/* sums past INT_MAX are exact, dot products, and float sums against a
+   double reference: 0.1f many times, then small terms after a big one */
+void reduce_test()
+{
+	TC_BEGIN(__func__);
+	int *reduce_ints = shared.reduce.ints;
+	float *reduce_floats = shared.reduce.floats;
+	double *double_buf = shared.reduce.doubles;
+	int64_t isum = sum_int(NULL, 0);
+	float fsum = sum_float(NULL, 0);
+	VERIFY(isum == 0 && fsum == 0.0f);
+
+	const size_t n = 1003;
+	for (size_t i = 0; i < n; i++)
+		reduce_ints[i] = INT_MAX;
+	isum = sum_int(reduce_ints, n);
+	VERIFY(isum == (int64_t)n * INT_MAX);
+	for (size_t i = 0; i < n; i++)
+		reduce_ints[i] = -65536;
+	isum = dot_int(reduce_ints, reduce_ints, n);
+	VERIFY(isum == (int64_t)n << 32);
+	reduce_ints[0] = INT_MIN;
+	isum = sum_int(reduce_ints, 1);
+	VERIFY(isum == INT_MIN);
+
+	int a[] = {1, 2, 3, 4, 5};
+	float fa[] = {1, 2, 3, 4, 5};
+	double da[] = {1, 2, 3, 4, 5};
+	const size_t na = _countof(a);
+	int iprod = inner_product(a, a, na, sizeof(int), ret_int);
+	isum = dot_int(a, a, na);
+	fsum = dot_float(fa, fa, na);
+	double dsum = dot_double(da, da, na);
+	VERIFY(iprod == 55 && isum == 55 && fsum == 55.0f && dsum == 55.0);
+
+	/* whole numbers are exact in every order, each tail length */
+	bool ok = true;
+	for (size_t count = 0; count < REDUCE_TEST_MAX; count++) {
+		int64_t expect = 0;
+		for (size_t i = 0; i < count; i++) {
+			reduce_ints[i] = (int)(i * 7) - 500;
+			reduce_floats[i] = (float)reduce_ints[i];
+			double_buf[i] = reduce_ints[i];
+			expect += reduce_ints[i];
+		}
+		ok = ok && sum_int(reduce_ints, count) == expect;
+		ok = ok && sum_float(reduce_floats, count) == (float)expect;
+		ok = ok && sum_double(double_buf, count) == (double)expect;
+		ok = ok && sum_float_kahan(reduce_floats, count) ==
+				   (float)expect;
+		ok = ok && sum_double_kahan(double_buf, count) ==
+				   (double)expect;
+	}
+	VERIFY(ok);
+
+	for (size_t i = 0; i < REDUCE_COUNT; i++)
+		reduce_floats[i] = 0.1f;
+	double ref = (double)0.1f * REDUCE_COUNT;
+	double naive_err = fabs(naive_sum(reduce_floats, REDUCE_COUNT) - ref);
+	double pair_err = fabs(sum_float(reduce_floats, REDUCE_COUNT) - ref);
+	double kahan_err = fabs(sum_float_kahan(reduce_floats, REDUCE_COUNT) -
+				ref);
+	printf("0.1f x %d relative error naive %g pairwise %g kahan %g\n",
+	       REDUCE_COUNT, naive_err / ref, pair_err / ref, kahan_err / ref);
+	VERIFY(pair_err < naive_err && kahan_err < naive_err);
+	VERIFY(kahan_err / ref < FLT_EPSILON);
+
+	/* 1e8f is 8 apart from the next float, naive adds of 1 are lost */
+	reduce_floats[0] = 1e8f;
+	for (size_t i = 1; i < REDUCE_COUNT; i++)
+		reduce_floats[i] = 1.0f;
+	ref = 1e8 + (REDUCE_COUNT - 1);
+	naive_err = fabs(naive_sum(reduce_floats, REDUCE_COUNT) - ref);
+	kahan_err = fabs(sum_float_kahan(reduce_floats, REDUCE_COUNT) - ref);
+	VERIFY(naive_err >= REDUCE_COUNT - 1 && kahan_err <= 4.0);
+
+	/* the big terms cancel, plain Kahan would lose the ones */
+	double cancel[] = {1.0, 1e100, 1.0, -1e100, 1.0};
+	dsum = sum_double_kahan(cancel, _countof(cancel));
+	VERIFY(dsum == 3.0);
+	PASSED(__func__, __LINE__);
+}
+/* REDUCE_COUNT elements: the accumulate callback and plain loops against
+   the typed reductions */
+void reduce_bench()
+{
+	TC_BEGIN(__func__);
+	int *reduce_ints = shared.reduce.ints;
+	float *reduce_floats = shared.reduce.floats;
+	for (size_t i = 0; i < REDUCE_COUNT; i++) {
+		reduce_ints[i] = rand() % 1000;
+		reduce_floats[i] = (float)(rand() % 1000) * 0.001f;
+	}
+	uint64_t acc_ticks = 0, isum_ticks = 0, loop_ticks = 0, fsum_ticks = 0;
+	uint64_t kahan_ticks = 0, dot_loop_ticks = 0, dot_ticks = 0;
+	bool ok = true;
+	for (int r = 0; r < REDUCE_ROUNDS; r++) {
+		uint64_t t0 = bench_now();
+		int acc = accumulate(reduce_ints, REDUCE_COUNT, sizeof(int),
+				     ret_int);
+		acc_ticks += bench_now() - t0;
+		t0 = bench_now();
+		int64_t isum = sum_int(reduce_ints, REDUCE_COUNT);
+		isum_ticks += bench_now() - t0;
+		ok = ok && isum == acc;
+
+		t0 = bench_now();
+		float loop = naive_sum(reduce_floats, REDUCE_COUNT);
+		loop_ticks += bench_now() - t0;
+		t0 = bench_now();
+		float fsum = sum_float(reduce_floats, REDUCE_COUNT);
+		fsum_ticks += bench_now() - t0;
+		t0 = bench_now();
+		float kahan = sum_float_kahan(reduce_floats, REDUCE_COUNT);
+		kahan_ticks += bench_now() - t0;
+		ok = ok && fabsf(fsum - kahan) <= fabsf(kahan) * 1e-6f;
+		ok = ok && fabsf(loop - kahan) <= fabsf(kahan) * 1e-3f;
+
+		t0 = bench_now();
+		float dot_loop = 0.0f;
+		for (size_t i = 0; i < REDUCE_COUNT; i++)
+			dot_loop += reduce_floats[i] * reduce_floats[i];
+		dot_loop_ticks += bench_now() - t0;
+		t0 = bench_now();
+		float dot = dot_float(reduce_floats, reduce_floats,
+				      REDUCE_COUNT);
+		dot_ticks += bench_now() - t0;
+		ok = ok && fabsf(dot - dot_loop) <= dot * 1e-3f;
+	}
+	VERIFY(ok);
+	const uint64_t ops = (uint64_t)REDUCE_COUNT * REDUCE_ROUNDS;
+	BENCH_REPORT("accumulate int callback", acc_ticks, ops);
+	BENCH_REPORT("sum_int", isum_ticks, ops);
+	BENCH_REPORT("float loop", loop_ticks, ops);
+	BENCH_REPORT("sum_float", fsum_ticks, ops);
+	BENCH_REPORT("sum_float_kahan", kahan_ticks, ops);
+	BENCH_REPORT("float dot loop", dot_loop_ticks, ops);
+	BENCH_REPORT("dot_float", dot_ticks, ops);
+	PASSED(__func__, __LINE__);
+}
+void fill_pattern(int *a, const size_t count, const int pattern)
+{
+	for (size_t i = 0; i < count; i++)
+		switch (pattern) {
+		case 0:
+			a[i] = (int)i;
+			break;
+		case 1:
+			a[i] = (int)(count - i);
+			break;
+		case 2:
+			a[i] = rand();
+			break;
+		case 3:
+			a[i] = rand() % 4;
+			break;
+		default:
+			a[i] = (int)(i < count / 2 ? i : count - i);
+			break;
+		}
+}
 // often used print integer array
 void print_int_array(int *arr, const size_t count)
 {
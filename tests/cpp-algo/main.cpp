@@ -0,0 +1,322 @@
+#include "precompile.h"
+#include "harness.h"
+#include "bench.h"
+#include "algo.h"
+#include "functor.h"
+#include "heap.h"
+#include "algo.hpp"
+
+#define TEST_COUNT 1000
+#define BENCH_COUNT 2000
+#define BENCH_ROUNDS 5
+
+// test data
+static int a[] = {9, 8, 7, 6, 5, 4, 3, 2, 1, 0};
+static student recs[] = {{"Joe", 2.0},   {"Mary", 4.0},  {"Larry", 3.5},
+			 {"Moe", 3.0},   {"Harry", 3.5}, {"Mary", 2.0},
+			 {"Jill", 4.0},  {"Jerry", 2.9}, {"Mike", 3.5},
+			 {"Harry", 3.0}, {"Abel", 3.5},  {"Abel", 2.0}};
+static int buf[BENCH_COUNT];
+static int ref[BENCH_COUNT];
+static int out[2 * BENCH_COUNT];
+static const char *patterns[] = {"sorted", "reversed", "random",
+				 "few unique", "organ pipe"};
+
+// the genptr functors from functor.h are what the C algorithms call
+static void double_genint(const genptr src, genptr dest)
+{
+	*(int *)dest = *(const int *)src * 2;
+}
+
+// test helper
+void fill_pattern(int *a, const size_t count, const size_t pattern);
+bool sorted(const int *a, const size_t count);
+
+// test functions
+void sort_test();
+void search_test();
+void transform_accumulate_test();
+void count_if_replace_test();
+void merge_reverse_test();
+void sort_bench();
+void search_bench();
+void linear_bench();
+
+int main()
+{
+	PROJECT_BANNER("C++ ALGORITHMS, cppinc templates against the genptr versions");
+	long heap_status = Heap_Init();
+	VERIFY(heap_status == HEAP_OK);
+	bench_init();
+	sort_test();
+	search_test();
+	transform_accumulate_test();
+	count_if_replace_test();
+	merge_reverse_test();
+	sort_bench();
+	search_bench();
+	linear_bench();
+	REPORT("emb C++-Algo");
+}
+
+/*-----------------------------------------------------------------------------
+ the same engine as gensort, every pattern and a custom comparator
+-----------------------------------------------------------------------------*/
+void sort_test()
+{
+	TC_BEGIN(__func__);
+	mlibs::sort(a, _countof(a));
+	VERIFY(sorted(a, _countof(a)));
+
+	for (size_t pat = 0; pat < _countof(patterns); pat++) {
+		for (size_t n = 0; n <= TEST_COUNT; n += 1 + n / 3) {
+			fill_pattern(buf, n, pat);
+			memcpy(ref, buf, n * sizeof(int));
+			mlibs::sort(buf, n);
+			gensort(ref, n, sizeof(int), int_genless, int_genswap);
+			VERIFY(memcmp(buf, ref, n * sizeof(int)) == 0);
+		}
+	}
+
+	fill_pattern(buf, TEST_COUNT, 2);
+	mlibs::sort(buf, TEST_COUNT, std::greater<int>{});
+	bool desc = true;
+	for (size_t i = 1; i < TEST_COUNT; i++)
+		desc = desc && buf[i - 1] >= buf[i];
+	VERIFY(desc);
+
+	mlibs::sort(recs, _countof(recs), [](const student &x, const student &y) {
+		return x.gpa < y.gpa;
+	});
+	bool by_gpa = true;
+	for (size_t i = 1; i < _countof(recs); i++)
+		by_gpa = by_gpa && recs[i - 1].gpa <= recs[i].gpa;
+	VERIFY(by_gpa);
+	PASSED(__func__, __LINE__);
+}
+void search_test()
+{
+	TC_BEGIN(__func__);
+	for (size_t i = 0; i < TEST_COUNT; i++)
+		buf[i] = (int)(2 * i);
+
+	int *p = mlibs::search(buf, 500, TEST_COUNT);
+	VERIFY(p && *p == 500);
+	VERIFY(mlibs::search(buf, 501, TEST_COUNT) == nullptr);
+	VERIFY(mlibs::search(buf, -1, TEST_COUNT) == nullptr);
+	VERIFY(mlibs::search(buf, 2 * TEST_COUNT, TEST_COUNT) == nullptr);
+	VERIFY(mlibs::search(buf, 0, 0) == nullptr);
+
+	bool agree = true;
+	for (int key = 0; key <= 2 * TEST_COUNT; key++) {
+		int *t = mlibs::search(buf, key, TEST_COUNT);
+		int *c = (int *)gensearch(buf, &key, 0, TEST_COUNT - 1,
+					  sizeof(int), int_gencmp);
+		agree = agree && (t == nullptr) == (c == nullptr) &&
+			(t == nullptr || *t == *c);
+	}
+	VERIFY(agree);
+	PASSED(__func__, __LINE__);
+}
+void transform_accumulate_test()
+{
+	TC_BEGIN(__func__);
+	for (size_t i = 0; i < TEST_COUNT; i++)
+		buf[i] = (int)i - TEST_COUNT / 2;
+
+	mlibs::transform(out, buf, TEST_COUNT, [](int x) { return 2 * x; });
+	transform(ref, buf, TEST_COUNT, sizeof(int), double_genint);
+	VERIFY(memcmp(out, ref, TEST_COUNT * sizeof(int)) == 0);
+
+	int sum = mlibs::accumulate(buf, TEST_COUNT);
+	VERIFY(sum == accumulate(buf, TEST_COUNT, sizeof(int), ret_genint));
+	long long wide = mlibs::accumulate(buf, TEST_COUNT, 0LL);
+	VERIFY(wide == sum);
+	double gpas = mlibs::accumulate(recs, _countof(recs), 0.0,
+					[](double acc, const student &s) {
+						return acc + s.gpa;
+					});
+	VERIFY(gpas > 36.8 && gpas < 37.0);
+
+	long visited = 0;
+	mlibs::visit(buf, TEST_COUNT, [&visited](int x) { visited += x; });
+	VERIFY(visited == sum);
+	PASSED(__func__, __LINE__);
+}
+void count_if_replace_test()
+{
+	TC_BEGIN(__func__);
+	fill_pattern(buf, TEST_COUNT, 3);
+	auto even = [](int x) { return (x & 1) == 0; };
+	VERIFY(mlibs::count_if(buf, TEST_COUNT, even) ==
+	       count_if(buf, TEST_COUNT, sizeof(int), is_geneven));
+
+	int oldval = 1, newval = 7;
+	memcpy(ref, buf, TEST_COUNT * sizeof(int));
+	mlibs::replace(buf, TEST_COUNT, oldval, newval);
+	replace(ref, &oldval, &newval, TEST_COUNT, sizeof(int), int_gencmp);
+	VERIFY(memcmp(buf, ref, TEST_COUNT * sizeof(int)) == 0);
+	VERIFY(mlibs::count_if(buf, TEST_COUNT,
+			       [](int x) { return x == 1; }) == 0);
+
+	mlibs::replace_if(buf, TEST_COUNT, even, 5);
+	VERIFY(mlibs::count_if(buf, TEST_COUNT, even) == 0);
+	PASSED(__func__, __LINE__);
+}
+void merge_reverse_test()
+{
+	TC_BEGIN(__func__);
+	const size_t n1 = TEST_COUNT / 3, n2 = TEST_COUNT - n1;
+	fill_pattern(buf, TEST_COUNT, 3);
+	mlibs::sort(buf, n1);
+	mlibs::sort(buf + n1, n2);
+
+	mlibs::merge(out, buf, n1, buf + n1, n2);
+	merge_ranges(ref, buf, n1, buf + n1, n2, sizeof(int), int_genless);
+	VERIFY(memcmp(out, ref, TEST_COUNT * sizeof(int)) == 0);
+	VERIFY(sorted(out, TEST_COUNT));
+	mlibs::merge(out, buf, 0, buf + n1, n2);
+	VERIFY(memcmp(out, buf + n1, n2 * sizeof(int)) == 0);
+
+	memcpy(ref, out, TEST_COUNT * sizeof(int));
+	mlibs::reverse(out, TEST_COUNT);
+	reverse(ref, TEST_COUNT, sizeof(int), int_genswap);
+	VERIFY(memcmp(out, ref, TEST_COUNT * sizeof(int)) == 0);
+	mlibs::reverse(out, 0);
+	mlibs::reverse(out, 1);
+	PASSED(__func__, __LINE__);
+}
+/*-----------------------------------------------------------------------------
+ benchmarks, the same work through the genptr C versions and the templates
+-----------------------------------------------------------------------------*/
+void sort_bench()
+{
+	TC_BEGIN(__func__);
+	char label[48];
+	const int ops = BENCH_ROUNDS * BENCH_COUNT;
+	for (size_t pat = 0; pat < _countof(patterns); pat++) {
+		uint64_t c_ticks = 0, t_ticks = 0;
+		for (int r = 0; r < BENCH_ROUNDS; r++) {
+			fill_pattern(buf, BENCH_COUNT, pat);
+			uint64_t t0 = bench_now();
+			gensort(buf, BENCH_COUNT, sizeof(int), int_genless,
+				int_genswap);
+			c_ticks += bench_now() - t0;
+
+			fill_pattern(buf, BENCH_COUNT, pat);
+			t0 = bench_now();
+			mlibs::sort(buf, BENCH_COUNT);
+			t_ticks += bench_now() - t0;
+			VERIFY(sorted(buf, BENCH_COUNT));
+		}
+		snprintf(label, sizeof(label), "gensort %s", patterns[pat]);
+		BENCH_REPORT(label, c_ticks, ops);
+		snprintf(label, sizeof(label), "mlibs::sort %s", patterns[pat]);
+		BENCH_REPORT(label, t_ticks, ops);
+	}
+	PASSED(__func__, __LINE__);
+}
+void search_bench()
+{
+	TC_BEGIN(__func__);
+	for (size_t i = 0; i < BENCH_COUNT; i++)
+		buf[i] = (int)(2 * i);
+
+	size_t c_found = 0, t_found = 0;
+	uint64_t t0 = bench_now();
+	for (int key = 0; key < 2 * BENCH_COUNT; key++)
+		c_found += gensearch(buf, &key, 0, BENCH_COUNT - 1,
+				     sizeof(int), int_gencmp) != NULL;
+	uint64_t c_ticks = bench_now() - t0;
+
+	t0 = bench_now();
+	for (int key = 0; key < 2 * BENCH_COUNT; key++)
+		t_found += mlibs::search(buf, key, BENCH_COUNT) != nullptr;
+	uint64_t t_ticks = bench_now() - t0;
+
+	const int ops = 2 * BENCH_COUNT;
+	VERIFY(c_found == BENCH_COUNT);
+	VERIFY(t_found == BENCH_COUNT);
+	BENCH_REPORT("gensearch", c_ticks, ops);
+	BENCH_REPORT("mlibs::search", t_ticks, ops);
+	PASSED(__func__, __LINE__);
+}
+void linear_bench()
+{
+	TC_BEGIN(__func__);
+	fill_pattern(buf, BENCH_COUNT, 3);
+	const int ops = BENCH_ROUNDS * BENCH_COUNT;
+	uint64_t t0, c_ticks = 0, t_ticks = 0;
+	size_t c_count = 0, t_count = 0;
+	int c_sum = 0, t_sum = 0;
+
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		t0 = bench_now();
+		c_count += count_if(buf, BENCH_COUNT, sizeof(int), is_geneven);
+		c_ticks += bench_now() - t0;
+		t0 = bench_now();
+		t_count += mlibs::count_if(buf, BENCH_COUNT,
+					   [](int x) { return (x & 1) == 0; });
+		t_ticks += bench_now() - t0;
+	}
+	VERIFY(c_count == t_count);
+	BENCH_REPORT("count_if", c_ticks, ops);
+	BENCH_REPORT("mlibs::count_if", t_ticks, ops);
+
+	c_ticks = t_ticks = 0;
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		t0 = bench_now();
+		c_sum += accumulate(buf, BENCH_COUNT, sizeof(int), ret_genint);
+		c_ticks += bench_now() - t0;
+		t0 = bench_now();
+		t_sum += mlibs::accumulate(buf, BENCH_COUNT);
+		t_ticks += bench_now() - t0;
+	}
+	VERIFY(c_sum == t_sum);
+	BENCH_REPORT("accumulate", c_ticks, ops);
+	BENCH_REPORT("mlibs::accumulate", t_ticks, ops);
+
+	c_ticks = t_ticks = 0;
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		t0 = bench_now();
+		transform(ref, buf, BENCH_COUNT, sizeof(int), double_genint);
+		c_ticks += bench_now() - t0;
+		t0 = bench_now();
+		mlibs::transform(out, buf, BENCH_COUNT,
+				 [](int x) { return 2 * x; });
+		t_ticks += bench_now() - t0;
+	}
+	VERIFY(memcmp(out, ref, BENCH_COUNT * sizeof(int)) == 0);
+	BENCH_REPORT("transform", c_ticks, ops);
+	BENCH_REPORT("mlibs::transform", t_ticks, ops);
+	PASSED(__func__, __LINE__);
+}
+
+void fill_pattern(int *a, const size_t count, const size_t pattern)
+{
+	for (size_t i = 0; i < count; i++)
+		switch (pattern) {
+		case 0:
+			a[i] = (int)i;
+			break;
+		case 1:
+			a[i] = (int)(count - i);
+			break;
+		case 2:
+			a[i] = rand();
+			break;
+		case 3:
+			a[i] = rand() % 4;
+			break;
+		default:
+			a[i] = (int)(i < count / 2 ? i : count - i);
+			break;
+		}
+}
+bool sorted(const int *a, const size_t count)
+{
+	for (size_t i = 1; i < count; i++)
+		if (a[i] < a[i - 1])
+			return false;
+	return true;
+}
@@ -0,0 +1,242 @@
+#include "precompile.h"
+#include "harness.h"
+#include "bench.h"
+#include "heap.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+#define MAX_THREADS 64
+#define THREAD_OPS 200000
+#define LIVE_BLOCKS 64
+#define LOCKED_REGION_BYTES (HEAP_SIZE_BYTES / 2)
+
+#ifndef NL
+#define NL printf("\n")
+#endif
+
+// test data
+typedef struct worker {
+	pthread_t tid;
+	int id;
+	bool cached;
+	long errors;
+} worker;
+
+static worker workers[MAX_THREADS];
+static long locked_region[LOCKED_REGION_BYTES / sizeof(long)];
+static heap_t locked_heap;
+static pthread_mutex_t locked_heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// test helper
+void dummy();
+uint64_t run_workers(const int nthreads, const bool cached);
+
+// test functions
+void heap_mt_integrity_test();
+void heap_mt_double_free_test();
+void heap_mt_scaling_bench();
+
+int main()
+{
+	PROJECT_BANNER("HEAP-MT, Concurrent Heap with Per-Thread Caches");
+	bench_init();
+	heap_mt_integrity_test();
+	heap_mt_double_free_test();
+	heap_mt_scaling_bench();
+	REPORT("host Heap-MT");
+	dummy();
+}
+
+/*-----------------------------------------------------------------------------
+ Helpers
+-----------------------------------------------------------------------------*/
+void dummy()
+{
+	int x = 0;
+	x++;
+}
+/* the baseline: every malloc and free takes one global lock */
+static void *locked_malloc(long bytes)
+{
+	pthread_mutex_lock(&locked_heap_lock);
+	void *p = Heap_MallocIn(&locked_heap, bytes);
+	pthread_mutex_unlock(&locked_heap_lock);
+	return p;
+}
+static void locked_free(void *p)
+{
+	pthread_mutex_lock(&locked_heap_lock);
+	Heap_FreeIn(&locked_heap, p);
+	pthread_mutex_unlock(&locked_heap_lock);
+}
+/* keep a window of live small blocks, replace one per step, check that no
+ * other thread wrote into ours */
+static void *worker_main(void *arg)
+{
+	worker *w = arg;
+	void *(*alloc)(long) = w->cached ? Heap_Malloc : locked_malloc;
+	long *live[LIVE_BLOCKS] = {0};
+	unsigned seed = w->id * 2654435761u + 1;
+	for (int i = 0; i < THREAD_OPS; i++) {
+		seed = seed * 1103515245u + 12345u;
+		int slot = (seed >> 16) % LIVE_BLOCKS;
+		long words = 1 + (seed >> 8) % 6;
+		if (live[slot]) {
+			if (live[slot][0] != w->id)
+				w->errors++;
+			if (w->cached)
+				Heap_Free(live[slot]);
+			else
+				locked_free(live[slot]);
+		}
+		live[slot] = alloc(words * sizeof(long));
+		if (live[slot] == NULL) {
+			w->errors++;
+			continue;
+		}
+		live[slot][0] = w->id;
+	}
+	for (int i = 0; i < LIVE_BLOCKS; i++) {
+		if (!live[i])
+			continue;
+		if (w->cached)
+			Heap_Free(live[i]);
+		else
+			locked_free(live[i]);
+	}
+	return NULL;
+}
+uint64_t run_workers(const int nthreads, const bool cached)
+{
+	uint64_t start = bench_now();
+	for (int i = 0; i < nthreads; i++) {
+		workers[i].id = i + 1;
+		workers[i].cached = cached;
+		workers[i].errors = 0;
+		pthread_create(&workers[i].tid, NULL, worker_main, &workers[i]);
+	}
+	for (int i = 0; i < nthreads; i++)
+		pthread_join(workers[i].tid, NULL);
+	return bench_now() - start;
+}
+/*-----------------------------------------------------------------------------
+ Tests
+-----------------------------------------------------------------------------*/
+/* caches are given back when the threads exit, nothing leaks or overlaps */
+void heap_mt_integrity_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	run_workers(4, true);
+	for (int i = 0; i < 4; i++)
+		VERIFY(workers[i].errors == 0);
+	Heap_ThreadFlush();
+	long ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	heap_stats_t s = Heap_Stats();
+	VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+
+	/* the main thread's cache */
+	void *p = Heap_Malloc(sizeof(long));
+	ret = Heap_Free(p);
+	VERIFY(ret == HEAP_OK);
+	s = Heap_Stats();
+	VERIFY(s.blocksUsed > 0);
+	Heap_ThreadFlush();
+	s = Heap_Stats();
+	VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+
+	/* errors still reach the heap */
+	ret = Heap_Free(p);
+	VERIFY(ret == HEAP_ERROR_CORRUPTED_HEAP);
+	ret = Heap_Free(&ret);
+	VERIFY(ret == HEAP_ERROR_POINTER_OUT_OF_RANGE);
+	PASSED(__func__, __LINE__);
+}
+/* a block already in a cache is refused, from its own thread or another,
+   and is handed out once */
+static void *free_other_thread(void *p)
+{
+	return (void *)Heap_Free(p);
+}
+void heap_mt_double_free_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	void *p = Heap_Malloc(sizeof(long));
+	long ret = Heap_Free(p);
+	VERIFY(ret == HEAP_OK);
+	ret = Heap_Free(p);
+	VERIFY(ret == HEAP_ERROR_CORRUPTED_HEAP);
+	pthread_t tid;
+	void *status;
+	pthread_create(&tid, NULL, free_other_thread, p);
+	pthread_join(tid, &status);
+	VERIFY((long)status == HEAP_ERROR_CORRUPTED_HEAP);
+
+	void *a = Heap_Malloc(sizeof(long));
+	void *b = Heap_Malloc(sizeof(long));
+	VERIFY(a == p && b != a);
+	ret = Heap_Free(a);
+	VERIFY(ret == HEAP_OK);
+	ret = Heap_Free(b);
+	VERIFY(ret == HEAP_OK);
+	Heap_ThreadFlush();
+	heap_stats_t s = Heap_Stats();
+	VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+
+	/* a block cached before Heap_Init is a new block afterwards */
+	p = Heap_Malloc(sizeof(long));
+	ret = Heap_Free(p);
+	VERIFY(ret == HEAP_OK);
+	Heap_Init();
+	a = Heap_Malloc(sizeof(long));
+	ret = Heap_Free(a);
+	VERIFY(ret == HEAP_OK);
+	Heap_ThreadFlush();
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	PASSED(__func__, __LINE__);
+}
+void heap_mt_scaling_bench()
+{
+	TC_BEGIN(__func__);
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int maxthreads = cores * 2 < MAX_THREADS ? cores * 2 : MAX_THREADS;
+	uint64_t base_locked = 0, base_cached = 0;
+	char label[64];
+	printf("%ld cores\n", cores);
+	for (int n = 1; n <= maxthreads; n *= 2) {
+		Heap_InitRegion(&locked_heap, locked_region, sizeof(locked_region));
+		uint64_t locked = run_workers(n, false);
+		for (int i = 0; i < n; i++)
+			VERIFY(workers[i].errors == 0);
+		long ret = Heap_TestIn(&locked_heap);
+		VERIFY(ret == HEAP_OK);
+
+		Heap_Init();
+		uint64_t cached = run_workers(n, true);
+		for (int i = 0; i < n; i++)
+			VERIFY(workers[i].errors == 0);
+		ret = Heap_Test();
+		VERIFY(ret == HEAP_OK);
+
+		if (n == 1) {
+			base_locked = locked;
+			base_cached = cached;
+		}
+		sprintf(label, "global lock %2d threads", n);
+		BENCH_REPORT(label, locked, (uint64_t)n * THREAD_OPS);
+		sprintf(label, "thread cache %2d threads", n);
+		BENCH_REPORT(label, cached, (uint64_t)n * THREAD_OPS);
+		/* throughput relative to one thread, n is ideal */
+		printf("  %2d threads speedup: global lock %.2f, thread cache %.2f\n",
+		       n, (double)base_locked * n / locked,
+		       (double)base_cached * n / cached);
+	}
+	PASSED(__func__, __LINE__);
+}
+#pragma GCC diagnostic pop
@@ -0,0 +1,294 @@
+#include "precompile.h"
+#include "harness.h"
+#include "bench.h"
+#include "heap.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+#define SYNTHETIC_OPS 20000
+#define SYNTHETIC_LIVE 128
+#define REPLAY_ROUNDS 5
+#define REPLAY_REGION_BYTES (4 * HEAP_SIZE_BYTES)
+
+#ifndef NL
+#define NL printf("\n")
+#endif
+
+// test data
+typedef struct trace_op {
+	unsigned char op;
+	unsigned long block;
+	unsigned long size;
+	unsigned long newblock;
+} trace_op;
+
+typedef struct replay_result {
+	uint64_t ticks;
+	long highwater;
+	long frag_mean;
+	long frag_max;
+	long failed;
+	long moved;
+} replay_result;
+
+static const char *policy_names[HEAP_POLICY_COUNT] = {"tlsf", "first fit",
+						      "next fit", "best fit"};
+static long replay_region[REPLAY_REGION_BYTES / sizeof(long)];
+static heap_t replay_heap;
+
+// test helper
+void dummy();
+size_t record_synthetic(void);
+size_t trace_decode(const unsigned char *trace, const size_t bytes,
+		    trace_op *ops, unsigned long *maxblock);
+replay_result replay(const trace_op *ops, const size_t count, void **blocks,
+		     const long policy, const size_t regionbytes,
+		     const bool sample);
+
+// test functions
+void trace_record_test();
+void replay_bench(const unsigned char *trace, const size_t bytes,
+		  size_t regionbytes);
+
+int main(int argc, char *argv[])
+{
+	PROJECT_BANNER("HEAP-REPLAY, Allocation Trace Replay across Fit Policies");
+	bench_init();
+	if (argc > 1) {
+		FILE *f = fopen(argv[1], "rb");
+		if (f == NULL) {
+			printf("can't open %s\n", argv[1]);
+			return 1;
+		}
+		static unsigned char trace[HEAP_TRACE_BYTES];
+		size_t bytes = fread(trace, 1, sizeof(trace), f);
+		fclose(f);
+		size_t regionbytes = argc > 2 ? strtoul(argv[2], NULL, 0)
+					      : REPLAY_REGION_BYTES;
+		replay_bench(trace, bytes, regionbytes);
+	} else {
+		trace_record_test();
+		size_t bytes;
+		const unsigned char *trace = Heap_TraceData(&bytes);
+		replay_bench(trace, bytes, REPLAY_REGION_BYTES);
+	}
+	REPORT("host Heap-Replay");
+	dummy();
+}
+
+/*-----------------------------------------------------------------------------
+ Helpers
+-----------------------------------------------------------------------------*/
+void dummy()
+{
+	int x = 0;
+	x++;
+}
+/* list nodes, a few big buffers and some growing arrays, the mix the
+ * containers produce */
+size_t record_synthetic(void)
+{
+	void *live[SYNTHETIC_LIVE] = {0};
+	long sizes[SYNTHETIC_LIVE] = {0};
+	size_t ops = 0;
+	Heap_Init();
+	srand(20081);
+	while (ops < SYNTHETIC_OPS) {
+		int k = rand() % SYNTHETIC_LIVE;
+		int kind = rand() % 16;
+		if (live[k] && kind < 2) {
+			sizes[k] += 16 + rand() % 64;
+			void *p = Heap_Realloc(live[k], sizes[k]);
+			if (p)
+				live[k] = p;
+		} else if (live[k]) {
+			Heap_Free(live[k]);
+			live[k] = NULL;
+		} else {
+			sizes[k] = kind == 15 ? 256 + rand() % 1792 : 8 + rand() % 40;
+			live[k] = Heap_Malloc(sizes[k]);
+		}
+		ops++;
+	}
+	for (int k = 0; k < SYNTHETIC_LIVE; k++)
+		if (live[k]) {
+			Heap_Free(live[k]);
+			ops++;
+		}
+	return ops;
+}
+static const unsigned char *read_field(const unsigned char *p,
+				       const unsigned char *end,
+				       unsigned long *value)
+{
+	int shift = 0;
+	*value = 0;
+	while (p < end) {
+		*value |= (unsigned long)(*p & 0x7f) << shift;
+		shift += 7;
+		if ((*p++ & 0x80) == 0)
+			return p;
+	}
+	return NULL;
+}
+/* returns the number of records, 0 if the trace is malformed */
+size_t trace_decode(const unsigned char *trace, const size_t bytes,
+		    trace_op *ops, unsigned long *maxblock)
+{
+	const unsigned char *p = trace;
+	const unsigned char *end = trace + bytes;
+	size_t count = 0;
+	*maxblock = 0;
+	while (p && p < end) {
+		trace_op *t = &ops[count];
+		t->op = *p++;
+		t->block = t->size = t->newblock = 0;
+		if (t->op == HEAP_TRACE_FREE || t->op == HEAP_TRACE_REALLOC)
+			p = read_field(p, end, &t->block);
+		if (p && t->op != HEAP_TRACE_FREE) {
+			p = read_field(p, end, &t->size);
+			if (p)
+				p = read_field(p, end, &t->newblock);
+		}
+		if (p == NULL || t->op < HEAP_TRACE_MALLOC ||
+		    t->op > HEAP_TRACE_REALLOC)
+			return 0;
+		if (t->block > *maxblock)
+			*maxblock = t->block;
+		if (t->newblock > *maxblock)
+			*maxblock = t->newblock;
+		count++;
+	}
+	return count;
+}
+/* blocks maps a recorded block to the live replayed one.  Calls that failed
+ * when recorded are skipped.  moved counts blocks placed at another offset
+ * than recorded. */
+replay_result replay(const trace_op *ops, const size_t count, void **blocks,
+		     const long policy, const size_t regionbytes,
+		     const bool sample)
+{
+	replay_result r = {0};
+	long fragsum = 0;
+	long samples = 0;
+	Heap_InitRegion(&replay_heap, replay_region, regionbytes);
+	Heap_SetPolicyIn(&replay_heap, policy);
+	uint64_t start = bench_now();
+	for (size_t i = 0; i < count; i++) {
+		const trace_op *t = &ops[i];
+		void *p;
+		switch (t->op) {
+		case HEAP_TRACE_MALLOC:
+			if (t->newblock == 0)
+				continue;
+			p = Heap_MallocIn(&replay_heap, t->size);
+			blocks[t->newblock] = p;
+			break;
+		case HEAP_TRACE_FREE:
+			if (blocks[t->block])
+				Heap_FreeIn(&replay_heap, blocks[t->block]);
+			blocks[t->block] = NULL;
+			p = NULL;
+			break;
+		default:
+			if (t->newblock == 0 || blocks[t->block] == NULL)
+				continue;
+			p = Heap_ReallocIn(&replay_heap, blocks[t->block], t->size);
+			if (p == NULL)
+				continue;
+			blocks[t->block] = NULL;
+			blocks[t->newblock] = p;
+			break;
+		}
+		if (!sample)
+			continue;
+		if (p && (long *)p - replay_heap.start != (long)t->newblock)
+			r.moved++;
+		heap_telemetry_t tm = Heap_TelemetryIn(&replay_heap);
+		fragsum += tm.fragmentation;
+		samples++;
+		if (tm.fragmentation > r.frag_max)
+			r.frag_max = tm.fragmentation;
+	}
+	r.ticks = bench_now() - start;
+	heap_telemetry_t tm = Heap_TelemetryIn(&replay_heap);
+	r.highwater = tm.highWaterBytes;
+	r.failed = tm.failedMallocs;
+	r.frag_mean = samples ? fragsum / samples : 0;
+	return r;
+}
+/*-----------------------------------------------------------------------------
+ Tests
+-----------------------------------------------------------------------------*/
+/* a synthetic trace decodes and replays to the very same offsets on the
+ * policy and heap size it was recorded with */
+void trace_record_test()
+{
+	TC_BEGIN(__func__);
+	size_t recorded = record_synthetic();
+	size_t bytes;
+	const unsigned char *trace = Heap_TraceData(&bytes);
+	VERIFY(trace != NULL && bytes > 0 && bytes < HEAP_TRACE_BYTES);
+	printf("%zu calls, %zu trace bytes, %.2f bytes per call\n", recorded,
+	       bytes, (double)bytes / recorded);
+
+	trace_op *ops = malloc(recorded * sizeof(trace_op));
+	unsigned long maxblock;
+	size_t count = trace_decode(trace, bytes, ops, &maxblock);
+	VERIFY(count == recorded);
+	VERIFY(maxblock <= HEAP_SIZE_WORDS);
+	void **blocks = calloc(maxblock + 1, sizeof(void *));
+	replay_result r = replay(ops, count, blocks, HEAP_POLICY_TLSF,
+				 HEAP_SIZE_BYTES, true);
+	VERIFY(r.moved == 0);
+	VERIFY(r.failed == Heap_Telemetry().failedMallocs);
+	long ret = Heap_TestIn(&replay_heap);
+	VERIFY(ret == HEAP_OK);
+	heap_stats_t s = Heap_StatsIn(&replay_heap);
+	VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+
+	ret = Heap_TraceSave("heap.trace");
+	VERIFY(ret == HEAP_OK);
+	free(blocks);
+	free(ops);
+	PASSED(__func__, __LINE__);
+}
+void replay_bench(const unsigned char *trace, const size_t bytes,
+		  size_t regionbytes)
+{
+	TC_BEGIN(__func__);
+	if (regionbytes > sizeof(replay_region))
+		regionbytes = sizeof(replay_region);
+	trace_op *ops = malloc((bytes + 1) * sizeof(trace_op));
+	unsigned long maxblock;
+	size_t count = trace_decode(trace, bytes, ops, &maxblock);
+	VERIFY(count > 0);
+	void **blocks = calloc(maxblock + 1, sizeof(void *));
+	printf("%zu operations, replay heap %zu bytes\n", count, regionbytes);
+	for (long policy = 0; policy < HEAP_POLICY_COUNT; policy++) {
+		replay_result r = replay(ops, count, blocks, policy,
+					 regionbytes, true);
+		long ret = Heap_TestIn(&replay_heap);
+		VERIFY(ret == HEAP_OK);
+		uint64_t best = UINT64_MAX;
+		for (int round = 0; round < REPLAY_ROUNDS; round++) {
+			memset(blocks, 0, (maxblock + 1) * sizeof(void *));
+			uint64_t ticks = replay(ops, count, blocks, policy,
+						regionbytes, false).ticks;
+			if (ticks < best)
+				best = ticks;
+		}
+		memset(blocks, 0, (maxblock + 1) * sizeof(void *));
+		BENCH_REPORT(policy_names[policy], best, count);
+		printf("  %-10s peak footprint %7ld bytes, fragmentation mean "
+		       "%3ld.%ld%% max %3ld.%ld%%, failed %ld\n",
+		       policy_names[policy], r.highwater, r.frag_mean / 10,
+		       r.frag_mean % 10, r.frag_max / 10, r.frag_max % 10,
+		       r.failed);
+	}
+	free(blocks);
+	free(ops);
+	PASSED(__func__, __LINE__);
+}
+#pragma GCC diagnostic pop
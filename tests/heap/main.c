@@ -0,0 +1,1247 @@
+#include "precompile.h"
+#include "harness.h"
+#include "bench.h"
+#include "heap.h"
+#include "allocator.h"
+#include "functor.h"
+#include "pool.h"
+#include "arena.h"
+#include "list.h"
+#include "stack.h"
+#include "circ_list.h"
+#include "static_tree.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+#define BENCH_ITERATIONS 1000
+#define MAX_LIVE_BLOCKS (HEAP_SIZE_BYTES / 16)
+#define NODE_COUNT 64
+#define NODE_ROUNDS 50
+#define GROW_STEPS 64
+#define HANDLE_BYTES 200
+#define CHURN_SLOTS 20
+#define CHURN_STEPS 4000
+#define BATCH_COUNT 128
+#define REGION_WORDS 256
+#define REGION_GAP 16
+#define GAP_FILL 0x5a5a5a5aL
+
+#ifndef NL
+#define NL printf("\n")
+#endif
+
+// test data
+static void *live[MAX_LIVE_BLOCKS];
+static const int occupancies[] = {25, 50, 75, 90};
+static int keys[NODE_COUNT];
+
+// test helper
+void dummy();
+size_t heap_fill(const int percent);
+
+// test functions
+void heap_integrity_test();
+void heap_policy_bench();
+void pool_test();
+void pool_throughput_bench();
+void pool_fragmentation_bench();
+void inline_node_test();
+void heap_instance_test();
+void arena_test();
+void realloc_test();
+void realloc_grow_bench();
+void telemetry_test();
+void telemetry_bench();
+void aligned_alloc_test();
+void incremental_check_test();
+void incremental_check_bench();
+void allocator_test();
+void allocator_bench();
+void handle_test();
+void handle_churn_bench();
+void batch_test();
+void region_test();
+void batch_bench();
+
+int main()
+{
+	PROJECT_BANNER("HEAP, Knuth Heap, Segregated Free Lists and Node Pools");
+	bench_init();
+	heap_integrity_test();
+	heap_policy_bench();
+	pool_test();
+	pool_throughput_bench();
+	pool_fragmentation_bench();
+	inline_node_test();
+	heap_instance_test();
+	arena_test();
+	realloc_test();
+	realloc_grow_bench();
+	telemetry_test();
+	telemetry_bench();
+	aligned_alloc_test();
+	incremental_check_test();
+	incremental_check_bench();
+	allocator_test();
+	allocator_bench();
+	handle_test();
+	handle_churn_bench();
+	batch_test();
+	batch_bench();
+	region_test();
+	REPORT("emb Heap");
+	dummy();
+}
+
+/*-----------------------------------------------------------------------------
+Test functions and data
+-----------------------------------------------------------------------------*/
+void dummy()
+{
+	printf("foo");
+}
+/* allocates small mixed size blocks until percent of the heap is in use,
+   then frees every other one so the free space is fragmented */
+size_t heap_fill(const int percent)
+{
+	size_t count = 0;
+	long target = (long)(HEAP_SIZE_WORDS * percent) / 100;
+	while (count < MAX_LIVE_BLOCKS &&
+	       Heap_Stats().wordsAllocated + Heap_Stats().wordsOverhead < target) {
+		live[count] = Heap_Malloc(8 + (long)(count % 4) * 8);
+		if (live[count] == NULL)
+			break;
+		count++;
+	}
+	for (size_t i = 0; i < count; i += 2) {
+		Heap_Free(live[i]);
+		live[i] = NULL;
+	}
+	return count;
+}
+void heap_integrity_test()
+{
+	TC_BEGIN(__func__);
+	const long policies[] = {HEAP_POLICY_TLSF, HEAP_POLICY_FIRST_FIT,
+				 HEAP_POLICY_NEXT_FIT, HEAP_POLICY_BEST_FIT};
+	for (size_t p = 0; p < _countof(policies); p++) {
+		Heap_Init();
+		long ret = Heap_SetPolicy(policies[p]);
+		VERIFY(ret == HEAP_OK);
+		srand(1234567);
+		for (int i = 0; i < 4000; i++) {
+			size_t k = rand() % MAX_LIVE_BLOCKS;
+			if (live[k]) {
+				long ret = Heap_Free(live[k]);
+				VERIFY(ret == HEAP_OK);
+				live[k] = NULL;
+			} else {
+				live[k] = Heap_Malloc(1 + rand() % 96);
+			}
+		}
+		ret = Heap_Test();
+		VERIFY(ret == HEAP_OK);
+		for (size_t k = 0; k < MAX_LIVE_BLOCKS; k++)
+			if (live[k]) {
+				Heap_Free(live[k]);
+				live[k] = NULL;
+			}
+		heap_stats_t s = Heap_Stats();
+		VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+	}
+	long ret = Heap_SetPolicy(99);
+	VERIFY(ret == HEAP_ERROR_BAD_ARGUMENT);
+	Heap_SetPolicy(HEAP_POLICY_TLSF);
+	PASSED(__func__, __LINE__);
+}
+/* malloc/free pairs against a fragmented heap; the request is bigger than
+   any hole so first fit walks every block before it finds the tail */
+void heap_policy_bench()
+{
+	TC_BEGIN(__func__);
+	const long policies[] = {HEAP_POLICY_FIRST_FIT, HEAP_POLICY_TLSF};
+	const char *names[] = {"first fit", "tlsf"};
+	char label[64];
+	for (size_t o = 0; o < _countof(occupancies); o++) {
+		for (size_t p = 0; p < _countof(policies); p++) {
+			Heap_Init();
+			Heap_SetPolicy(policies[p]);
+			size_t count = heap_fill(occupancies[o]);
+			uint64_t start = bench_now();
+			for (int i = 0; i < BENCH_ITERATIONS; i++) {
+				void *big = Heap_Malloc(96);
+				void *small = Heap_Malloc(8);
+				Heap_Free(small);
+				Heap_Free(big);
+			}
+			uint64_t ticks = bench_now() - start;
+			long ret = Heap_Test();
+			VERIFY(ret == HEAP_OK);
+			snprintf(label, sizeof(label), "%s %d%% %u blocks", names[p],
+				 occupancies[o], (unsigned)count);
+			BENCH_REPORT(label, ticks, BENCH_ITERATIONS * 2);
+			memset(live, 0, sizeof(live));
+		}
+	}
+	Heap_SetPolicy(HEAP_POLICY_TLSF);
+	PASSED(__func__, __LINE__);
+}
+void pool_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	poolptr pp = pool_alloc(sizeof(int), 4);
+	int *objs[4];
+	for (int i = 0; i < 4; i++)
+		objs[i] = pool_get(pp);
+	VERIFY(pool_available(pp) == 0);
+	VERIFY(pool_get(pp) == NULL);
+	pool_put(pp, objs[2]);
+	int *again = pool_get(pp);
+	VERIFY(again == objs[2]);
+	for (int i = 0; i < 4; i++)
+		pool_put(pp, objs[i]);
+	VERIFY(pool_available(pp) == 4);
+	pool_free(pp);
+
+	static long buf[64];
+	pp = pool_attach(buf, sizeof(buf), stack_node_size(sizeof(int)));
+	stackptr ps = stack_alloc_pool(sizeof(int), pp);
+	for (int i = 0; i < 10; i++)
+		stack_push(ps, &i);
+	for (int i = 9; i >= 0; i--) {
+		int *top = stack_top(ps);
+		VERIFY(*top == i);
+		stack_pop(ps);
+	}
+	stack_free(ps);
+	pool_detach(pp);
+
+	pp = pool_alloc(slist_node_size(sizeof(int)), NODE_COUNT);
+	slistptr pl = slist_alloc_pool(sizeof(int), pp);
+	for (int i = 0; i < NODE_COUNT; i++)
+		slist_push(pl, &i);
+	VERIFY(pool_available(pp) == 0);
+	slist_visit(pl, print_int);
+	NL;
+	slist_free(pl);
+	VERIFY(pool_available(pp) == NODE_COUNT);
+	pool_free(pp);
+
+	pp = pool_alloc(tree_node_size(), NODE_COUNT);
+	treeptr pt = tree_alloc_pool(int_cmp, true, pp);
+	for (int i = 0; i < NODE_COUNT; i++) {
+		keys[i] = rand() % 100;
+		tree_add(pt, &keys[i]);
+	}
+	tree_visit(pt, in, print_int);
+	tree_free(pt);
+	VERIFY(pool_available(pp) == NODE_COUNT);
+	pool_free(pp);
+
+	heap_stats_t s = Heap_Stats();
+	VERIFY(s.blocksUsed == 0);
+	PASSED(__func__, __LINE__);
+}
+/* fill and drain each container NODE_ROUNDS times, heap nodes vs pool nodes */
+void pool_throughput_bench()
+{
+	TC_BEGIN(__func__);
+	char label[64];
+	for (int pooled = 0; pooled < 2; pooled++) {
+		const char *how = pooled ? "pool" : "heap";
+		Heap_Init();
+		poolptr pp = NULL;
+		if (pooled)
+			pp = pool_alloc(slist_node_size(sizeof(int)), NODE_COUNT);
+
+		slistptr pl = slist_alloc_pool(sizeof(int), pp);
+		uint64_t start = bench_now();
+		for (int r = 0; r < NODE_ROUNDS; r++) {
+			for (int i = 0; i < NODE_COUNT; i++)
+				slist_push(pl, &i);
+			while (!slist_isempty(pl))
+				slist_pop(pl);
+		}
+		uint64_t ticks = bench_now() - start;
+		snprintf(label, sizeof(label), "slist push/pop %s", how);
+		BENCH_REPORT(label, ticks, NODE_ROUNDS * NODE_COUNT * 2);
+		slist_free(pl);
+
+		stackptr ps = stack_alloc_pool(sizeof(int), pp);
+		start = bench_now();
+		for (int r = 0; r < NODE_ROUNDS; r++) {
+			for (int i = 0; i < NODE_COUNT; i++)
+				stack_push(ps, &i);
+			while (!stack_isempty(ps))
+				stack_pop(ps);
+		}
+		ticks = bench_now() - start;
+		snprintf(label, sizeof(label), "stack push/pop %s", how);
+		BENCH_REPORT(label, ticks, NODE_ROUNDS * NODE_COUNT * 2);
+		stack_free(ps);
+
+		start = bench_now();
+		for (int r = 0; r < NODE_ROUNDS; r++) {
+			listptr pc = list_alloc_pool(sizeof(int), pp);
+			for (int i = 0; i < NODE_COUNT; i++)
+				list_add(pc, &i);
+			list_free(pc);
+		}
+		ticks = bench_now() - start;
+		snprintf(label, sizeof(label), "circ_list add/free %s", how);
+		BENCH_REPORT(label, ticks, NODE_ROUNDS * NODE_COUNT * 2);
+		if (pp)
+			pool_free(pp);
+
+		pp = pooled ? pool_alloc(tree_node_size(), NODE_COUNT) : NULL;
+		for (int i = 0; i < NODE_COUNT; i++)
+			keys[i] = rand();
+		start = bench_now();
+		for (int r = 0; r < NODE_ROUNDS; r++) {
+			treeptr pt = tree_alloc_pool(int_cmp, true, pp);
+			for (int i = 0; i < NODE_COUNT; i++)
+				tree_add(pt, &keys[i]);
+			tree_free(pt);
+		}
+		ticks = bench_now() - start;
+		snprintf(label, sizeof(label), "tree add/free %s", how);
+		BENCH_REPORT(label, ticks, NODE_ROUNDS * NODE_COUNT * 2);
+		if (pp)
+			pool_free(pp);
+	}
+	PASSED(__func__, __LINE__);
+}
+/* two lists churn while another subsystem keeps a few odd sized blocks
+   alive in between, then count the free fragments left on the heap */
+void pool_fragmentation_bench()
+{
+	TC_BEGIN(__func__);
+	for (int pooled = 0; pooled < 2; pooled++) {
+		Heap_Init();
+		poolptr pp = NULL;
+		if (pooled)
+			pp = pool_alloc(slist_node_size(sizeof(int)), NODE_COUNT * 2);
+		slistptr l1 = slist_alloc_pool(sizeof(int), pp);
+		slistptr l2 = slist_alloc_pool(sizeof(int), pp);
+		void *other[NODE_COUNT / 8];
+		for (int i = 0; i < NODE_COUNT / 2; i++) {
+			slist_push(l1, &i);
+			slist_push(l2, &i);
+			if (i % 4 == 0)
+				other[i / 4] = Heap_Malloc(12 + i % 24);
+		}
+		while (!slist_isempty(l1))
+			slist_pop(l1);
+		heap_stats_t s = Heap_Stats();
+		printf("BENCH fragmentation %s: free blocks %ld, free words %ld, "
+		       "overhead words %ld\n", pooled ? "pool" : "heap",
+		       s.blocksUnused, s.wordsAvailable, s.wordsOverhead);
+		long ret = Heap_Test();
+		VERIFY(ret == HEAP_OK);
+		for (size_t i = 0; i < _countof(other); i++)
+			Heap_Free(other[i]);
+		slist_free(l1);
+		slist_free(l2);
+		if (pp)
+			pool_free(pp);
+	}
+	PASSED(__func__, __LINE__);
+}
+static long visit_sum;
+static void sum_int(const int *p)
+{
+	visit_sum += *p;
+}
+/* one heap block per element, payload read straight from the node */
+void inline_node_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	slistptr pl = slist_alloc(sizeof(int));
+	listptr pc = list_alloc(sizeof(int));
+	for (int i = 0; i < NODE_COUNT; i++) {
+		slist_push(pl, &i);
+		list_add(pc, &i);
+	}
+	heap_stats_t s = Heap_Stats();
+	VERIFY(s.blocksUsed == 2 + 2 * NODE_COUNT);
+
+	visit_sum = 0;
+	uint64_t start = bench_now();
+	for (int r = 0; r < NODE_ROUNDS; r++)
+		slist_visit(pl, sum_int);
+	BENCH_REPORT("slist_visit", bench_now() - start, NODE_ROUNDS * NODE_COUNT);
+	VERIFY(visit_sum == (long)NODE_ROUNDS * NODE_COUNT * (NODE_COUNT - 1) / 2);
+
+	visit_sum = 0;
+	start = bench_now();
+	for (int r = 0; r < NODE_ROUNDS; r++)
+		list_visit(pc, sum_int);
+	BENCH_REPORT("list_visit", bench_now() - start, NODE_ROUNDS * NODE_COUNT);
+	VERIFY(visit_sum == (long)NODE_ROUNDS * NODE_COUNT * (NODE_COUNT - 1) / 2);
+
+	slist_free(pl);
+	list_free(pc);
+	s = Heap_Stats();
+	VERIFY(s.blocksUsed == 0);
+	PASSED(__func__, __LINE__);
+}
+/* two heaps over their own regions do not see each other's blocks */
+void heap_instance_test()
+{
+	TC_BEGIN(__func__);
+	static long region1[128];
+	static char region2[515];
+	heap_t h1, h2;
+	long ret = Heap_InitRegion(&h1, region1, sizeof(region1));
+	VERIFY(ret == HEAP_OK);
+	ret = Heap_InitRegion(&h2, region2 + 1, sizeof(region2) - 1);
+	VERIFY(ret == HEAP_OK);
+	ret = Heap_InitRegion(&h2, region2, 8);
+	VERIFY(ret == HEAP_ERROR_BAD_ARGUMENT);
+	ret = Heap_InitRegion(&h2, region2 + 1, sizeof(region2) - 1);
+
+	char *p1 = Heap_MallocIn(&h1, 100);
+	char *p2 = Heap_MallocIn(&h2, 100);
+	VERIFY(p1 >= (char *)region1 && p1 < (char *)region1 + sizeof(region1));
+	VERIFY(p2 > region2 && p2 < region2 + sizeof(region2));
+	VERIFY(((size_t)p2 % sizeof(long)) == 0);
+	ret = Heap_FreeIn(&h1, p2);
+	VERIFY(ret == HEAP_ERROR_POINTER_OUT_OF_RANGE);
+	ret = Heap_FreeIn(&h2, p2);
+	VERIFY(ret == HEAP_OK);
+	p1 = Heap_ReallocIn(&h1, p1, 200);
+	VERIFY(p1 != NULL);
+	heap_stats_t s = Heap_StatsIn(&h1);
+	VERIFY(s.blocksUsed == 1);
+	s = Heap_StatsIn(&h2);
+	VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+	ret = Heap_TestIn(&h1);
+	VERIFY(ret == HEAP_OK);
+	PASSED(__func__, __LINE__);
+}
+/* per request scratch: mark, allocate temporaries, release in one step */
+void arena_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	arenaptr pa = arena_alloc(1024);
+	char *keep = arena_get(pa, 10);
+	VERIFY(keep != NULL);
+	arena_marker m = arena_mark(pa);
+	for (int i = 0; i < 10; i++) {
+		int *tmp = arena_get(pa, 8 * sizeof(int));
+		VERIFY(tmp && ((size_t)tmp % sizeof(long)) == 0);
+	}
+	VERIFY(arena_get(pa, 4096) == NULL);
+	arena_release(pa, m);
+	VERIFY(arena_used(pa) == m);
+	arena_reset(pa);
+	VERIFY(arena_used(pa) == 0);
+
+	void *tmps[32];
+	uint64_t start = bench_now();
+	for (int r = 0; r < NODE_ROUNDS; r++) {
+		for (int i = 0; i < 32; i++)
+			tmps[i] = Heap_Malloc(16);
+		for (int i = 0; i < 32; i++)
+			Heap_Free(tmps[i]);
+	}
+	BENCH_REPORT("32 temporaries heap", bench_now() - start,
+		     NODE_ROUNDS * 32);
+	start = bench_now();
+	for (int r = 0; r < NODE_ROUNDS; r++) {
+		arena_marker rm = arena_mark(pa);
+		for (int i = 0; i < 32; i++)
+			tmps[i] = arena_get(pa, 16);
+		arena_release(pa, rm);
+	}
+	BENCH_REPORT("32 temporaries arena", bench_now() - start,
+		     NODE_ROUNDS * 32);
+	arena_free(pa);
+	PASSED(__func__, __LINE__);
+}
+/* shrink and grow in place, fall back to a move when the neighbour is used */
+void realloc_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	int *a = Heap_Malloc(32 * sizeof(int));
+	for (int i = 0; i < 32; i++)
+		a[i] = i;
+	int *p = Heap_Realloc(a, 8 * sizeof(int));
+	VERIFY(p == a);
+	long ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	p = Heap_Realloc(a, 64 * sizeof(int));
+	VERIFY(p == a);
+	for (int i = 0; i < 8; i++)
+		VERIFY(p[i] == i);
+	int *blocker = Heap_Malloc(sizeof(int));
+	int *q = Heap_Realloc(p, 1024 * sizeof(int));
+	VERIFY(q != NULL && q != p);
+	for (int i = 0; i < 8; i++)
+		VERIFY(q[i] == i);
+	VERIFY(Heap_Realloc(q, HEAP_SIZE_BYTES * 2) == NULL);
+	VERIFY(q[7] == 7);
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	Heap_Free(blocker);
+	Heap_Free(q);
+	heap_stats_t s = Heap_Stats();
+	VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+	PASSED(__func__, __LINE__);
+}
+/* old path: always allocate, copy and free */
+static int *grow_by_copy(int *old, const size_t oldcount, const size_t count)
+{
+	int *p = Heap_Malloc(count * sizeof(int));
+	if (p) {
+		memcpy(p, old, oldcount * sizeof(int));
+		Heap_Free(old);
+	}
+	return p;
+}
+/* a growing buffer appended one element at a time, alone and interleaved
+ * with other allocations that block in place growth */
+void realloc_grow_bench()
+{
+	TC_BEGIN(__func__);
+	static const char *labels[] = {"append grow copy", "append grow realloc",
+				       "append grow copy interleaved",
+				       "append grow realloc interleaved"};
+	for (int mode = 0; mode < 4; mode++) {
+		bool inplace = mode & 1;
+		bool interleaved = mode & 2;
+		int moves = 0;
+		uint64_t ticks = 0;
+		for (int r = 0; r < NODE_ROUNDS; r++) {
+			Heap_Init();
+			void *others[GROW_STEPS / 8];
+			int nothers = 0;
+			int *buf = Heap_Malloc(sizeof(int));
+			buf[0] = 0;
+			uint64_t start = bench_now();
+			for (int n = 1; n < GROW_STEPS; n++) {
+				int *p = inplace ? Heap_Realloc(buf, (n + 1) * sizeof(int))
+						 : grow_by_copy(buf, n, n + 1);
+				VERIFY(p != NULL);
+				moves += (p != buf);
+				buf = p;
+				buf[n] = n;
+				if (interleaved && (n % 8) == 0)
+					others[nothers++] = Heap_Malloc(sizeof(int));
+			}
+			ticks += bench_now() - start;
+			for (int n = 0; n < GROW_STEPS; n++)
+				VERIFY(buf[n] == n);
+			long ret = Heap_Test();
+			VERIFY(ret == HEAP_OK);
+			for (int i = 0; i < nothers; i++)
+				Heap_Free(others[i]);
+			Heap_Free(buf);
+		}
+		BENCH_REPORT(labels[mode], ticks, NODE_ROUNDS * (GROW_STEPS - 1));
+		printf("  %s: %d moves in %d appends\n", labels[mode], moves,
+		       NODE_ROUNDS * (GROW_STEPS - 1));
+	}
+	PASSED(__func__, __LINE__);
+}
+/* the counters agree with a walk of the heap after every operation */
+static void verify_telemetry(void)
+{
+	heap_stats_t s = Heap_Stats();
+	heap_telemetry_t t = Heap_Telemetry();
+	VERIFY(t.bytesInUse == s.wordsAllocated * (long)sizeof(long));
+	VERIFY(t.blocksInUse == s.blocksUsed);
+	VERIFY(t.bytesFree == s.wordsAvailable * (long)sizeof(long));
+	VERIFY(t.blocksFree == s.blocksUnused);
+	VERIFY(t.peakBytesInUse >= t.bytesInUse);
+	VERIFY(t.largestFreeBytes <= t.bytesFree);
+	VERIFY(t.fragmentation >= 0 && t.fragmentation <= 1000);
+}
+void telemetry_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	heap_telemetry_t t = Heap_Telemetry();
+	VERIFY(t.bytesInUse == 0 && t.peakBytesInUse == 0 && t.fragmentation == 0);
+	VERIFY(t.largestFreeBytes == t.bytesFree && t.blocksFree == 1);
+	long mallocs = 0;
+	srand(7654321);
+	for (int i = 0; i < 2000; i++) {
+		size_t k = rand() % MAX_LIVE_BLOCKS;
+		if (live[k] && (rand() % 4) == 0) {
+			void *p = Heap_Realloc(live[k], 1 + rand() % 96);
+			if (p) {
+				live[k] = p;
+				mallocs++;
+			}
+		} else if (live[k]) {
+			Heap_Free(live[k]);
+			live[k] = NULL;
+		} else {
+			live[k] = Heap_Malloc(1 + rand() % 96);
+			mallocs += live[k] != NULL;
+		}
+		verify_telemetry();
+	}
+	t = Heap_Telemetry();
+	unsigned long counted = 0;
+	for (int i = 0; i < HEAP_HISTOGRAM_BINS; i++)
+		counted += t.histogram[i];
+	VERIFY(counted == (unsigned long)mallocs);
+	VERIFY(t.highWaterBytes <= HEAP_SIZE_BYTES);
+	VERIFY(t.highWaterBytes >= t.peakBytesInUse);
+
+	long peak = t.peakBytesInUse;
+	long failed = t.failedMallocs;
+	void *none = Heap_Malloc(HEAP_SIZE_BYTES);
+	VERIFY(none == NULL);
+	t = Heap_Telemetry();
+	VERIFY(t.failedMallocs == failed + 1);
+	for (size_t k = 0; k < MAX_LIVE_BLOCKS; k++)
+		if (live[k]) {
+			Heap_Free(live[k]);
+			live[k] = NULL;
+		}
+	t = Heap_Telemetry();
+	VERIFY(t.bytesInUse == 0 && t.peakBytesInUse == peak);
+	VERIFY(t.fragmentation == 0 && t.blocksFree == 1);
+	verify_telemetry();
+	PASSED(__func__, __LINE__);
+}
+/* what it costs to read the numbers, and the numbers needed to size the
+ * heap for a workload */
+void telemetry_bench()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	size_t count = heap_fill(90);
+	long sink = 0;
+	uint64_t start = bench_now();
+	for (int i = 0; i < BENCH_ITERATIONS; i++)
+		sink += Heap_Stats().wordsAllocated;
+	BENCH_REPORT("Heap_Stats 90% heap", bench_now() - start, BENCH_ITERATIONS);
+	start = bench_now();
+	for (int i = 0; i < BENCH_ITERATIONS; i++)
+		sink += Heap_Telemetry().bytesInUse;
+	BENCH_REPORT("Heap_Telemetry 90% heap", bench_now() - start,
+		     BENCH_ITERATIONS);
+	VERIFY(sink > 0);
+
+	heap_telemetry_t t = Heap_Telemetry();
+	printf("BENCH sizing: in use %ld peak %ld high water %ld of %d bytes, "
+	       "largest free %ld, fragmentation %ld.%ld%%, failed %ld\n",
+	       t.bytesInUse, t.peakBytesInUse, t.highWaterBytes,
+	       HEAP_SIZE_BYTES, t.largestFreeBytes, t.fragmentation / 10,
+	       t.fragmentation % 10, t.failedMallocs);
+	printf("BENCH request sizes:");
+	for (int i = 0; i < HEAP_HISTOGRAM_BINS; i++)
+		if (t.histogram[i])
+			printf(" %d-%d:%lu", 1 << i, (2 << i) - 1, t.histogram[i]);
+	NL;
+	for (size_t k = 0; k < count; k++)
+		if (live[k]) {
+			Heap_Free(live[k]);
+			live[k] = NULL;
+		}
+	PASSED(__func__, __LINE__);
+}
+/* aligned blocks between ordinary ones, no padding inside the blocks and
+ * the skipped words come back when everything is freed */
+void aligned_alloc_test()
+{
+	TC_BEGIN(__func__);
+	static const size_t aligns[] = {16, 32, 64, 128};
+	Heap_Init();
+	void *none = Heap_MallocAligned(64, 24);
+	VERIFY(none == NULL);
+	none = Heap_MallocAligned(64, 0);
+	VERIFY(none == NULL);
+
+	/* one block of exactly the requested room, the rest is free */
+	unsigned char *p = Heap_MallocAligned(100, 64);
+	VERIFY(p && ((size_t)p % 64) == 0);
+	heap_stats_t s = Heap_Stats();
+	VERIFY(s.blocksUsed == 1);
+	VERIFY(s.wordsAllocated == (long)((100 + sizeof(long) - 1) / sizeof(long)));
+	long ret = Heap_FreeAligned(p);
+	VERIFY(ret == HEAP_OK);
+	s = Heap_Stats();
+	VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+
+	for (size_t i = 0; i < NODE_COUNT; i++) {
+		size_t align = aligns[i % _countof(aligns)];
+		if (i % 3 == 0) {
+			live[i] = Heap_Malloc(1 + i % 24);
+			continue;
+		}
+		live[i] = Heap_MallocAligned(8 + (long)(i % 5) * 12, align);
+		VERIFY(live[i] && ((size_t)live[i] % align) == 0);
+		memset(live[i], (int)i, 8);
+	}
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	verify_telemetry();
+	for (size_t i = 1; i < NODE_COUNT; i += 3)
+		VERIFY(((unsigned char *)live[i])[7] == (unsigned char)i);
+	for (size_t i = 0; i < NODE_COUNT; i++) {
+		ret = Heap_FreeAligned(live[i]);
+		VERIFY(ret == HEAP_OK);
+		live[i] = NULL;
+	}
+	s = Heap_Stats();
+	VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+
+	/* a nearly full heap still finds an aligned spot by walking it */
+	size_t count = heap_fill(90);
+	void *q = Heap_MallocAligned(8, 32);
+	VERIFY(q && ((size_t)q % 32) == 0);
+	Heap_Free(q);
+	for (size_t k = 0; k < count; k++)
+		if (live[k]) {
+			Heap_Free(live[k]);
+			live[k] = NULL;
+		}
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	PASSED(__func__, __LINE__);
+}
+/* a few blocks per call while the heap keeps changing, then a smashed tag
+ * is found within one pass and a free next to it refuses to merge */
+void incremental_check_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	srand(424242);
+	for (int i = 0; i < 4000; i++) {
+		size_t k = rand() % MAX_LIVE_BLOCKS;
+		if (live[k]) {
+			Heap_Free(live[k]);
+			live[k] = NULL;
+		} else {
+			live[k] = Heap_Malloc(1 + rand() % 96);
+		}
+		long ret = Heap_TestStep(4);
+		VERIFY(ret == HEAP_OK);
+	}
+	VERIFY(Heap_Telemetry().checkPasses > 0);
+
+	/* a used block whose neighbour below is also one of ours */
+	long *victim = NULL, *below = NULL;
+	for (size_t i = 0; i < MAX_LIVE_BLOCKS && !below; i++)
+		for (size_t j = 0; live[i] && j < MAX_LIVE_BLOCKS; j++)
+			if (live[j] == (long *)live[i] + ((long *)live[i])[-1] + 2) {
+				victim = live[i];
+				below = live[j];
+				break;
+			}
+	VERIFY(below != NULL);
+	long saved = victim[-1];
+	victim[-1] = saved + 1; /* header no longer matches the trailer */
+	heap_stats_t s = Heap_Stats();
+	long calls = 0;
+	long ret;
+	do {
+		ret = Heap_TestStep(HEAP_CHECK_BUDGET);
+		calls++;
+	} while (ret == HEAP_OK && calls <= s.blocksUsed + s.blocksUnused);
+	VERIFY(ret == HEAP_ERROR_CORRUPTED_HEAP);
+	VERIFY(calls <= (s.blocksUsed + s.blocksUnused) / HEAP_CHECK_BUDGET + 2);
+	ret = Heap_TestStep(HEAP_CHECK_BUDGET);
+	VERIFY(ret == HEAP_ERROR_CORRUPTED_HEAP);
+	/* the block below sees its neighbour is broken */
+	ret = Heap_Free(below);
+	VERIFY(ret == HEAP_ERROR_CORRUPTED_HEAP);
+	victim[-1] = saved;
+	ret = Heap_TestStep(HEAP_CHECK_BUDGET);
+	VERIFY(ret == HEAP_OK);
+
+	for (size_t k = 0; k < MAX_LIVE_BLOCKS; k++)
+		if (live[k]) {
+			ret = Heap_Free(live[k]);
+			VERIFY(ret == HEAP_OK);
+			live[k] = NULL;
+		}
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	PASSED(__func__, __LINE__);
+}
+/* worst case cost of one call against checking the whole heap */
+void incremental_check_bench()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	size_t count = heap_fill(90);
+	uint64_t start = bench_now();
+	for (int i = 0; i < BENCH_ITERATIONS; i++)
+		Heap_Test();
+	BENCH_REPORT("Heap_Test 90% heap", bench_now() - start,
+		     BENCH_ITERATIONS);
+	uint64_t worst = 0;
+	start = bench_now();
+	for (int i = 0; i < BENCH_ITERATIONS; i++) {
+		uint64_t t = bench_now();
+		Heap_TestStep(HEAP_CHECK_BUDGET);
+		t = bench_now() - t;
+		if (t > worst)
+			worst = t;
+	}
+	BENCH_REPORT("Heap_TestStep 90% heap", bench_now() - start,
+		     BENCH_ITERATIONS);
+	BENCH_REPORT("Heap_TestStep worst call", worst, 1);
+	for (size_t k = 0; k < count; k++)
+		if (live[k]) {
+			Heap_Free(live[k]);
+			live[k] = NULL;
+		}
+	PASSED(__func__, __LINE__);
+}
+/* the same containers on a heap instance, an arena, a pool and the C
+   library malloc, none of them may touch the default heap */
+void allocator_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	static long region[256];
+	heap_t h;
+	long ret = Heap_InitRegion(&h, region, sizeof(region));
+	VERIFY(ret == HEAP_OK);
+	allocator al = heap_instance_allocator(&h);
+	slistptr pl = slist_alloc_with(sizeof(int), &al);
+	for (int i = 0; i < 20; i++)
+		slist_push(pl, &i);
+	VERIFY(*(int *)slist_top(pl) == 19);
+	VERIFY(Heap_StatsIn(&h).blocksUsed == 21);
+	VERIFY(Heap_Stats().blocksUsed == 0);
+	slist_free(pl);
+	VERIFY(Heap_StatsIn(&h).blocksUsed == 0);
+	ret = Heap_TestIn(&h);
+	VERIFY(ret == HEAP_OK);
+
+	arenaptr pa = arena_alloc(1024);
+	arena_marker m = arena_mark(pa);
+	al = arena_allocator(pa);
+	stackptr ps = stack_alloc_with(sizeof(int), &al);
+	for (int i = 0; i < 10; i++)
+		stack_push(ps, &i);
+	for (int i = 9; i >= 0; i--) {
+		VERIFY(*(int *)stack_top(ps) == i);
+		stack_pop(ps);
+	}
+	stack_free(ps);
+	VERIFY(arena_used(pa) > m);
+	arena_release(pa, m);
+	VERIFY(arena_used(pa) == m);
+	char *old = arena_get(pa, 8);
+	strcpy(old, "arena");
+	char *grown = allocator_realloc(&al, old, 64);
+	VERIFY(grown && strcmp(grown, "arena") == 0);
+	arena_free(pa);
+
+	/* node sized requests come from the pool, the descriptor does not fit
+	   and falls back to the heap */
+	poolptr pp = pool_alloc(tree_node_size(), NODE_COUNT);
+	al = pool_allocator(pp);
+	treeptr pt = tree_alloc_with(int_cmp, true, &al);
+	for (int i = 0; i < NODE_COUNT; i++) {
+		keys[i] = i;
+		tree_add(pt, &keys[i]);
+	}
+	VERIFY(pool_available(pp) == 0);
+	int key = NODE_COUNT / 2;
+	VERIFY(tree_find(pt, &key) != NULL);
+	tree_free(pt);
+	VERIFY(pool_available(pp) == NODE_COUNT);
+	int *obj = allocator_alloc(&al, sizeof(int));
+	*obj = 42;
+	int *big = allocator_realloc(&al, obj, tree_node_size() * 2);
+	VERIFY(big && *big == 42);
+	VERIFY(pool_available(pp) == NODE_COUNT);
+	allocator_free(&al, big);
+	pool_free(pp);
+
+	listptr pc = list_alloc_with(sizeof(int), &system_allocator);
+	for (int i = 0; i < NODE_COUNT; i++)
+		list_add(pc, &i);
+	VERIFY(Heap_Stats().blocksUsed == 0);
+	list_free(pc);
+
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	VERIFY(Heap_Stats().blocksUsed == 0);
+	PASSED(__func__, __LINE__);
+}
+/* circ_list build and tear down on each allocator, on the host the system
+   row is glibc malloc */
+void allocator_bench()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	char label[64];
+	poolptr pp = pool_alloc(list_node_size(sizeof(int)), NODE_COUNT);
+	/* arena objects are rounded up to a long */
+	arenaptr pa = arena_alloc((list_node_size(sizeof(int)) + sizeof(long)) *
+				  NODE_COUNT + 256);
+	const struct {
+		const char *name;
+		allocator al;
+	} rows[] = {
+		{"heap", heap_allocator},
+		{"pool", pool_allocator(pp)},
+		{"arena", arena_allocator(pa)},
+		{"system", system_allocator},
+	};
+	for (size_t r = 0; r < _countof(rows); r++) {
+		uint64_t start = bench_now();
+		for (int n = 0; n < NODE_ROUNDS; n++) {
+			arena_marker m = arena_mark(pa);
+			listptr pc = list_alloc_with(sizeof(int), &rows[r].al);
+			for (int i = 0; i < NODE_COUNT; i++)
+				list_add(pc, &i);
+			list_free(pc);
+			arena_release(pa, m);
+		}
+		uint64_t ticks = bench_now() - start;
+		snprintf(label, sizeof(label), "circ_list add/free %s",
+			 rows[r].name);
+		BENCH_REPORT(label, ticks, NODE_ROUNDS * (NODE_COUNT + 1) * 2);
+	}
+	VERIFY(pool_available(pp) == NODE_COUNT);
+	arena_free(pa);
+	pool_free(pp);
+	VERIFY(Heap_Stats().blocksUsed == 0);
+	PASSED(__func__, __LINE__);
+}
+/* a heap of handles with every other one freed can't take a big block
+   until compaction slides the survivors together, a locked one stays put */
+void handle_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	heap_handle_t h[HEAP_HANDLE_COUNT];
+	for (int i = 0; i < HEAP_HANDLE_COUNT; i++) {
+		h[i] = Heap_HandleAlloc(HANDLE_BYTES);
+		VERIFY(h[i] != 0);
+		memset(Heap_HandleLock(h[i]), i, HANDLE_BYTES);
+		Heap_HandleUnlock(h[i]);
+	}
+	VERIFY(Heap_HandleAlloc(8) == 0);
+	for (int i = 0; i < HEAP_HANDLE_COUNT; i += 2) {
+		long ret = Heap_HandleFree(h[i]);
+		VERIFY(ret == HEAP_OK);
+	}
+	long ret = Heap_HandleFree(h[0]);
+	VERIFY(ret == HEAP_ERROR_BAD_ARGUMENT);
+	VERIFY(Heap_HandleLock(0) == NULL);
+	ret = Heap_HandleUnlock(h[1]);
+	VERIFY(ret == HEAP_ERROR_BAD_ARGUMENT);
+
+	char *pinned = Heap_HandleLock(h[5]);
+	long big = HEAP_SIZE_BYTES / 4;
+	void *plain = Heap_Malloc(big);
+	VERIFY(plain == NULL);
+	heap_handle_t hb = Heap_HandleAlloc(big);
+	VERIFY(hb != 0);
+	VERIFY(Heap_HandleLock(h[5]) == pinned);
+	Heap_HandleUnlock(h[5]);
+	Heap_HandleUnlock(h[5]);
+	for (int i = 1; i < HEAP_HANDLE_COUNT; i += 2) {
+		unsigned char *p = Heap_HandleLock(h[i]);
+		VERIFY(p[0] == i && p[HANDLE_BYTES - 1] == i);
+		Heap_HandleUnlock(h[i]);
+	}
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+
+	/* everything movable is already packed */
+	VERIFY(Heap_Compact() == 0);
+	Heap_HandleFree(hb);
+	for (int i = 1; i < HEAP_HANDLE_COUNT; i += 2)
+		Heap_HandleFree(h[i]);
+	VERIFY(Heap_Stats().blocksUsed == 0);
+	VERIFY(Heap_Stats().blocksUnused == 1);
+	PASSED(__func__, __LINE__);
+}
+/* the same random mixed size churn with plain blocks and with handles,
+   failed allocations are what fragmentation costs */
+void handle_churn_bench()
+{
+	TC_BEGIN(__func__);
+	long failures[2] = {0, 0};
+	for (int handles = 0; handles < 2; handles++) {
+		Heap_Init();
+		void *plain[CHURN_SLOTS] = {0};
+		heap_handle_t hs[CHURN_SLOTS] = {0};
+		srand(4242);
+		uint64_t start = bench_now();
+		for (int n = 0; n < CHURN_STEPS; n++) {
+			int k = rand() % CHURN_SLOTS;
+			long bytes = 16 + rand() % 500;
+			if (handles) {
+				if (hs[k])
+					Heap_HandleFree(hs[k]);
+				hs[k] = Heap_HandleAlloc(bytes);
+				failures[handles] += hs[k] == 0;
+			} else {
+				if (plain[k])
+					Heap_Free(plain[k]);
+				plain[k] = Heap_Malloc(bytes);
+				failures[handles] += plain[k] == NULL;
+			}
+		}
+		uint64_t ticks = bench_now() - start;
+		BENCH_REPORT(handles ? "mixed churn handles" : "mixed churn plain",
+			     ticks, CHURN_STEPS);
+		long ret = Heap_Test();
+		VERIFY(ret == HEAP_OK);
+	}
+	printf("BENCH mixed churn failed allocations: plain %ld, handles %ld\n",
+	       failures[0], failures[1]);
+	VERIFY(failures[1] <= failures[0]);
+	PASSED(__func__, __LINE__);
+}
+void batch_test()
+{
+	TC_BEGIN(__func__);
+	Heap_Init();
+	void *blocks[BATCH_COUNT];
+	long got = Heap_MallocBatch(BATCH_COUNT, 12, blocks);
+	VERIFY(got == BATCH_COUNT);
+	for (int i = 0; i < BATCH_COUNT; i++)
+		memset(blocks[i], i, 12);
+	for (int i = 0; i < BATCH_COUNT; i++) {
+		unsigned char *b = blocks[i];
+		VERIFY(b[0] == (unsigned char)i && b[11] == (unsigned char)i);
+	}
+	heap_stats_t s = Heap_Stats();
+	VERIFY(s.blocksUsed == BATCH_COUNT && s.blocksUnused == 1);
+	VERIFY(Heap_Telemetry().blocksInUse == BATCH_COUNT);
+
+	/* any order, NULLs skipped, one free block again afterwards */
+	for (int i = 0; i < BATCH_COUNT; i++) {
+		int j = rand() % BATCH_COUNT;
+		void *tmp = blocks[i];
+		blocks[i] = blocks[j];
+		blocks[j] = tmp;
+	}
+	void *keep = blocks[7];
+	blocks[7] = NULL;
+	long ret = Heap_FreeBatch(blocks, BATCH_COUNT);
+	VERIFY(ret == HEAP_OK);
+	s = Heap_Stats();
+	VERIFY(s.blocksUsed == 1 && s.blocksUnused <= 2);
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+
+	/* a bad pointer is reported, the good ones are still freed */
+	void *pair[3] = {keep, keep, (long *)keep + 100000};
+	ret = Heap_FreeBatch(pair, 3);
+	VERIFY(ret != HEAP_OK);
+	s = Heap_Stats();
+	VERIFY(s.blocksUsed == 0 && s.blocksUnused == 1);
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+
+	/* more than fits, the batch is cut short at what the heap holds */
+	got = Heap_MallocBatch(BATCH_COUNT, HEAP_SIZE_BYTES / 32, blocks);
+	VERIFY(got > 0 && got < BATCH_COUNT);
+	VERIFY(blocks[got] == NULL);
+	ret = Heap_FreeBatch(blocks, got);
+	VERIFY(ret == HEAP_OK);
+	VERIFY(Heap_Stats().blocksUnused == 1);
+
+	/* count x size past a long finds nothing rather than overflowing */
+	got = Heap_MallocBatch(16, LONG_MAX - 7, blocks);
+	VERIFY(got == 0 && blocks[0] == NULL);
+
+	/* a neighbour overrun is caught before the batch merges past it */
+	got = Heap_MallocBatch(3, 16, blocks);
+	VERIFY(got == 3);
+	long *mid = blocks[1];
+	long saved = mid[-1];
+	mid[-1] = saved + 1;
+	ret = Heap_FreeBatch(blocks, 1);
+	VERIFY(ret == HEAP_ERROR_CORRUPTED_HEAP);
+	mid[-1] = saved;
+	/* the heap's first word, its header would be below the heap */
+	void *first[1] = {(long *)blocks[0] - 1};
+	ret = Heap_FreeBatch(first, 1);
+	VERIFY(ret == HEAP_ERROR_POINTER_OUT_OF_RANGE);
+	ret = Heap_FreeBatch(blocks, 3);
+	VERIFY(ret == HEAP_OK);
+	VERIFY(Heap_Stats().blocksUnused == 1);
+	ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	PASSED(__func__, __LINE__);
+}
+/* BATCH_COUNT small blocks one call at a time and as one batch, then
+   an slist torn down node by node against slist_free, which batches */
+void batch_bench()
+{
+	TC_BEGIN(__func__);
+	void *blocks[BATCH_COUNT];
+	Heap_Init();
+	uint64_t start = bench_now();
+	for (int r = 0; r < NODE_ROUNDS; r++) {
+		for (int i = 0; i < BATCH_COUNT; i++)
+			blocks[i] = Heap_Malloc(12);
+		for (int i = 0; i < BATCH_COUNT; i++)
+			Heap_Free(blocks[i]);
+	}
+	uint64_t ticks = bench_now() - start;
+	BENCH_REPORT("malloc/free one at a time", ticks,
+		     NODE_ROUNDS * BATCH_COUNT * 2);
+
+	start = bench_now();
+	for (int r = 0; r < NODE_ROUNDS; r++) {
+		Heap_MallocBatch(BATCH_COUNT, 12, blocks);
+		Heap_FreeBatch(blocks, BATCH_COUNT);
+	}
+	ticks = bench_now() - start;
+	BENCH_REPORT("Heap_MallocBatch/Heap_FreeBatch", ticks,
+		     NODE_ROUNDS * BATCH_COUNT * 2);
+
+	ticks = 0;
+	for (int r = 0; r < NODE_ROUNDS; r++) {
+		slistptr pl = slist_alloc(sizeof(int));
+		for (int i = 0; i < BATCH_COUNT; i++)
+			slist_push(pl, &i);
+		start = bench_now();
+		while (!slist_isempty(pl))
+			slist_pop(pl);
+		slist_free(pl);
+		ticks += bench_now() - start;
+	}
+	BENCH_REPORT("slist teardown by pop", ticks, NODE_ROUNDS * BATCH_COUNT);
+
+	ticks = 0;
+	for (int r = 0; r < NODE_ROUNDS; r++) {
+		slistptr pl = slist_alloc(sizeof(int));
+		for (int i = 0; i < BATCH_COUNT; i++)
+			slist_push(pl, &i);
+		start = bench_now();
+		slist_free(pl);
+		ticks += bench_now() - start;
+	}
+	BENCH_REPORT("slist teardown by slist_free", ticks,
+		     NODE_ROUNDS * BATCH_COUNT);
+
+	ticks = 0;
+	for (int r = 0; r < NODE_ROUNDS; r++) {
+		treeptr pt = tree_alloc(int_cmp, true);
+		for (int i = 0; i < NODE_COUNT; i++) {
+			keys[i] = rand();
+			tree_add(pt, &keys[i]);
+		}
+		start = bench_now();
+		tree_free(pt);
+		ticks += bench_now() - start;
+	}
+	BENCH_REPORT("tree teardown by tree_free", ticks, NODE_ROUNDS * NODE_COUNT);
+	VERIFY(Heap_Stats().blocksUsed == 0);
+	long ret = Heap_Test();
+	VERIFY(ret == HEAP_OK);
+	PASSED(__func__, __LINE__);
+}
+/* one heap over two regions of a buffer, the second twice the first, with
+   REGION_GAP words between them that the heap must never touch */
+static long gap_untouched(const long *gap)
+{
+	for (int i = 0; i < REGION_GAP; i++)
+		if (gap[i] != GAP_FILL)
+			return 0;
+	return 1;
+}
+void region_test()
+{
+	TC_BEGIN(__func__);
+	static long buf[3 * REGION_WORDS];
+	static void *blocks[REGION_WORDS];
+	static heap_t rh;
+	long *gap = buf + REGION_WORDS;
+	/* unaligned, so the word after the gap is not in the region either */
+	char *second = (char *)(gap + REGION_GAP) + 1;
+	size_t second_bytes = (2 * REGION_WORDS - REGION_GAP) * sizeof(long) - 1;
+	for (int i = 0; i < REGION_GAP; i++)
+		gap[i] = GAP_FILL;
+
+	/* refused when the top block is in use, below the heap or too small */
+	long ret = Heap_InitRegion(&rh, buf, REGION_WORDS * sizeof(long));
+	VERIFY(ret == HEAP_OK);
+	/* TLSF rounds a search up a size class, first fit takes it exactly */
+	Heap_SetPolicyIn(&rh, HEAP_POLICY_FIRST_FIT);
+	void *all = Heap_MallocIn(&rh, (REGION_WORDS - 2) * sizeof(long));
+	VERIFY(all != NULL);
+	ret = Heap_AddRegionIn(&rh, second, second_bytes);
+	VERIFY(ret == HEAP_ERROR_BAD_ARGUMENT);
+	ret = Heap_InitRegion(&rh, buf, REGION_WORDS * sizeof(long));
+	VERIFY(ret == HEAP_OK);
+	ret = Heap_AddRegionIn(&rh, buf, REGION_WORDS * sizeof(long));
+	VERIFY(ret == HEAP_ERROR_BAD_ARGUMENT);
+	ret = Heap_AddRegionIn(&rh, gap + REGION_GAP, 4 * sizeof(long));
+	VERIFY(ret == HEAP_ERROR_BAD_ARGUMENT);
+
+	/* the top block gives two words, the region adds all but three */
+	long before = Heap_TelemetryIn(&rh).bytesFree;
+	ret = Heap_AddRegionIn(&rh, second, second_bytes);
+	VERIFY(ret == HEAP_OK);
+	heap_telemetry_t t = Heap_TelemetryIn(&rh);
+	long added = (2 * REGION_WORDS - REGION_GAP - 1) - 3 - 2;
+	VERIFY(t.bytesFree == before + added * (long)sizeof(long));
+	VERIFY(t.blocksFree == 2 && t.blocksInUse == 0);
+	heap_stats_t s = Heap_StatsIn(&rh);
+	VERIFY(s.blocksUsed == 0 && s.wordsAllocated == 0 && s.blocksUnused == 2);
+	ret = Heap_TestIn(&rh);
+	VERIFY(ret == HEAP_OK);
+
+	/* a block bigger than the first region comes from the second */
+	void *big = Heap_MallocIn(&rh, (REGION_WORDS + 16) * sizeof(long));
+	VERIFY((long *)big > gap + REGION_GAP);
+	Heap_FreeIn(&rh, big);
+
+	/* fill both regions, more blocks than either one holds */
+	size_t count = 0;
+	while (count < REGION_WORDS &&
+	       (blocks[count] = Heap_MallocIn(&rh, 4 * sizeof(long))) != NULL) {
+		memset(blocks[count], 0xff, 4 * sizeof(long));
+		count++;
+	}
+	VERIFY(count > REGION_WORDS / 6 + 1);
+	VERIFY((long *)blocks[count - 1] > gap + REGION_GAP || (long *)blocks[0] > gap + REGION_GAP);
+	VERIFY(gap_untouched(gap));
+	s = Heap_StatsIn(&rh);
+	VERIFY(s.blocksUsed == (long)count);
+	VERIFY(Heap_TelemetryIn(&rh).blocksInUse == (long)count);
+	ret = Heap_TestIn(&rh);
+	VERIFY(ret == HEAP_OK);
+
+	/* every other block, then the rest, merges up to the gap on each side */
+	for (size_t i = 0; i < count; i += 2)
+		Heap_FreeIn(&rh, blocks[i]);
+	for (size_t i = 1; i < count; i += 2)
+		Heap_FreeIn(&rh, blocks[i]);
+	t = Heap_TelemetryIn(&rh);
+	VERIFY(t.blocksFree == 2 && t.bytesFree == before + added * (long)sizeof(long));
+	ret = Heap_TestIn(&rh);
+	VERIFY(ret == HEAP_OK);
+
+	/* compaction stops at the gap block */
+	heap_handle_t lo = Heap_HandleAllocIn(&rh, 8 * sizeof(long));
+	heap_handle_t hi = Heap_HandleAllocIn(&rh, (REGION_WORDS + 16) * sizeof(long));
+	VERIFY(lo && hi);
+	Heap_HandleFreeIn(&rh, lo);
+	Heap_CompactIn(&rh);
+	long *moved = Heap_HandleLockIn(&rh, hi);
+	VERIFY(moved > gap + REGION_GAP);
+	Heap_HandleUnlockIn(&rh, hi);
+	Heap_HandleFreeIn(&rh, hi);
+	ret = Heap_TestIn(&rh);
+	VERIFY(ret == HEAP_OK);
+	VERIFY(gap_untouched(gap));
+	PASSED(__func__, __LINE__);
+}
+#pragma GCC diagnostic pop
@@ -1,22 +1,41 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <math.h>
+#include "precompile.h"
 #include "harness.h"
+#include "bench.h"
+#include "rng.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
 #define RMAX 4096  // number of "bins"
+#define GEN_BINS 100  // bins per generator in test_generators
+#if defined(__arm__)
+#define BENCH_COUNT 1024
+#else
+#define BENCH_COUNT (1 << 20)
+#endif
+
+// test data
+static uint32_t fill_buf[BENCH_COUNT];
+static float float_buf[BENCH_COUNT];
 
 // test helper
 void dummy();
 // tests
 float chisquare(int N, int r); // Sedgewick, Algorithms in C++, 1992
+float chisquare_bins(const int *f, int N, int r);
 void test_rand();
+void test_generators();
+void test_streams();
+void test_fill_bench();
 
 int main()
 {
-    PROJECT_BANNER("GRAPH Algorithms, A Fixed, Attachable Array for Embedded Enviroments");
+    PROJECT_BANNER("RANDOM, xoshiro128** and PCG32 with a Chi-Square Test");
+    bench_init();
     test_rand();
+    test_generators();
+    test_streams();
+    test_fill_bench();
+    REPORT("Test Random Results ");
     dummy();
 }
 /*-----------------------------------------------------------------------------
@@ -24,6 +43,19 @@ Test functions and data
 -----------------------------------------------------------------------------*/
 // x^2 = Sigma 0 <=i < r (f_i - N/r^2)^2 / N/r
 // see random.md in /slides or view the Doxygen project.
+// Function to calculate chi-square value of bin counts f
+float chisquare_bins(const int *f, int N, int r) {
+    float chi_square = 0.0;
+    float expected_frequency = (float)N / r;
+
+    for (int i = 0; i < r; i++) {
+        float observed_frequency = (float)f[i];
+        chi_square += ((observed_frequency - expected_frequency) *
+                       (observed_frequency - expected_frequency)) / expected_frequency;
+    }
+
+    return chi_square;
+}
 // Function to calculate chi-square value
 float chisquare(int N, int r) {
     // Ensure the number of bins does not exceed RMAX
@@ -33,29 +65,28 @@ float chisquare(int N, int r) {
     int f[RMAX] = {0};
 
     // Seed the random number generator for reproducibility
-    srand(1234567);
+    rng g;
+    rng_seed(&g, 1234567);
 
     // Generate N random values and increment the frequency count in the corresponding bins
     for (int i = 0; i < N; i++) {
-        f[rand() % r]++;
+        f[rng_range(&g, r)]++;
     }
 
     // Calculate the chi-square value
-    float chi_square = 0.0;
-    float expected_frequency = (float)N / r;
-
-    for (int i = 0; i < r; i++) {
-        float observed_frequency = (float)f[i];
-        chi_square += ((observed_frequency - expected_frequency) * 
-                       (observed_frequency - expected_frequency)) / expected_frequency;
-    }
-
-    return chi_square;
+    return chisquare_bins(f, N, r);
 }
 void dummy()
 {
 	printf("foo");
 }
+// within 2 standard deviations of r, Sedgewick's rule of thumb
+static bool chi_ok(float result, int r)
+{
+    float lower_bound = r - 2 * sqrt(2 * r);
+    float upper_bound = r + 2 * sqrt(2 * r);
+    return result >= lower_bound && result <= upper_bound;
+}
 void test_rand()
 {
 	TC_BEGIN("Test random number generator");
@@ -68,12 +99,174 @@ void test_rand()
     // Print the chi-square value
     printf("Chi-Square Value: %.2f\n", result);
 
-    // Evaluate the result to determine if the generator is uniform
-    float lower_bound = r - 2 * sqrt(2 * r);
-    float upper_bound = r + 2 * sqrt(2 * r);
-
     // Verify that the result is within the expected range
-    VERIFY(result >= lower_bound && result <= upper_bound);
-	REPORT("Test Random Results ");
+    VERIFY(chi_ok(result, r));
+    PASSED(__func__, __LINE__);
+}
+/* the reference outputs of both generators, then each one, a jumped stream
+   and rand() % r binned; rand() is only printed */
+void test_generators()
+{
+	TC_BEGIN(__func__);
+	static const uint32_t xoshiro_ref[] = {11520, 0, 5927040, 70819200};
+	static const uint32_t pcg32_ref[] = {0xa15c02b7, 0x7b47f409,
+					     0xba1d3330, 0x83d2f293};
+	rng x = {{1, 2, 3, 4}};
+	rng_pcg32 p;
+	rng_pcg32_seed(&p, 42, 54);
+	bool ok = true;
+	for (size_t i = 0; i < _countof(xoshiro_ref); i++) {
+		ok = ok && rng_u32(&x) == xoshiro_ref[i];
+		ok = ok && rng_pcg32_u32(&p) == pcg32_ref[i];
+	}
+	VERIFY(ok);
+
+	static int f[4][GEN_BINS];
+	const int N = 100000, r = GEN_BINS;
+	rng_seed(&x, 99);
+	rng jumped = x;
+	rng_jump(&jumped);
+	rng_pcg32_seed(&p, 99, 7);
+	srand(99);
+	for (int i = 0; i < N; i++) {
+		f[0][rng_range(&x, r)]++;
+		f[1][rng_range(&jumped, r)]++;
+		f[2][rng_pcg32_range(&p, r)]++;
+		f[3][rand() % r]++;
+	}
+	const char *names[] = {"xoshiro128**", "xoshiro128** jumped", "pcg32",
+			       "rand() % r"};
+	for (int g = 0; g < 4; g++) {
+		float result = chisquare_bins(f[g], N, r);
+		printf("%-20s Chi-Square Value: %.2f\n", names[g], result);
+		if (g < 3)
+			VERIFY(chi_ok(result, r));
+	}
+	PASSED(__func__, __LINE__);
+}
+/* jump-ahead, advance, bulk fills and ranges agree with single draws */
+void test_streams()
+{
+	TC_BEGIN(__func__);
+	rng a, b;
+	rng_seed(&a, 5);
+	rng_seed(&b, 5);
+	VERIFY(memcmp(&a, &b, sizeof(rng)) == 0);
+	rng_jump(&b);
+	int same = 0;
+	for (int i = 0; i < 1000; i++)
+		same += rng_u32(&a) == rng_u32(&b);
+	VERIFY(same < 2);
+	rng_seed(&b, 5);
+	rng_long_jump(&b);
+	VERIFY(memcmp(&a, &b, sizeof(rng)) != 0);
+	rng_seed(&a, 0);
+	VERIFY((a.s[0] | a.s[1] | a.s[2] | a.s[3]) != 0);
+
+	rng_pcg32 p, q;
+	rng_pcg32_seed(&p, 42, 1);
+	q = p;
+	for (int i = 0; i < 1000; i++)
+		rng_pcg32_u32(&p);
+	rng_pcg32_advance(&q, 1000);
+	VERIFY(p.state == q.state && p.inc == q.inc);
+	rng_pcg32_seed(&q, 42, 2);
+	rng_pcg32_seed(&p, 42, 1);
+	uint32_t p1 = rng_pcg32_u32(&p), q1 = rng_pcg32_u32(&q);
+	VERIFY(p1 != q1);
+
+	/* a fill is the same numbers as single draws, state left the same */
+	const size_t n = 1000;
+	rng_seed(&a, 77);
+	b = a;
+	rng_fill_u32(&a, fill_buf, n);
+	bool ok = true;
+	for (size_t i = 0; i < n; i++)
+		ok = ok && fill_buf[i] == rng_u32(&b);
+	VERIFY(ok && memcmp(&a, &b, sizeof(rng)) == 0);
+	static const uint32_t ranges[] = {1, 2, 3, 6, 100, 0x80000001u,
+					  0xffffffffu};
+	for (size_t k = 0; k < _countof(ranges); k++) {
+		uint32_t lim = ranges[k];
+		rng_fill_range(&a, fill_buf, n, lim);
+		for (size_t i = 0; i < n; i++)
+			ok = ok && fill_buf[i] < lim && fill_buf[i] ==
+							    rng_range(&b, lim);
+	}
+	VERIFY(ok);
+
+	float floats[256];
+	rng_fill_float(&a, floats, _countof(floats));
+	float sum = 0.0f;
+	for (size_t i = 0; i < _countof(floats); i++) {
+		ok = ok && floats[i] >= 0.0f && floats[i] < 1.0f &&
+		     floats[i] == rng_float(&b);
+		sum += floats[i];
+	}
+	VERIFY(ok);
+	VERIFY(sum > 100.0f && sum < 156.0f);
+
+	/* the default generator starts the same every run */
+	rng_seed(&a, 1234567);
+	rng_seed(rng_default(), 1234567);
+	uint32_t first = rng_rand(), expect = rng_u32(&a);
+	VERIFY(first == expect);
+	uint32_t zero = rng_range(&a, 0);
+	VERIFY(zero == 0);
+	PASSED(__func__, __LINE__);
+}
+/* BENCH_COUNT numbers: per element through a function pointer, as modify
+   with rand_int does, then inline and as a bulk fill */
+static uint32_t libc_rand(void)
+{
+	return (uint32_t)rand();
+}
+static void fill_callback(uint32_t *dest, const size_t count,
+			  uint32_t (*next)(void))
+{
+	for (size_t i = 0; i < count; i++)
+		dest[i] = next();
+}
+void test_fill_bench()
+{
+	TC_BEGIN(__func__);
+	const uint64_t ops = BENCH_COUNT;
+	uint64_t t0 = bench_now();
+	fill_callback(fill_buf, BENCH_COUNT, libc_rand);
+	BENCH_REPORT("rand() callback", bench_now() - t0, ops);
+
+	t0 = bench_now();
+	fill_callback(fill_buf, BENCH_COUNT, rng_rand);
+	BENCH_REPORT("rng_rand callback", bench_now() - t0, ops);
+
+	t0 = bench_now();
+	for (size_t i = 0; i < BENCH_COUNT; i++)
+		fill_buf[i] = (uint32_t)rand() % 100;
+	BENCH_REPORT("rand() % 100", bench_now() - t0, ops);
+
+	rng r;
+	rng_seed(&r, 1);
+	t0 = bench_now();
+	rng_fill_range(&r, fill_buf, BENCH_COUNT, 100);
+	BENCH_REPORT("rng_fill_range 100", bench_now() - t0, ops);
+
+	rng_pcg32 p;
+	rng_pcg32_seed(&p, 1, 1);
+	t0 = bench_now();
+	for (size_t i = 0; i < BENCH_COUNT; i++)
+		fill_buf[i] = rng_pcg32_u32(&p);
+	BENCH_REPORT("rng_pcg32_u32 loop", bench_now() - t0, ops);
+
+	rng_seed(&r, 1);
+	t0 = bench_now();
+	rng_fill_u32(&r, fill_buf, BENCH_COUNT);
+	BENCH_REPORT("rng_fill_u32", bench_now() - t0, ops);
+
+	memset(float_buf, 0, sizeof(float_buf));
+	t0 = bench_now();
+	rng_fill_float(&r, float_buf, BENCH_COUNT);
+	BENCH_REPORT("rng_fill_float", bench_now() - t0, ops);
+	VERIFY(fill_buf[0] != fill_buf[1]);
+	PASSED(__func__, __LINE__);
 }
 #pragma GCC diagnostic pop
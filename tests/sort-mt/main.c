@@ -0,0 +1,223 @@
+#include "precompile.h"
+#include "harness.h"
+#include "bench.h"
+#include "algo.h"
+#include "array.h"
+#include "functor.h"
+#include "heap.h"
+#include <unistd.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
+
+/* PARALLEL_CUTOFF in algo.c */
+#define CUTOFF 65536
+#define CHECK_MAX 200003
+#define BENCH_COUNT (1 << 22)
+#define MAX_THREADS 64
+
+#ifndef NL
+#define NL printf("\n")
+#endif
+
+// test data
+typedef struct item {
+	int key;
+	int index;
+	int pad;
+} item;
+
+typedef enum pattern {
+	RANDOM, SORTED, REVERSED, FEW_UNIQUE, ORGAN_PIPE, PATTERNS
+} pattern;
+
+static const char *pattern_names[] = {"random", "sorted", "reversed",
+				      "few unique", "organ pipe"};
+static int ibuf[BENCH_COUNT];
+static int ibuf2[BENCH_COUNT];
+static int input[CHECK_MAX];
+static item rbuf[CHECK_MAX];
+
+// test helper
+void dummy();
+static bool item_less(const item *r1, const item *r2)
+{
+	return r1->key < r2->key;
+}
+static void item_swap(item *r1, item *r2)
+{
+	item tmp = *r1;
+	*r1 = *r2;
+	*r2 = tmp;
+}
+static void fill(int *a, const size_t count, const pattern pat)
+{
+	for (size_t i = 0; i < count; i++) {
+		switch (pat) {
+		case SORTED:
+			a[i] = (int)i;
+			break;
+		case REVERSED:
+			a[i] = (int)(count - i);
+			break;
+		case FEW_UNIQUE:
+			a[i] = rand() % 4;
+			break;
+		case ORGAN_PIPE:
+			a[i] = (int)(i < count / 2 ? i : count - i);
+			break;
+		default:
+			a[i] = rand();
+		}
+	}
+}
+static bool sorted_ints(const int *a, const size_t count)
+{
+	for (size_t i = 1; i < count; i++)
+		if (a[i] < a[i - 1])
+			return false;
+	return true;
+}
+
+// test functions
+void sort_mt_test();
+void sort_mt_item_test();
+void sort_mt_array_test();
+void sort_mt_scaling_bench();
+
+int main()
+{
+	PROJECT_BANNER("SORT-MT, Parallel Sort on Host Threads");
+	Heap_Init();
+	bench_init();
+	sort_mt_test();
+	sort_mt_item_test();
+	sort_mt_array_test();
+	sort_mt_scaling_bench();
+	REPORT("host Sort-MT");
+	dummy();
+}
+
+/*-----------------------------------------------------------------------------
+Test functions and data
+-----------------------------------------------------------------------------*/
+void dummy()
+{
+}
+/* same result as gensort either side of the cutoff, odd thread counts leave
+   an odd run out in the merge rounds.  The scratch comes from the heap. */
+void sort_mt_test()
+{
+	TC_BEGIN(__func__);
+	const size_t sizes[] = {0, 1, 1000, CUTOFF - 1, CUTOFF, CUTOFF + 1,
+				CHECK_MAX};
+	const size_t threads[] = {0, 1, 2, 3, 4, 7, 16};
+	for (pattern pat = RANDOM; pat < PATTERNS; pat++) {
+		bool ok = true;
+		for (size_t s = 0; s < _countof(sizes); s++) {
+			size_t n = sizes[s];
+			fill(input, n, pat);
+			memcpy(ibuf2, input, n * sizeof(int));
+			gensort(ibuf2, n, sizeof(int), int_genless,
+				int_genswap);
+			for (size_t t = 0; t < _countof(threads); t++) {
+				memcpy(ibuf, input, n * sizeof(int));
+				gensort_parallel(ibuf, n, sizeof(int),
+						 int_genless, int_genswap,
+						 threads[t]);
+				ok = ok && memcmp(ibuf, ibuf2,
+						  n * sizeof(int)) == 0;
+			}
+		}
+		printf("%s\n", pattern_names[pat]);
+		VERIFY(ok);
+	}
+	VERIFY(Heap_Test() == HEAP_OK);
+	PASSED(__func__, __LINE__);
+}
+/* a 12 byte element, sorted by key and still a permutation of the input */
+void sort_mt_item_test()
+{
+	TC_BEGIN(__func__);
+	long long index_sum = 0;
+	for (size_t i = 0; i < CHECK_MAX; i++) {
+		rbuf[i].key = rand() % 1000;
+		rbuf[i].index = (int)i;
+		rbuf[i].pad = -1;
+		index_sum += (long long)i;
+	}
+	gensort_parallel_with(rbuf, CHECK_MAX, sizeof(item), item_less,
+			      item_swap, 5, &system_allocator);
+	bool ok = true;
+	for (size_t i = 0; i < CHECK_MAX; i++) {
+		ok = ok && rbuf[i].pad == -1;
+		ok = ok && (i == 0 || rbuf[i - 1].key <= rbuf[i].key);
+		index_sum -= rbuf[i].index;
+	}
+	VERIFY(ok);
+	VERIFY(index_sum == 0);
+	PASSED(__func__, __LINE__);
+}
+/* the scratch comes from the array's allocator, given back afterwards */
+void sort_mt_array_test()
+{
+	TC_BEGIN(__func__);
+	const size_t n = CHECK_MAX;
+	fill(ibuf, n, RANDOM);
+	arrayptr pa = array_alloc(n, sizeof(int));
+	array_add(pa, ibuf, n);
+	heap_stats_t before = Heap_Stats();
+	array_sort_parallel(pa, int_genless, int_genswap, 0);
+	heap_stats_t after = Heap_Stats();
+	VERIFY(before.blocksUsed == after.blocksUsed);
+	VERIFY(sorted_ints(array_at(pa, 0), n));
+	array_free(pa);
+
+	allocator al = system_allocator;
+	pa = array_alloc_with(n, sizeof(int), &al);
+	fill(ibuf, n, FEW_UNIQUE);
+	array_add(pa, ibuf, n);
+	array_sort_parallel(pa, int_genless, int_genswap, 3);
+	VERIFY(sorted_ints(array_at(pa, 0), n));
+	array_free(pa);
+	VERIFY(Heap_Test() == HEAP_OK);
+	PASSED(__func__, __LINE__);
+}
+/* BENCH_COUNT random ints on 1 thread doubling up to 2x the cores.  Speedup
+   is over gensort, the thread count is ideal up to the cores. */
+void sort_mt_scaling_bench()
+{
+	TC_BEGIN(__func__);
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t maxthreads = cores * 2 < MAX_THREADS ? (size_t)cores * 2 :
+						      MAX_THREADS;
+	const uint64_t ops = BENCH_COUNT;
+	char label[64];
+	printf("%ld cores\n", cores);
+	fill(ibuf2, BENCH_COUNT, RANDOM);
+
+	memcpy(ibuf, ibuf2, sizeof(ibuf));
+	uint64_t t0 = bench_now();
+	gensort(ibuf, BENCH_COUNT, sizeof(int), int_genless, int_genswap);
+	uint64_t base = bench_now() - t0;
+	BENCH_REPORT("gensort", base, ops);
+
+	for (size_t n = 1;; n *= 2) {
+		if (n > maxthreads)
+			n = maxthreads;
+		memcpy(ibuf, ibuf2, sizeof(ibuf));
+		t0 = bench_now();
+		gensort_parallel_with(ibuf, BENCH_COUNT, sizeof(int),
+				      int_genless, int_genswap, n,
+				      &system_allocator);
+		uint64_t ticks = bench_now() - t0;
+		VERIFY(sorted_ints(ibuf, BENCH_COUNT));
+		sprintf(label, "gensort_parallel %2zu threads", n);
+		BENCH_REPORT(label, ticks, ops);
+		printf("  %2zu threads speedup %.2f\n", n, (double)base / ticks);
+		if (n == maxthreads)
+			break;
+	}
+	PASSED(__func__, __LINE__);
+}
+#pragma GCC diagnostic pop